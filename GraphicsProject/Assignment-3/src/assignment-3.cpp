@@ -5,6 +5,7 @@
 #include <fstream>
 #include <sstream>
 #include <cmath>
+#include <algorithm>
 #include <vector>
 #include <string>
 
@@ -32,6 +33,8 @@ glm::vec3 housecolor(1.0f, 1.0f, 1.0f);
  * \param WindowHeight - the current height of the window
  * \param WindowTitle - the current title of the window
  * \param NFigure - the current figure that should be shown
+ * \param NViews - the number of views, i.e. cameras
+ * \param MultiViewFigure - the figure which shows all views at once
  * \param HouseVertices - the vertices of the house model
  * \param NHouseVertices - the number of entries of the house model
  * \param NeedsUpdate - true if the window needs to be updated
@@ -41,6 +44,8 @@ int WindowHeight = 500;
 std::string WindowTitle("Assignment 3: Projection of a House");
 
 int NFigure = 0;
+int const NViews = 5;
+int const MultiViewFigure = NViews;
 
 glm::vec3 HouseVertices[] = {
     //Front wall
@@ -96,6 +101,38 @@ std::ostream& operator<<(std::ostream& s, std::vector<glm::vec3> const& data)
 }
 
 
+/**
+ * Computes the transformations which place each view in its own tile of the window,
+ * so that all views can be drawn in one instanced pass over the vertices.
+ * \param camera - the cameras, one per view.
+ * \param TiledCTM - on return the current transformation matrices mapped into the tiles.
+ * \param ViewportBounds - on return the tiles as (xmin, ymin, xmax, ymax) in NDC coordinates.
+ */
+void ComputeMultiView(Camera* camera, glm::mat4x4* TiledCTM, glm::vec4* ViewportBounds)
+{
+    int columns = int(std::ceil(std::sqrt(float(NViews))));
+    int rows    = (NViews + columns - 1) / columns;
+
+    float tilewidth  = 2.0f / columns;
+    float tileheight = 2.0f / rows;
+
+    // Each view is scaled by the same factor in x and y, so it keeps the aspect ratio of the window,
+    // and it is letterboxed in the middle of its tile
+    float halfsize = 0.5f * std::min(tilewidth, tileheight);
+
+    for (int view = 0; view < NViews; ++view) {
+        // Tiles are filled left to right, top to bottom
+        float xcenter = -1.0f + ((view % columns) + 0.5f) * tilewidth;
+        float ycenter =  1.0f - ((view / columns) + 0.5f) * tileheight;
+        ViewportBounds[view] = glm::vec4(xcenter - halfsize, ycenter - halfsize, xcenter + halfsize, ycenter + halfsize);
+
+        // Scale the canonical view volume to the letterboxed part of the tile, and move it to the center of the tile
+        glm::mat4x4 Tile = glm::translate(glm::vec3(xcenter, ycenter, 0.0f))
+                         * glm::scale(glm::vec3(halfsize, halfsize, 1.0f));
+        TiledCTM[view] = Tile * camera[view].CurrentTransformationMatrix();
+    }
+}
+
 /**
  * Callback function for window resize
  * \param Window - A pointer to the window beeing resized
@@ -146,6 +183,9 @@ void KeyboardCallback(GLFWwindow* Window, int key, int scancode, int action, int
                 case '5':
                     NFigure = 4;
                     break;
+                case '6':
+                    NFigure = MultiViewFigure;
+                    break;
                 default:
                     std::cout << "No such figure: choosing figure 1" << std::endl;
                     NFigure = 0;
@@ -158,7 +198,7 @@ void KeyboardCallback(GLFWwindow* Window, int key, int scancode, int action, int
 int main() 
 {
     try {
-        Camera camera[5];
+        Camera camera[NViews];
         camera[0] = Camera(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f),
                            glm::vec3(8.0f, 6.0f, 84.0f),
                            glm::vec2(-50.0f, -50.0f), glm::vec2(50.0f,  50.0f),
@@ -196,6 +236,12 @@ int main()
 
         // Create a lineshader program and Link it with the vertex and linefragment programs
         GLuint lineshaderID = CreateShaderProgram(vertexprogID, linefragmentprogID);
+
+        // Read and Compile the vertex program multiviewtransform.vert, and link it with the linefragment program.
+        // Its uniform arrays have NVIEWS entries, which is defined here, so they agree with NViews
+        GLuint multiviewprogID = CreateGpuProgram(shader_path + "multiviewtransform.vert", GL_VERTEX_SHADER,
+                                                  "#define NVIEWS " + std::to_string(NViews) + "\n");
+        GLuint multiviewshaderID = CreateShaderProgram(multiviewprogID, linefragmentprogID);
     
         // Now comes the OpenGL core part
 
@@ -216,8 +262,9 @@ int main()
         // Give our vertices to OpenGL.
         glBufferData(GL_ARRAY_BUFFER, NHouseVertices * 3 * sizeof(float), HouseVertices, GL_STATIC_DRAW);
 
-        // Validate the shader program
+        // Validate the shader programs
         ValidateShader(lineshaderID, "Validating the lineshader");
+        ValidateShader(multiviewshaderID, "Validating the multiviewshader");
 
         // Get locations of Uniforms
         GLuint housevertextransform   = glGetUniformLocation(lineshaderID, "CTM");
@@ -228,11 +275,24 @@ int main()
         GLuint housevertexattribute = glGetAttribLocation(lineshaderID, "VertexPosition");
         glVertexAttribPointer(housevertexattribute, 3, GL_FLOAT, GL_FALSE, 0, 0);
 
+        // Uniforms and Attributes of the multiview shader
+        GLuint multiviewtransform     = glGetUniformLocation(multiviewshaderID, "CTM");
+        GLuint multiviewbounds        = glGetUniformLocation(multiviewshaderID, "ViewportBounds");
+        GLuint multiviewfragmentcolor = glGetUniformLocation(multiviewshaderID, "Color");
+        GLuint multiviewvertexattribute = glGetAttribLocation(multiviewshaderID, "VertexPosition");
+        glVertexAttribPointer(multiviewvertexattribute, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+        // The cameras do not change, so the tiles can be computed once
+        glm::mat4x4 TiledCTM[NViews];
+        glm::vec4   ViewportBounds[NViews];
+        ComputeMultiView(camera, TiledCTM, ViewportBounds);
+
         // The main loop
         std::cout << std::endl;
         std::cout << "*****************************************************************" << std::endl;
         std::cout << "* Press the characters: 1, 2, 3, 4, 5                           *" << std::endl;
         std::cout << "* to show the different figures                                 *" << std::endl;
+        std::cout << "* Press the character 6 to show all figures at once             *" << std::endl;
         std::cout << "*                                                               *" << std::endl;
         std::cout << "* The Window can be resized using the mouse                     *" << std::endl;
         std::cout << "*                                                               *" << std::endl;
@@ -245,7 +305,7 @@ int main()
                 glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
                 glUseProgram(lineshaderID);
-                if (NFigure < 5) {
+                if (NFigure < NViews) {
                     glm::mat4x4 CTM = camera[NFigure].CurrentTransformationMatrix();
                     glUniformMatrix4fv(housevertextransform, 1, GL_FALSE, &CTM[0][0]);
                     glUniform3f(housefragmentcolor, housecolor.r, housecolor.g, housecolor.b);
@@ -258,6 +318,23 @@ int main()
                 }
                 glUseProgram(0);
 
+                if (NFigure == MultiViewFigure) {
+                    // One instance per view, so the house vertices are only submitted once
+                    glUseProgram(multiviewshaderID);
+                    glUniformMatrix4fv(multiviewtransform, NViews, GL_FALSE, &TiledCTM[0][0][0]);
+                    glUniform4fv(multiviewbounds, NViews, &ViewportBounds[0][0]);
+                    glUniform3f(multiviewfragmentcolor, housecolor.r, housecolor.g, housecolor.b);
+                    for (int plane = 0; plane < 4; ++plane) glEnable(GL_CLIP_DISTANCE0 + plane);
+                    glEnableVertexAttribArray(multiviewvertexattribute);
+                    glBindVertexArray(HouseVertexArrayID);
+                    if (NHouseVertices > 0) {
+                        glDrawArraysInstanced(GL_LINES, 0, NHouseVertices, NViews);
+                    }
+                    glDisableVertexAttribArray(multiviewvertexattribute);
+                    for (int plane = 0; plane < 4; ++plane) glDisable(GL_CLIP_DISTANCE0 + plane);
+                    glUseProgram(0);
+                }
+
                 glfwSwapBuffers(Window);
                 std::stringstream errormessage;
                 errormessage << "End of loop: " << "assignment3.cpp" << ": " << __LINE__ << ": ";
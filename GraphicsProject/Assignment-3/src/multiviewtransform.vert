@@ -0,0 +1,20 @@
+#version 330 core
+
+// NVIEWS is defined by the application when it compiles the program, so the arrays have one entry per view
+uniform mat4x4 CTM[NVIEWS];
+uniform vec4 ViewportBounds[NVIEWS];
+in vec3 VertexPosition;
+
+void main() {
+    // Each instance is one view: transform by its camera, already placed in its tile
+    vec4 position = CTM[gl_InstanceID] * vec4(VertexPosition, 1.0f);
+    vec4 bounds   = ViewportBounds[gl_InstanceID];
+
+    // Clip against the tile (xmin, ymin, xmax, ymax) so views do not bleed into each other
+    gl_ClipDistance[0] = position.x - bounds.x * position.w;
+    gl_ClipDistance[1] = bounds.z * position.w - position.x;
+    gl_ClipDistance[2] = position.y - bounds.y * position.w;
+    gl_ClipDistance[3] = bounds.w * position.w - position.y;
+
+    gl_Position = position;
+}
@@ -35,6 +35,7 @@
  * \param CurrentSurface - the number of the current surface to be drawn
  * \param NumberOfSurfaces - the number of surfaces
  * \param NVertices - the number of vertices of surfaces
+ * \param Indexed - true if a surface is drawn with an index buffer
  */
 int WindowWidth  = 500;
 int WindowHeight = 500;
@@ -42,6 +43,7 @@ std::string WindowTitle("Assignment 6: Parametric Surfaces");
 int CurrentSurface   = 0;
 int const NumberOfSurfaces = 12;
 int NVertices[NumberOfSurfaces];
+bool Indexed[NumberOfSurfaces] = { false };
 bool NeedsUpdate = true;
 
 /**
@@ -81,6 +83,41 @@ void printtransformedvertices(std::vector<glm::vec3> const& Vertices, glm::mat4x
     std::cout << "<-- printtransformedvertices(...)" << std::endl;
 }
 
+/**
+ * Allocates room for NVertices interleaved vertices and normals in the buffer bound to GL_ARRAY_BUFFER,
+ * and maps the buffer, so a surface can write its data directly into it.
+ * \param NVertices - the number of vertices, the buffer gets room for 2 * NVertices 3D vectors.
+ * \return a pointer to the mapped buffer, it must be released by glUnmapBuffer(GL_ARRAY_BUFFER).
+ */
+glm::vec3* MapInterleavedBuffer(unsigned int NVertices)
+{
+    GLsizeiptr size = 2 * NVertices * sizeof(glm::vec3);
+    glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STATIC_DRAW);
+    void* destination = glMapBufferRange(GL_ARRAY_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (destination == NULL) {
+        throw std::runtime_error("Could not map the vertex buffer");
+    }
+    return static_cast<glm::vec3*>(destination);
+}
+
+/**
+ * Writes NVertices interleaved vertices and normals of a surface directly into the buffer bound to GL_ARRAY_BUFFER.
+ * If glUnmapBuffer(...) returns GL_FALSE the contents of the buffer became undefined while it was mapped,
+ * e.g. because the screen mode changed, so the data is written again.
+ * \param NVertices - the number of vertices, the buffer gets room for 2 * NVertices 3D vectors.
+ * \param write - the function which writes the 2 * NVertices 3D vectors, e.g. the WriteInterleaved(...) of a surface.
+ */
+template <typename Write>
+void UploadInterleaved(unsigned int NVertices, Write const& write)
+{
+    int const MaxAttempts = 4;
+    for (int attempt = 0; attempt < MaxAttempts; ++attempt) {
+        write(MapInterleavedBuffer(NVertices));
+        if (glUnmapBuffer(GL_ARRAY_BUFFER) == GL_TRUE) return;
+    }
+    throw std::runtime_error("Could not upload the vertex buffer, its contents were lost while it was mapped");
+}
+
 /**
  * Callback function for window resize
  * \param Window - A pointer to the window beeing resized
@@ -187,6 +224,20 @@ int main()
                 throw std::runtime_error(errormessage.str());
             }
         }
+        // Only the composite Klein Bottles keep their normals in a buffer of their own, the other surfaces
+        // interleave them with the vertices, and their normal buffers are released once all data is generated
+        bool separatenormals[NumberOfSurfaces] = { false };
+    
+        // Generate index buffers
+        GLuint indexbuffer[NumberOfSurfaces];
+        glGenBuffers(NumberOfSurfaces, indexbuffer);
+        for (int i = 0; i < NumberOfSurfaces; ++i) {
+            if (indexbuffer[i] == 0) {
+                std::stringstream errormessage;
+                errormessage << "Could not create IndexBuffer[" << i << "]";
+                throw std::runtime_error(errormessage.str());
+            }
+        }
     
         // Camera
         Camera camera[NumberOfSurfaces];
@@ -279,7 +330,7 @@ int main()
         BezierSurface teapot(data_path + "teapot.data");
         teapot.FrontFacing(false);
         teapot.NumberOfSubdivisions(3);
-        NVertices[CurrentSurface] = teapot.Vertices().size();
+        NVertices[CurrentSurface] = teapot.NumberOfVertices();
 
         // Viewing parameters
         {
@@ -328,25 +379,19 @@ int main()
         glBindVertexArray(SurfaceArrayID[CurrentSurface]);
             glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer[CurrentSurface]);
     
-            // Give our vertices to OpenGL.
-            if (teapot.Vertices().size() > 0) {
-                glBufferData(GL_ARRAY_BUFFER, teapot.Vertices().size() * 3 * sizeof(float),
-                             glm::value_ptr(teapot.Vertices()[0]), GL_STATIC_DRAW);
+            // Write the interleaved vertices and normals directly into the buffer.
+            if (teapot.NumberOfVertices() > 0) {
+                UploadInterleaved(teapot.NumberOfVertices(), [&](glm::vec3* destination) {
+                    teapot.WriteInterleaved(destination);
+                });
             }
-            // Initialize the vertex Attributes
-            glEnableVertexAttribArray(vertexattribute);
-            glVertexAttribPointer(vertexattribute, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
 
-            glBindBuffer(GL_ARRAY_BUFFER, normalbuffer[CurrentSurface]);
-            
-            // Give our normals to OpenGL.
-            if (teapot.Normals().size() > 0) {
-                glBufferData(GL_ARRAY_BUFFER, teapot.Normals().size() * 3 * sizeof(float),
-                             glm::value_ptr(teapot.Normals()[0]), GL_STATIC_DRAW);
-            }
-            // Initialize the normal Attributes
+            // Initialize the vertex and normal Attributes, each normal follows its vertex.
+            glEnableVertexAttribArray(vertexattribute);
+            glVertexAttribPointer(vertexattribute, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec3), BUFFER_OFFSET(0));
             glEnableVertexAttribArray(normalattribute);
-            glVertexAttribPointer(normalattribute, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
+            glVertexAttribPointer(normalattribute, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec3),
+                                  BUFFER_OFFSET(sizeof(glm::vec3)));
         glBindVertexArray(0);
 
        
@@ -355,7 +400,7 @@ int main()
         PhongSurface phongsurface;
         phongsurface.PhiSamples(150);
         phongsurface.ThetaSamples(150);
-        NVertices[CurrentSurface] = phongsurface.Vertices().size();
+        NVertices[CurrentSurface] = phongsurface.NumberOfVertices();
 
         // Vieving parameters
         {
@@ -397,33 +442,26 @@ int main()
         glBindVertexArray(SurfaceArrayID[CurrentSurface]);
             glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer[CurrentSurface]);
     
-            // Give our vertices to OpenGL.
-            if (phongsurface.Vertices().size() > 0) {
-                glBufferData(GL_ARRAY_BUFFER, phongsurface.Vertices().size() * 3 * sizeof(float),
-                             glm::value_ptr(phongsurface.Vertices()[0]), GL_STATIC_DRAW);
-            }
-            
-            // Initialize the vertex Attributes
-            glEnableVertexAttribArray(vertexattribute);
-            glVertexAttribPointer(vertexattribute, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
-
-            glBindBuffer(GL_ARRAY_BUFFER, normalbuffer[CurrentSurface]);
-
-            // Give our normals to OpenGL.
-            if (phongsurface.Normals().size() > 0) {
-                glBufferData(GL_ARRAY_BUFFER, phongsurface.Normals().size() * 3 * sizeof(float),
-                             glm::value_ptr(phongsurface.Normals()[0]), GL_STATIC_DRAW);
+            // Write the interleaved vertices and normals directly into the buffer.
+            if (phongsurface.NumberOfVertices() > 0) {
+                UploadInterleaved(phongsurface.NumberOfVertices(), [&](glm::vec3* destination) {
+                    phongsurface.WriteInterleaved(destination);
+                });
             }
 
-            // Initialize the normal Attributes
+            // Initialize the vertex and normal Attributes, each normal follows its vertex.
+            glEnableVertexAttribArray(vertexattribute);
+            glVertexAttribPointer(vertexattribute, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec3), BUFFER_OFFSET(0));
             glEnableVertexAttribArray(normalattribute);
-            glVertexAttribPointer(normalattribute, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
+            glVertexAttribPointer(normalattribute, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec3),
+                                  BUFFER_OFFSET(sizeof(glm::vec3)));
         glBindVertexArray(0);
     
 
         ++CurrentSurface;
             DiniSurface dinisurface;
-        NVertices[CurrentSurface] = dinisurface.Vertices().size();
+        NVertices[CurrentSurface] = dinisurface.Indices().size();
+        Indexed[CurrentSurface]   = true;
 
         // Vieving parameters
         {
@@ -471,34 +509,34 @@ int main()
         glBindVertexArray(SurfaceArrayID[CurrentSurface]);
             glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer[CurrentSurface]);
     
-            // Give our vertices to OpenGL.
-            if (dinisurface.Vertices().size() > 0) {
-                glBufferData(GL_ARRAY_BUFFER, dinisurface.Vertices().size() * 3 * sizeof(float),
-                             glm::value_ptr(dinisurface.Vertices()[0]), GL_STATIC_DRAW);
-            }
-            
-            // Initialize the vertex Attributes
-            glEnableVertexAttribArray(vertexattribute);
-            glVertexAttribPointer(vertexattribute, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
-
-            glBindBuffer(GL_ARRAY_BUFFER, normalbuffer[CurrentSurface]);
-
-            // Give our normals to OpenGL.
-            if (dinisurface.Normals().size() > 0) {
-                glBufferData(GL_ARRAY_BUFFER, dinisurface.Normals().size() * 3 * sizeof(float),
-                             glm::value_ptr(dinisurface.Normals()[0]), GL_STATIC_DRAW);
+            // Write the interleaved grid vertices and normals directly into the buffer, each grid point only once.
+            if (dinisurface.GridVertices().size() > 0) {
+                UploadInterleaved(dinisurface.GridVertices().size(), [&](glm::vec3* destination) {
+                    dinisurface.WriteInterleavedGrid(destination);
+                });
             }
 
-            // Initialize the normal Attributes
+            // Initialize the vertex and normal Attributes, each normal follows its vertex.
+            glEnableVertexAttribArray(vertexattribute);
+            glVertexAttribPointer(vertexattribute, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec3), BUFFER_OFFSET(0));
             glEnableVertexAttribArray(normalattribute);
-            glVertexAttribPointer(normalattribute, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
+            glVertexAttribPointer(normalattribute, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec3),
+                                  BUFFER_OFFSET(sizeof(glm::vec3)));
+
+            // Give the triangle indices into the grid to OpenGL.
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexbuffer[CurrentSurface]);
+            if (dinisurface.Indices().size() > 0) {
+                glBufferData(GL_ELEMENT_ARRAY_BUFFER, dinisurface.Indices().size() * sizeof(unsigned int),
+                             &dinisurface.Indices()[0], GL_STATIC_DRAW);
+            }
         glBindVertexArray(0);
     
  
         ++CurrentSurface;
         KleinBottom kleinbottom;
         kleinbottom.FrontFacing(false);
-        NVertices[CurrentSurface] = kleinbottom.Vertices().size();
+        NVertices[CurrentSurface] = kleinbottom.Indices().size();
+        Indexed[CurrentSurface]   = true;
 
         // Vieving parameters
         {
@@ -539,33 +577,33 @@ int main()
         glBindVertexArray(SurfaceArrayID[CurrentSurface]);
             glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer[CurrentSurface]);
     
-            // Give our vertices to OpenGL.
-            if (kleinbottom.Vertices().size() > 0) {
-                glBufferData(GL_ARRAY_BUFFER, kleinbottom.Vertices().size() * 3 * sizeof(float),
-                             glm::value_ptr(kleinbottom.Vertices()[0]), GL_STATIC_DRAW);
+            // Write the interleaved grid vertices and normals directly into the buffer, each grid point only once.
+            if (kleinbottom.GridVertices().size() > 0) {
+                UploadInterleaved(kleinbottom.GridVertices().size(), [&](glm::vec3* destination) {
+                    kleinbottom.WriteInterleavedGrid(destination);
+                });
             }
 
-            // Initialize the vertex Attributes
+            // Initialize the vertex and normal Attributes, each normal follows its vertex.
             glEnableVertexAttribArray(vertexattribute);
-            glVertexAttribPointer(vertexattribute, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
-
-            glBindBuffer(GL_ARRAY_BUFFER, normalbuffer[CurrentSurface]);
-
-            // Give our normals to OpenGL.
-            if (kleinbottom.Normals().size() > 0) {
-                glBufferData(GL_ARRAY_BUFFER, kleinbottom.Normals().size() * 3 * sizeof(float),
-                             glm::value_ptr(kleinbottom.Normals()[0]), GL_STATIC_DRAW);
-            }
-            
-            // Initialize the normal Attributes
+            glVertexAttribPointer(vertexattribute, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec3), BUFFER_OFFSET(0));
             glEnableVertexAttribArray(normalattribute);
-            glVertexAttribPointer(normalattribute, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
+            glVertexAttribPointer(normalattribute, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec3),
+                                  BUFFER_OFFSET(sizeof(glm::vec3)));
+
+            // Give the triangle indices into the grid to OpenGL.
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexbuffer[CurrentSurface]);
+            if (kleinbottom.Indices().size() > 0) {
+                glBufferData(GL_ELEMENT_ARRAY_BUFFER, kleinbottom.Indices().size() * sizeof(unsigned int),
+                             &kleinbottom.Indices()[0], GL_STATIC_DRAW);
+            }
         glBindVertexArray(0);
 
         ++CurrentSurface;
         KleinHandle kleinhandle;
         kleinhandle.FrontFacing(false);
-        NVertices[CurrentSurface] = kleinhandle.Vertices().size();
+        NVertices[CurrentSurface] = kleinhandle.Indices().size();
+        Indexed[CurrentSurface]   = true;
 
         // Vieving parameters
         {
@@ -604,33 +642,33 @@ int main()
         glBindVertexArray(SurfaceArrayID[CurrentSurface]);
             glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer[CurrentSurface]);
     
-            // Give our vertices to OpenGL.
-            if (kleinhandle.Vertices().size() > 0) {
-                glBufferData(GL_ARRAY_BUFFER, kleinhandle.Vertices().size() * 3 * sizeof(float),
-                             glm::value_ptr(kleinhandle.Vertices()[0]), GL_STATIC_DRAW);
+            // Write the interleaved grid vertices and normals directly into the buffer, each grid point only once.
+            if (kleinhandle.GridVertices().size() > 0) {
+                UploadInterleaved(kleinhandle.GridVertices().size(), [&](glm::vec3* destination) {
+                    kleinhandle.WriteInterleavedGrid(destination);
+                });
             }
-            
-            // Initialize the vertex Attributes
-            glEnableVertexAttribArray(vertexattribute);
-            glVertexAttribPointer(vertexattribute, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
 
-            glBindBuffer(GL_ARRAY_BUFFER, normalbuffer[CurrentSurface]);
-
-            // Give our normals to OpenGL.
-            if (kleinhandle.Normals().size() > 0) {
-                glBufferData(GL_ARRAY_BUFFER, kleinhandle.Normals().size() * 3 * sizeof(float),
-                             glm::value_ptr(kleinhandle.Normals()[0]), GL_STATIC_DRAW);
-            }
-            
-            // Initialize the normal Attributes
+            // Initialize the vertex and normal Attributes, each normal follows its vertex.
+            glEnableVertexAttribArray(vertexattribute);
+            glVertexAttribPointer(vertexattribute, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec3), BUFFER_OFFSET(0));
             glEnableVertexAttribArray(normalattribute);
-            glVertexAttribPointer(normalattribute, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
+            glVertexAttribPointer(normalattribute, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec3),
+                                  BUFFER_OFFSET(sizeof(glm::vec3)));
+
+            // Give the triangle indices into the grid to OpenGL.
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexbuffer[CurrentSurface]);
+            if (kleinhandle.Indices().size() > 0) {
+                glBufferData(GL_ELEMENT_ARRAY_BUFFER, kleinhandle.Indices().size() * sizeof(unsigned int),
+                             &kleinhandle.Indices()[0], GL_STATIC_DRAW);
+            }
         glBindVertexArray(0);
     
 
         ++CurrentSurface;
         KleinTop kleintop;
-        NVertices[CurrentSurface] = kleintop.Vertices().size();
+        NVertices[CurrentSurface] = kleintop.Indices().size();
+        Indexed[CurrentSurface]   = true;
 
         // Vieving parameters
         {
@@ -671,32 +709,31 @@ int main()
         glBindVertexArray(SurfaceArrayID[CurrentSurface]);
             glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer[CurrentSurface]);
     
-            // Give our vertices to OpenGL.
-            if (kleintop.Vertices().size() > 0) {
-                glBufferData(GL_ARRAY_BUFFER, kleintop.Vertices().size() * 3 * sizeof(float),
-                             glm::value_ptr(kleintop.Vertices()[0]), GL_STATIC_DRAW);
+            // Write the interleaved grid vertices and normals directly into the buffer, each grid point only once.
+            if (kleintop.GridVertices().size() > 0) {
+                UploadInterleaved(kleintop.GridVertices().size(), [&](glm::vec3* destination) {
+                    kleintop.WriteInterleavedGrid(destination);
+                });
             }
-            
-            // Initialize the vertex Attributes
-            glEnableVertexAttribArray(vertexattribute);
-            glVertexAttribPointer(vertexattribute, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
-
-            glBindBuffer(GL_ARRAY_BUFFER, normalbuffer[CurrentSurface]);
 
-            // Give our normals to OpenGL.
-            if (kleintop.Normals().size() > 0) {
-                glBufferData(GL_ARRAY_BUFFER, kleintop.Normals().size() * 3 * sizeof(float),
-                             glm::value_ptr(kleintop.Normals()[0]), GL_STATIC_DRAW);
-            }
-            
-            // Initialize the normal Attributes
+            // Initialize the vertex and normal Attributes, each normal follows its vertex.
+            glEnableVertexAttribArray(vertexattribute);
+            glVertexAttribPointer(vertexattribute, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec3), BUFFER_OFFSET(0));
             glEnableVertexAttribArray(normalattribute);
-            glVertexAttribPointer(normalattribute, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
+            glVertexAttribPointer(normalattribute, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec3),
+                                  BUFFER_OFFSET(sizeof(glm::vec3)));
+
+            // Give the triangle indices into the grid to OpenGL.
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexbuffer[CurrentSurface]);
+            if (kleintop.Indices().size() > 0) {
+                glBufferData(GL_ELEMENT_ARRAY_BUFFER, kleintop.Indices().size() * sizeof(unsigned int),
+                             &kleintop.Indices()[0], GL_STATIC_DRAW);
+            }
         glBindVertexArray(0);
 
         ++CurrentSurface;
         KleinMiddle kleinmiddle;
-        NVertices[CurrentSurface] = kleinmiddle.Vertices().size();
+        NVertices[CurrentSurface] = kleinmiddle.NumberOfVertices();
 
         // Vieving parameters
         {
@@ -737,42 +774,28 @@ int main()
         glBindVertexArray(SurfaceArrayID[CurrentSurface]);
             glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer[CurrentSurface]);
     
-            // Give our vertices to OpenGL.
-            if (kleinmiddle.Vertices().size() > 0) {
-                glBufferData(GL_ARRAY_BUFFER, kleinmiddle.Vertices().size() * 3 * sizeof(float),
-                             glm::value_ptr(kleinmiddle.Vertices()[0]), GL_STATIC_DRAW);
+            // Write the interleaved vertices and normals directly into the buffer.
+            if (kleinmiddle.NumberOfVertices() > 0) {
+                UploadInterleaved(kleinmiddle.NumberOfVertices(), [&](glm::vec3* destination) {
+                    kleinmiddle.WriteInterleaved(destination);
+                });
             }
-            
-            // Initialize the vertex Attributes
-            glEnableVertexAttribArray(vertexattribute);
-            glVertexAttribPointer(vertexattribute, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
-
-            glBindBuffer(GL_ARRAY_BUFFER, normalbuffer[CurrentSurface]);
 
-            // Give our normals to OpenGL.
-            if (kleinmiddle.Normals().size() > 0) {
-                glBufferData(GL_ARRAY_BUFFER, kleinmiddle.Normals().size() * 3 * sizeof(float),
-                             glm::value_ptr(kleinmiddle.Normals()[0]), GL_STATIC_DRAW);
-            }
-            
-            // Initialize the normal Attributes
+            // Initialize the vertex and normal Attributes, each normal follows its vertex.
+            glEnableVertexAttribArray(vertexattribute);
+            glVertexAttribPointer(vertexattribute, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec3), BUFFER_OFFSET(0));
             glEnableVertexAttribArray(normalattribute);
-            glVertexAttribPointer(normalattribute, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
+            glVertexAttribPointer(normalattribute, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec3),
+                                  BUFFER_OFFSET(sizeof(glm::vec3)));
         glBindVertexArray(0);
     
 
         ++CurrentSurface;
-        std::vector<glm::vec3> kleinvertices3;
-        kleinvertices3.insert(kleinvertices3.end(), kleinbottom.Vertices().begin(), kleinbottom.Vertices().end());
-        kleinvertices3.insert(kleinvertices3.end(), kleinhandle.Vertices().begin(), kleinhandle.Vertices().end());
-        kleinvertices3.insert(kleinvertices3.end(), kleintop.Vertices().begin(), kleintop.Vertices().end());
-    
-        std::vector<glm::vec3> kleinnormals3;
-        kleinnormals3.insert(kleinnormals3.end(), kleinbottom.Normals().begin(), kleinbottom.Normals().end());
-        kleinnormals3.insert(kleinnormals3.end(), kleinhandle.Normals().begin(), kleinhandle.Normals().end());
-        kleinnormals3.insert(kleinnormals3.end(), kleintop.Normals().begin(), kleintop.Normals().end());
-    
-        NVertices[CurrentSurface] = kleinvertices3.size();
+        // The composite Klein Bottle stores the parts top, bottom, handle, and middle in one range each,
+        // so the first three parts are drawn as a prefix of its vertices, and the whole bottle as all of them
+        KleinBottle kleinbottle(kleinmiddle.Usamples(), kleinmiddle.Vsamples());
+        std::vector<DrawRange> const& kleinparts = kleinbottle.DrawRanges();
+        NVertices[CurrentSurface] = kleinparts[2].first + kleinparts[2].count;
 
         // Vieving parameters
         {
@@ -814,21 +837,22 @@ int main()
             glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer[CurrentSurface]);
     
             // Give our vertices to OpenGL.
-            if (kleinvertices3.size() > 0) {
-                glBufferData(GL_ARRAY_BUFFER, kleinvertices3.size() * 3 * sizeof(float),
-                             glm::value_ptr(kleinvertices3[0]), GL_STATIC_DRAW);
+            if (NVertices[CurrentSurface] > 0) {
+                glBufferData(GL_ARRAY_BUFFER, NVertices[CurrentSurface] * 3 * sizeof(float),
+                             glm::value_ptr(kleinbottle.Vertices()[0]), GL_STATIC_DRAW);
             }
             
             // Initialize the vertex Attributes
             glEnableVertexAttribArray(vertexattribute);
             glVertexAttribPointer(vertexattribute, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
 
+            separatenormals[CurrentSurface] = true;
             glBindBuffer(GL_ARRAY_BUFFER, normalbuffer[CurrentSurface]);
 
             // Give our normals to OpenGL.
-            if (kleinnormals3.size() > 0) {
-                glBufferData(GL_ARRAY_BUFFER, kleinnormals3.size() * 3 * sizeof(float),
-                             glm::value_ptr(kleinnormals3[0]), GL_STATIC_DRAW);
+            if (NVertices[CurrentSurface] > 0) {
+                glBufferData(GL_ARRAY_BUFFER, NVertices[CurrentSurface] * 3 * sizeof(float),
+                             glm::value_ptr(kleinbottle.Normals()[0]), GL_STATIC_DRAW);
             }
             
             // Initialize the normal Attributes
@@ -838,15 +862,7 @@ int main()
     
 
         ++CurrentSurface;
-        std::vector<glm::vec3> kleinvertices;
-        kleinvertices.insert(kleinvertices.end(), kleinvertices3.begin(), kleinvertices3.end());
-        kleinvertices.insert(kleinvertices.end(), kleinmiddle.Vertices().begin(), kleinmiddle.Vertices().end());
-    
-        std::vector<glm::vec3> kleinnormals;
-        kleinnormals.insert(kleinnormals.end(), kleinnormals3.begin(), kleinnormals3.end());
-        kleinnormals.insert(kleinnormals.end(), kleinmiddle.Normals().begin(), kleinmiddle.Normals().end());
-    
-        NVertices[CurrentSurface] = kleinvertices.size();
+        NVertices[CurrentSurface] = kleinbottle.Vertices().size();
 
         // Vieving parameters
         {
@@ -888,21 +904,22 @@ int main()
             glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer[CurrentSurface]);
     
             // Give our vertices to OpenGL.
-            if (kleinvertices.size() > 0) {
-                glBufferData(GL_ARRAY_BUFFER, kleinvertices.size() * 3 * sizeof(float),
-                             glm::value_ptr(kleinvertices[0]), GL_STATIC_DRAW);
+            if (NVertices[CurrentSurface] > 0) {
+                glBufferData(GL_ARRAY_BUFFER, NVertices[CurrentSurface] * 3 * sizeof(float),
+                             glm::value_ptr(kleinbottle.Vertices()[0]), GL_STATIC_DRAW);
             }
             
             // Initialize the vertex Attributes
             glEnableVertexAttribArray(vertexattribute);
             glVertexAttribPointer(vertexattribute, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
 
+            separatenormals[CurrentSurface] = true;
             glBindBuffer(GL_ARRAY_BUFFER, normalbuffer[CurrentSurface]);
 
             // Give our normals to OpenGL.
-            if (kleinnormals.size() > 0) {
-                glBufferData(GL_ARRAY_BUFFER, kleinnormals.size() * 3 * sizeof(float),
-                             glm::value_ptr(kleinnormals[0]), GL_STATIC_DRAW);
+            if (NVertices[CurrentSurface] > 0) {
+                glBufferData(GL_ARRAY_BUFFER, NVertices[CurrentSurface] * 3 * sizeof(float),
+                             glm::value_ptr(kleinbottle.Normals()[0]), GL_STATIC_DRAW);
             }
             
             // Initialize the normal Attributes
@@ -915,7 +932,7 @@ int main()
         BezierSurface rocket(data_path + "rocket.data");
         rocket.FrontFacing(false);
         rocket.NumberOfSubdivisions(3);
-        NVertices[CurrentSurface] = rocket.Vertices().size();
+        NVertices[CurrentSurface] = rocket.NumberOfVertices();
 
         //std::cout << "BezierPatches:" << std::endl;
         //std::cout << rocket.Vertices();
@@ -977,34 +994,26 @@ int main()
         glBindVertexArray(SurfaceArrayID[CurrentSurface]);
             glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer[CurrentSurface]);
     
-            // Give our vertices to OpenGL.
-            if (rocket.Vertices().size() > 0) {
-                glBufferData(GL_ARRAY_BUFFER, rocket.Vertices().size() * 3 * sizeof(float),
-                             glm::value_ptr(rocket.Vertices()[0]), GL_STATIC_DRAW);
+            // Write the interleaved vertices and normals directly into the buffer.
+            if (rocket.NumberOfVertices() > 0) {
+                UploadInterleaved(rocket.NumberOfVertices(), [&](glm::vec3* destination) {
+                    rocket.WriteInterleaved(destination);
+                });
             }
-            
-            // Initialize the vertex Attributes
-            glEnableVertexAttribArray(vertexattribute);
-            glVertexAttribPointer(vertexattribute, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
-
-            glBindBuffer(GL_ARRAY_BUFFER, normalbuffer[CurrentSurface]);
 
-            // Give our normals to OpenGL.
-            if (rocket.Normals().size() > 0) {
-                glBufferData(GL_ARRAY_BUFFER, rocket.Normals().size() * 3 * sizeof(float),
-                             glm::value_ptr(rocket.Normals()[0]), GL_STATIC_DRAW);
-            }
-            
-            // Initialize the normal Attributes
+            // Initialize the vertex and normal Attributes, each normal follows its vertex.
+            glEnableVertexAttribArray(vertexattribute);
+            glVertexAttribPointer(vertexattribute, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec3), BUFFER_OFFSET(0));
             glEnableVertexAttribArray(normalattribute);
-            glVertexAttribPointer(normalattribute, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
+            glVertexAttribPointer(normalattribute, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec3),
+                                  BUFFER_OFFSET(sizeof(glm::vec3)));
         glBindVertexArray(0);
 
  
         ++CurrentSurface;
         BezierSurface pain(data_path + "pain.data");
         pain.NumberOfSubdivisions(5);
-        NVertices[CurrentSurface] = pain.Vertices().size();
+        NVertices[CurrentSurface] = pain.NumberOfVertices();
 
 
 
@@ -1069,34 +1078,26 @@ int main()
         glBindVertexArray(SurfaceArrayID[CurrentSurface]);
             glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer[CurrentSurface]);
     
-            // Give our vertices to OpenGL.
-            if (pain.Vertices().size() > 0) {
-                glBufferData(GL_ARRAY_BUFFER, pain.Vertices().size() * 3 * sizeof(float),
-                             glm::value_ptr(pain.Vertices()[0]), GL_STATIC_DRAW);
+            // Write the interleaved vertices and normals directly into the buffer.
+            if (pain.NumberOfVertices() > 0) {
+                UploadInterleaved(pain.NumberOfVertices(), [&](glm::vec3* destination) {
+                    pain.WriteInterleaved(destination);
+                });
             }
-            
-            // Initialize the vertex Attributes
-            glEnableVertexAttribArray(vertexattribute);
-            glVertexAttribPointer(vertexattribute, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
-
-            glBindBuffer(GL_ARRAY_BUFFER, normalbuffer[CurrentSurface]);
 
-            // Give our normals to OpenGL.
-            if (pain.Normals().size() > 0) {
-                glBufferData(GL_ARRAY_BUFFER, pain.Normals().size() * 3 * sizeof(float),
-                             glm::value_ptr(pain.Normals()[0]), GL_STATIC_DRAW);
-            }
-            
-            // Initialize the normal Attributes
+            // Initialize the vertex and normal Attributes, each normal follows its vertex.
+            glEnableVertexAttribArray(vertexattribute);
+            glVertexAttribPointer(vertexattribute, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec3), BUFFER_OFFSET(0));
             glEnableVertexAttribArray(normalattribute);
-            glVertexAttribPointer(normalattribute, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
+            glVertexAttribPointer(normalattribute, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec3),
+                                  BUFFER_OFFSET(sizeof(glm::vec3)));
         glBindVertexArray(0);
 
         ++CurrentSurface;
         BezierSurface patches(data_path + "patches.data");
         patches.FrontFacing(false);
         patches.NumberOfSubdivisions(4);
-        NVertices[CurrentSurface] = patches.Vertices().size();
+        NVertices[CurrentSurface] = patches.NumberOfVertices();
 
 
 
@@ -1149,32 +1150,31 @@ int main()
         glBindVertexArray(SurfaceArrayID[CurrentSurface]);
             glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer[CurrentSurface]);
     
-            // Give our vertices to OpenGL.
-            if (patches.Vertices().size() > 0) {
-                glBufferData(GL_ARRAY_BUFFER, patches.Vertices().size() * 3 * sizeof(float),
-                             glm::value_ptr(patches.Vertices()[0]), GL_STATIC_DRAW);
+            // Write the interleaved vertices and normals directly into the buffer.
+            if (patches.NumberOfVertices() > 0) {
+                UploadInterleaved(patches.NumberOfVertices(), [&](glm::vec3* destination) {
+                    patches.WriteInterleaved(destination);
+                });
             }
-            
-            // Initialize the vertex Attributes
-            glEnableVertexAttribArray(vertexattribute);
-            glVertexAttribPointer(vertexattribute, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
 
-            glBindBuffer(GL_ARRAY_BUFFER, normalbuffer[CurrentSurface]);
-
-            // Give our normals to OpenGL.
-            if (patches.Normals().size() > 0) {
-                glBufferData(GL_ARRAY_BUFFER, patches.Normals().size() * 3 * sizeof(float),
-                             glm::value_ptr(patches.Normals()[0]), GL_STATIC_DRAW);
-            }
-            
-            // Initialize the normal Attributes
+            // Initialize the vertex and normal Attributes, each normal follows its vertex.
+            glEnableVertexAttribArray(vertexattribute);
+            glVertexAttribPointer(vertexattribute, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec3), BUFFER_OFFSET(0));
             glEnableVertexAttribArray(normalattribute);
-            glVertexAttribPointer(normalattribute, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
+            glVertexAttribPointer(normalattribute, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec3),
+                                  BUFFER_OFFSET(sizeof(glm::vec3)));
         glBindVertexArray(0);
 
 
 
 
+        for (int i = 0; i < NumberOfSurfaces; ++i) {
+            if (!separatenormals[i]) {
+                glDeleteBuffers(1, &normalbuffer[i]);
+                normalbuffer[i] = 0;
+            }
+        }
+
         // Almost ready to visualize the surfaces
         
         // The main loop
@@ -1227,7 +1227,12 @@ int main()
             
                     // Draw the surfaces
                     if (NVertices[CurrentSurface] > 0) {
-                        glDrawArrays(GL_TRIANGLES, 0, NVertices[CurrentSurface]);
+                        if (Indexed[CurrentSurface]) {
+                            glDrawElements(GL_TRIANGLES, NVertices[CurrentSurface], GL_UNSIGNED_INT, BUFFER_OFFSET(0));
+                        }
+                        else {
+                            glDrawArrays(GL_TRIANGLES, 0, NVertices[CurrentSurface]);
+                        }
                     }
                 glBindVertexArray(0);
             glUseProgram(0);
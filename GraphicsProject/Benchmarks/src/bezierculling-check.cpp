@@ -0,0 +1,90 @@
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "glmutils.h"
+#include "bezierpatch.h"
+#include "beziersurface.h"
+
+
+/**
+ * Checks the back face culling of BezierSurface for a perspective and a parallel projection: a flat patch must be
+ * kept when the viewer is on the side its normals point to, and culled when the viewer is on the other side.
+ *
+ * Usage: bezierculling-check
+ */
+
+
+/**
+ * Creates a BezierSurface with one flat patch in the plane z = 0, which lies in [-0.5, 0.5] x [-0.5, 0.5].
+ * \return the surface.
+ */
+BezierSurface FlatSurface()
+{
+    BezierPatch G;
+    for (int i = 1; i <= 4; ++i) {
+        for (int j = 1; j <= 4; ++j) {
+            G[i][j] = glm::vec3((i - 1) / 3.0f - 0.5f, (j - 1) / 3.0f - 0.5f, 0.0f);
+        }
+    }
+    return BezierSurface(std::vector<BezierPatch>(1, G));
+}
+
+/**
+ * Culls the surface against a view and reports if the result is as expected.
+ * \param name - the name of the view, which is printed.
+ * \param surface - the surface.
+ * \param transformation - the transformation from model coordinates to the canonical view volume.
+ * \param visible - true if the patch should be kept, false if it should be culled.
+ * \return true if the check passed, else false.
+ */
+bool Check(std::string const& name, BezierSurface& surface, glm::mat4x4 const& transformation, bool visible)
+{
+    surface.Culling(transformation, true);
+    bool kept = (surface.NumberOfVertices() > 0);
+    surface.NoCulling();
+
+    std::cout << std::setw(40) << std::left << name << std::right
+              << (kept ? "kept  " : "culled") << ((kept == visible) ? "   ok" : "   FAILED") << std::endl;
+    return kept == visible;
+}
+
+int main()
+{
+    try {
+        BezierSurface surface = FlatSurface();
+
+        // Turn the normals of the patch towards +z, where the viewer of the canonical view volume is
+        glm::mat4x4 facing(1.0f);
+        if (surface.Normals().front().z < 0.0f) {
+            facing = glm::scale(glm::vec3(1.0f, -1.0f, -1.0f));
+        }
+        glm::mat4x4 away = glm::scale(glm::vec3(1.0f, -1.0f, -1.0f)) * facing;
+
+        // A parallel projection which maps the plane z = 0 to z = -0.5
+        glm::mat4x4 parallel = glm::translate(glm::vec3(0.0f, 0.0f, -0.5f)) * glm::scale(glm::vec3(0.5f, 0.5f, 0.1f));
+
+        // A perspective projection with the center of projection at z = 2, and the front and back clipping planes
+        // 1 and 10 from it, i.e. z = -1 is mapped to 0 and z = -10 is mapped to -1 after the division by w = -z
+        float a = 10.0f / 9.0f;
+        glm::mat4x4 perspective(glm::vec4(1.0f, 0.0f, 0.0f,  0.0f),
+                                glm::vec4(0.0f, 1.0f, 0.0f,  0.0f),
+                                glm::vec4(0.0f, 0.0f, a,    -1.0f),
+                                glm::vec4(0.0f, 0.0f, a,     0.0f));
+        perspective = perspective * glm::translate(glm::vec3(0.0f, 0.0f, -2.0f));
+
+        bool passed = true;
+        passed = Check("parallel, patch facing the viewer",    surface, parallel    * facing, true)  && passed;
+        passed = Check("parallel, patch facing away",          surface, parallel    * away,   false) && passed;
+        passed = Check("perspective, patch facing the viewer", surface, perspective * facing, true)  && passed;
+        passed = Check("perspective, patch facing away",       surface, perspective * away,   false) && passed;
+        return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    catch (std::exception const& exception) {
+        std::cerr << "Exception: " << exception.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,173 @@
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+#include "glmutils.h"
+#include "bezierpatch.h"
+
+
+/**
+ * Benchmarks the lazy products of a BezierPatch and ordinary matrices, i.e. BezierPatchProduct, which evaluate
+ * a chain like M * G * glm::transpose(M) in one pass, against the same chains evaluated one factor at a time
+ * by the eager operators which the library had before the lazy products, where each factor produces a temporary
+ * BezierPatch.
+ *
+ * Usage: bezierproduct-benchmark [number of patches] [number of repetitions]
+ */
+
+
+/**
+ * Creates a number of patches with pseudo random control points in [-1, 1]^3.
+ * \param npatches - the number of patches.
+ * \return the patches.
+ */
+std::vector<BezierPatch> RandomPatches(unsigned int npatches)
+{
+    std::srand(12345);
+    std::vector<BezierPatch> patches(npatches);
+    for (BezierPatch& G : patches) {
+        for (int i = 1; i <= 4; ++i) {
+            for (int j = 1; j <= 4; ++j) {
+                for (int c = 0; c < 3; ++c) {
+                    G[i][j][c] = 2.0f * float(std::rand()) / float(RAND_MAX) - 1.0f;
+                }
+            }
+        }
+    }
+    return patches;
+}
+
+/**
+ * The eager right-multiplication of a BezierPatch by an ordinary matrix, as it was before BezierPatchProduct.
+ * \param bezierpatch - The BezierPatch that should be multiplied.
+ * \param matrix - The ordinary matrix which right-multiplies the BezierPatch.
+ * \return The product bezierpatch * matrix.
+ */
+BezierPatch EagerProduct(BezierPatch const& bezierpatch, glm::mat4x4 const& matrix)
+{
+    BezierPatch result;
+
+    for (int i = 1; i <= 4; ++i) {
+        for (int j = 1; j <= 4; ++j) {
+            glm::vec4 column(glm::column(matrix, j - 1));
+            result[i][j] = bezierpatch[i] * column;
+        }
+    }
+    return result;
+}
+
+/**
+ * The eager left-multiplication of a BezierPatch by an ordinary matrix, as it was before BezierPatchProduct.
+ * \param matrix - The ordinary matrix which left-multiplies the BezierPatch.
+ * \param bezierpatch - The BezierPatch that should be multiplied.
+ * \return The product matrix * bezierpatch.
+ */
+BezierPatch EagerProduct(glm::mat4x4 const& matrix, BezierPatch const& bezierpatch)
+{
+    BezierPatch result;
+
+    for (int i = 1; i <= 4; ++i) {
+        for (int j = 1; j <= 4; ++j) {
+            glm::vec4 row(glm::row(matrix, i - 1));
+
+            glm::vec3 tmpres(0.0f);
+            for (int k = 1; k <= 4; ++k) {
+                tmpres += row[k - 1] * bezierpatch[k][j];
+            }
+            result[i][j] = tmpres;
+        }
+    }
+    return result;
+}
+
+/**
+ * Measures the throughput of a computation which is applied to every patch.
+ * \param name - the name of the computation, which is printed.
+ * \param patches - the patches.
+ * \param repetitions - the number of times every patch is processed.
+ * \param compute - the computation, it returns a point of its result which is added to a checksum, so the
+ *                  compiler cannot skip it.
+ * \return the number of processed patches per second.
+ */
+template <typename Computation>
+double Throughput(char const* name, std::vector<BezierPatch> const& patches, int repetitions, Computation compute)
+{
+    glm::vec3 checksum(0.0f);
+    auto start = std::chrono::steady_clock::now();
+    for (int repetition = 0; repetition < repetitions; ++repetition) {
+        for (BezierPatch const& G : patches) {
+            checksum += compute(G);
+        }
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(stop - start).count();
+    double throughput = double(patches.size()) * repetitions / seconds;
+    std::cout << std::setw(40) << std::left << name << std::right
+              << std::setw(10) << std::fixed << std::setprecision(3) << throughput * 1.0e-6 << " Mpatches/s"
+              << "   (checksum " << checksum.x + checksum.y + checksum.z << ")" << std::endl;
+    return throughput;
+}
+
+int main(int argc, char* argv[])
+{
+    try {
+        unsigned int npatches = (argc > 1) ? std::atoi(argv[1]) : 4096;
+        int repetitions       = (argc > 2) ? std::atoi(argv[2]) : 100;
+        if ((npatches < 1) || (repetitions < 1)) {
+            throw std::invalid_argument("the number of patches and of repetitions must be positive");
+        }
+        std::vector<BezierPatch> patches = RandomPatches(npatches);
+
+        // The subdivision matrix of the left half of the parameter interval, and the Bezier basis matrix
+        glm::mat4x4 DBL(glm::vec4(1.0f, 0.5f, 0.25f, 0.125f),
+                        glm::vec4(0.0f, 0.5f, 0.5f,  0.375f),
+                        glm::vec4(0.0f, 0.0f, 0.25f, 0.375f),
+                        glm::vec4(0.0f, 0.0f, 0.0f,  0.125f));
+        glm::mat4x4 DBLT = glm::transpose(DBL);
+        glm::mat4x4 M(glm::vec4(-1.0f,  3.0f, -3.0f, 1.0f),
+                      glm::vec4( 3.0f, -6.0f,  3.0f, 0.0f),
+                      glm::vec4(-3.0f,  3.0f,  0.0f, 0.0f),
+                      glm::vec4( 1.0f,  0.0f,  0.0f, 0.0f));
+        glm::mat4x4 MT = glm::transpose(M);
+        glm::vec4 U(0.125f, 0.25f, 0.5f, 1.0f);
+        glm::vec4 V(0.027f, 0.09f, 0.3f, 1.0f);
+
+        std::cout << npatches << " patches, " << repetitions << " repetitions" << std::endl;
+
+        // A sub-patch of the subdivision, DBL^T * G * DBL
+        double fused = Throughput("fused DBL^T * G * DBL", patches, repetitions,
+            [&](BezierPatch const& G) {
+                BezierPatch S = DBLT * G * DBL;
+                return S[4][4];
+            });
+        double unfused = Throughput("eager DBL^T * G, then * DBL", patches, repetitions,
+            [&](BezierPatch const& G) {
+                BezierPatch S = EagerProduct(EagerProduct(DBLT, G), DBL);
+                return S[4][4];
+            });
+        std::cout << std::setw(40) << std::left << "speedup" << std::right
+                  << std::setw(10) << fused / unfused << std::endl;
+
+        // A point of the patch, U * M * G * M^T * V, where the parameter vectors are multiplied through the factors
+        fused = Throughput("fused U * (M * G * M^T) * V", patches, repetitions,
+            [&](BezierPatch const& G) {
+                return (U * (M * G * MT)) * V;
+            });
+        unfused = Throughput("eager (M * G) * M^T, then U * . * V", patches, repetitions,
+            [&](BezierPatch const& G) {
+                BezierPatch MGMT = EagerProduct(EagerProduct(M, G), MT);
+                return (U * MGMT) * V;
+            });
+        std::cout << std::setw(40) << std::left << "speedup" << std::right
+                  << std::setw(10) << fused / unfused << std::endl;
+    }
+    catch (std::exception const& exception) {
+        std::cerr << "Exception: " << exception.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -11,12 +11,15 @@
 #include <sstream>
 #include <cstring>
 #include <cctype>
+#include <utility>
 #include <vector>
 
 #include "glmutils.h"
 #include "traceinfo.h"
 
 
+class BezierPatchProduct;
+
 /**
  * \class BezierRow 
  * implements the concept of a row of a geometry matrix for a parametric surface where
@@ -181,6 +184,13 @@ public:
      */
     BezierPatch(BezierPatch const& bezierpatch);
 
+    /**
+     * Conversion constructor creates a new BezierPatch which is the value of a product of a BezierPatch and
+     * ordinary matrices, e.g. BezierPatch G_L = glm::transpose(DBL) * G * DBL.
+     * \param product - The product to be evaluated.
+     */
+    BezierPatch(BezierPatchProduct&& product);
+
     /**
      * Destructor destroys the current instance of BezierPatch.
      */
@@ -192,6 +202,13 @@ public:
      */
     BezierPatch& operator=(BezierPatch const& bezierpatch);
 
+    /**
+     * Assignent operator assigns the value of a product to the current instance of BezierPatch.
+     * The product may contain the current instance, e.g. G = M * G * glm::transpose(M).
+     * \param product - The product to be evaluated and assigned to this instance.
+     */
+    BezierPatch& operator=(BezierPatchProduct&& product);
+
     /**
      * Index operator - read only - returns the i'th row of the geometry matrix,
      * \param i - The index of the row to be returned.
@@ -214,6 +231,78 @@ private:
 };
 
 
+/**
+ * \class BezierPatchProduct
+ * implements a lazy product left * G * right of a BezierPatch G and two ordinary matrices.
+ * The multiplication operators of a BezierPatch by ordinary matrices return a BezierPatchProduct instead of a
+ * BezierPatch, and a chain like M * G * glm::transpose(M) only multiplies the ordinary matrices, until it is
+ * converted to a BezierPatch, or multiplied by a parameter vector. Then the product is evaluated in one pass without
+ * temporary BezierPatch, BezierRow, or BezierColumn objects.
+ * Notice, the product refers to the BezierPatch G, so it can only be used as a temporary in the expression which
+ * creates it, while G exists. It cannot be copied, and it is only accepted as an rvalue, so a product which is
+ * stored, e.g. auto P = M * f(), cannot be converted or evaluated later when G may be destroyed.
+ */
+class BezierPatchProduct {
+public:
+    /**
+     * The product cannot be copied, because the copy would refer to the same BezierPatch.
+     */
+    BezierPatchProduct(BezierPatchProduct const& product) = delete;
+
+    /**
+     * The product cannot be assigned, because it refers to a BezierPatch.
+     */
+    BezierPatchProduct& operator=(BezierPatchProduct const& product) = delete;
+
+    /**
+     * Destructor destroys the current instance of BezierPatchProduct.
+     * It is not virtual, because a product is only a temporary of an expression.
+     */
+    ~BezierPatchProduct();
+
+    /**
+     * Index operator - read only - evaluates the i'th row of the product, so e.g. (M * G)[i][j] is an entry of
+     * the product like it is for a BezierPatch. Only the i'th row is computed.
+     * \param i - The index of the row to be returned. Notice, the starts at 1 and ends at 4.
+     * \return the i'th row of the product.
+     */
+    BezierRow operator[](int i) &&;
+
+private:
+    /**
+     * Parameterized constructor creates the product left * bezierpatch * right.
+     * \param left - The ordinary matrix which left-multiplies the BezierPatch.
+     * \param bezierpatch - The BezierPatch.
+     * \param right - The ordinary matrix which right-multiplies the BezierPatch.
+     */
+    BezierPatchProduct(glm::mat4x4 const& left, BezierPatch const& bezierpatch, glm::mat4x4 const& right);
+
+    /**
+     * Move constructor, which the operators need to return a product.
+     * \param product - The product to be moved.
+     */
+    BezierPatchProduct(BezierPatchProduct&& product);
+
+    /**
+     * Evaluates the product.
+     * \param entries - On return entries[i - 1][j - 1] is the entry i,j of the product, 1 <= i, j <= 4.
+     */
+    void Evaluate(glm::vec3 entries[4][4]) const;
+
+    glm::mat4x4        left;
+    BezierPatch const& bezierpatch;
+    glm::mat4x4        right;
+
+    friend class BezierPatch;
+    friend BezierPatchProduct operator*(BezierPatch const& bezierpatch, glm::mat4x4 const& matrix);
+    friend BezierPatchProduct operator*(glm::mat4x4 const& matrix, BezierPatch const& bezierpatch);
+    friend BezierPatchProduct operator*(BezierPatchProduct&& product, glm::mat4x4 const& matrix);
+    friend BezierPatchProduct operator*(glm::mat4x4 const& matrix, BezierPatchProduct&& product);
+    friend BezierColumn operator*(BezierPatchProduct&& product, glm::vec4 const& vector);
+    friend BezierRow operator*(glm::vec4 const& vector, BezierPatchProduct&& product);
+};
+
+
 /**
  * \file bezierpatch.h
  * \brief Utility Functions and operators
@@ -277,18 +366,34 @@ BezierRow Transpose(BezierColumn const& beziercolumn);
  * This can be used to right-multiply a Bezier geometry matrix by an ordinary matrix (a basis matrix).
  * \param bezierpatch - The BezierPatch that should be multiplied.
  * \param matrix - The ordinary matrix to be right-multiplied (basis matrix) by the bezier patch.
- * \return The product bezierpatch * matrix which is of type BezierPatch.
+ * \return The product bezierpatch * matrix which is of type BezierPatchProduct, and it converts to a BezierPatch.
  */
-BezierPatch operator*(BezierPatch const& bezierpatch, glm::mat4x4 const& matrix);
+BezierPatchProduct operator*(BezierPatch const& bezierpatch, glm::mat4x4 const& matrix);
 
 /**
  * Multiplication operator, left-multiplies a BezierPatch by an ordinary matrix (a basis matrix).
  * This can be used to left-multiply a BezierPatch by a basis matrix. 
  * \param bezierpatch - The BezierPatch that should be multimplied.
  * \param matrix - The matrix (a basis matrix) that is left-multiplied by the bezier patch.
- * \return The product matrix * bezierpatch which is of type BezierPatch.
+ * \return The product matrix * bezierpatch which is of type BezierPatchProduct, and it converts to a BezierPatch.
+ */
+BezierPatchProduct operator*(glm::mat4x4 const& matrix, BezierPatch const& bezierpatch);
+
+/**
+ * Multiplication operator, right-multiplies a product of a BezierPatch by an ordinary matrix (a basis matrix).
+ * \param product - The product that should be multiplied.
+ * \param matrix - The ordinary matrix which right-multiplies the product.
+ * \return The product product * matrix which is of type BezierPatchProduct, and it converts to a BezierPatch.
  */
-BezierPatch operator*(glm::mat4x4 const& matrix, BezierPatch const& bezierpatch);
+BezierPatchProduct operator*(BezierPatchProduct&& product, glm::mat4x4 const& matrix);
+
+/**
+ * Multiplication operator, left-multiplies a product of a BezierPatch by an ordinary matrix (a basis matrix).
+ * \param matrix - The ordinary matrix which left-multiplies the product.
+ * \param product - The product that should be multiplied.
+ * \return The product matrix * product which is of type BezierPatchProduct, and it converts to a BezierPatch.
+ */
+BezierPatchProduct operator*(glm::mat4x4 const& matrix, BezierPatchProduct&& product);
 
 /**
  * Multiplication operator, right-multiplies a BezierPatch by an ordinary vector (a parameter vector).
@@ -308,6 +413,24 @@ BezierColumn operator*(BezierPatch const& bezierpatch, glm::vec4 const& vector);
  */
 BezierRow operator*(glm::vec4 const& vector, BezierPatch const& bezierpatch);
 
+/**
+ * Multiplication operator, right-multiplies a product of a BezierPatch by an ordinary vector (a parameter vector).
+ * The product is not evaluated, the vector is multiplied through the factors from the right.
+ * \param product - The product that should be multiplied.
+ * \param vector - The vector (a parameter vector) that is right-multiplied by the product.
+ * \return The product product * vector which is of type BezierColumn.
+ */
+BezierColumn operator*(BezierPatchProduct&& product, glm::vec4 const& vector);
+
+/**
+ * Multiplication operator, left-multiplies a product of a BezierPatch by an ordinary vector (a parameter vector).
+ * The product is not evaluated, the vector is multiplied through the factors from the left.
+ * \param vector - The vector (a parameter vector) that is left-multiplied by the product.
+ * \param product - The product that should be multiplied.
+ * \return The product vector * product which is of type BezierRow.
+ */
+BezierRow operator*(glm::vec4 const& vector, BezierPatchProduct&& product);
+
 /**
  * Multiplication operator, right-multiplies a BezierRow by an ordinary vector (a parameter vector).
  * This can be used to right-multiply a BezierRow by a parameter vector. 
@@ -368,4 +491,12 @@ std::ostream& operator<<(std::ostream& s, BezierColumn const& beziercolumn);
  */
 std::ostream& operator<<(std::ostream& s, BezierPatch const& bezierpatch);
 
+/**
+ * Insertion operator, inserts the value of a product of a BezierPatch into an ostream.
+ * \param s - The ostream which the product should be inserted into.
+ * \param product - The product that should be inserted into the ostream.
+ * \return The ostream which the product has been inserted into.
+ */
+std::ostream& operator<<(std::ostream& s, BezierPatchProduct&& product);
+
 #endif
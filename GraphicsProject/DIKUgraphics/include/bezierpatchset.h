@@ -0,0 +1,200 @@
+#ifndef __BEZIERPATCHSET_H__
+#define __BEZIERPATCHSET_H__
+
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <cstddef>
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "glmutils.h"
+#include "bezierpatch.h"
+
+
+/**
+ * \class AlignedAllocator
+ * An allocator for std::vector which aligns the storage to Alignment bytes, e.g. the width of a vector register
+ * or a cache line, so loops over the storage can use aligned vector loads.
+ */
+template <typename T, std::size_t Alignment>
+class AlignedAllocator {
+public:
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind {
+        typedef AlignedAllocator<U, Alignment> other;
+    };
+
+    AlignedAllocator() {}
+
+    template <typename U>
+    AlignedAllocator(AlignedAllocator<U, Alignment> const&) {}
+
+    /**
+     * Allocates storage for n objects. The block is over-allocated by Alignment bytes plus room for a pointer,
+     * the returned address is rounded up to a multiple of Alignment, and the address of the block is stored
+     * just before it, so the allocator does not need the aligned operator new of C++17.
+     * \param n - the number of objects.
+     * \return the aligned storage.
+     */
+    T* allocate(std::size_t n)
+    {
+        void* block = ::operator new(n * sizeof(T) + Alignment + sizeof(void*));
+        std::uintptr_t address = reinterpret_cast<std::uintptr_t>(block) + sizeof(void*);
+        address = (address + Alignment - 1) / Alignment * Alignment;
+        reinterpret_cast<void**>(address)[-1] = block;
+        return reinterpret_cast<T*>(address);
+    }
+
+    /**
+     * Releases storage which was allocated by allocate(...).
+     * \param p - the aligned storage.
+     */
+    void deallocate(T* p, std::size_t)
+    {
+        ::operator delete(reinterpret_cast<void**>(p)[-1]);
+    }
+
+    template <typename U>
+    bool operator==(AlignedAllocator<U, Alignment> const&) const { return true; }
+
+    template <typename U>
+    bool operator!=(AlignedAllocator<U, Alignment> const&) const { return false; }
+};
+
+
+/**
+ * \class BezierPatchSet
+ * A packed store of many Bezier patches in structure of arrays layout. For each coordinate and each of the 16
+ * control points there is one contiguous array over all patches, so the kernels below process the whole set at once
+ * in loops over the patches which the compiler can vectorize. Each array starts on a 64-byte boundary,
+ * and it is padded to a multiple of 16 patches. Unlike BezierPatch, the store has no per-patch objects, i.e.
+ * no virtual destructors and no temporary copies, and the control points of a patch are not scattered.
+ *
+ * The control point G[i][j] of a BezierPatch, 1 <= i, j <= 4, where i belongs to u and j belongs to v,
+ * is control point number 4 * (i - 1) + (j - 1) of the store.
+ */
+class BezierPatchSet {
+public:
+    /**
+     * The alignment of the arrays in bytes.
+     */
+    static std::size_t const Alignment = 64;
+
+    /**
+     * Default constructor, creates an empty set.
+     */
+    BezierPatchSet();
+
+    /**
+     * Parameterized constructor, packs a vector of bezier patches.
+     * \param bezierpatches - the bezier patches.
+     */
+    BezierPatchSet(std::vector<BezierPatch> const& bezierpatches);
+
+    /**
+     * Parameterized constructor, reads the bezier patches from a file, see ReadBezierPatches(...).
+     * \param filename - the name of the file containing the bezier patches.
+     */
+    BezierPatchSet(std::string const& filename);
+
+    /**
+     * Destroys the current instance of the set.
+     */
+    virtual ~BezierPatchSet();
+
+    /**
+     * The number of patches in the set.
+     * \return the number of patches.
+     */
+    unsigned int NumberOfPatches() const;
+
+    /**
+     * The distance in floats between the arrays of two consecutive control points or coordinates,
+     * i.e. the number of patches rounded up to a multiple of 16.
+     * \return the stride of the arrays.
+     */
+    unsigned int Stride() const;
+
+    /**
+     * The array of one coordinate of one control point over all patches.
+     * \param coordinate - the coordinate, 0 = x, 1 = y, 2 = z.
+     * \param controlpoint - the control point, 0 <= controlpoint < 16.
+     * \return the aligned array of NumberOfPatches() floats.
+     */
+    float const* Coordinates(int coordinate, int controlpoint) const;
+
+    /**
+     * Appends a patch to the set.
+     * \param bezierpatch - the patch.
+     */
+    void Append(BezierPatch const& bezierpatch);
+
+    /**
+     * Unpacks a patch of the set.
+     * \param patch - the number of the patch, 0 <= patch < NumberOfPatches().
+     * \return the patch as a BezierPatch.
+     */
+    BezierPatch Patch(unsigned int patch) const;
+
+    /**
+     * Transforms the control points of all patches, where a projective transformation is followed by the division
+     * by w. An affine transformation of the control points is the same transformation of the patches.
+     * \param matrix - the transformation.
+     */
+    void Transform(glm::mat4x4 const& matrix);
+
+    /**
+     * Evaluates all patches at the same parameters.
+     * \param u - the first parameter, 0 <= u <= 1.
+     * \param v - the second parameter, 0 <= v <= 1.
+     * \param points - room for NumberOfPatches() points, on return the points of the patches.
+     * \param normals - room for NumberOfPatches() normals, on return the unit normals oriented as S_u x S_v,
+     *                  or the zero vector where it vanishes. If it is a null pointer no normals are computed.
+     */
+    void Evaluate(float u, float v, glm::vec3* points, glm::vec3* normals = nullptr) const;
+
+    /**
+     * Subdivides all patches once at u = 1/2 and v = 1/2.
+     * \return the set of 4 * NumberOfPatches() sub-patches, where sub-patch k of patch p is patch
+     *         k * NumberOfPatches() + p, and k = 0, 1, 2, 3 is (low u, low v), (low u, high v), (high u, low v),
+     *         and (high u, high v), i.e. the order of BezierSurface's recursive subdivision.
+     */
+    BezierPatchSet Subdivide() const;
+
+    /**
+     * Computes the axis aligned bounding boxes of the control points of all patches,
+     * which contain the patches because of the convex hull property.
+     * \param boxmin - room for NumberOfPatches() points, on return the lower corners of the bounding boxes.
+     * \param boxmax - room for NumberOfPatches() points, on return the upper corners of the bounding boxes.
+     */
+    void BoundingBoxes(glm::vec3* boxmin, glm::vec3* boxmax) const;
+
+private:
+    /**
+     * Changes the stride of the arrays, and moves the patches to the new positions.
+     * \param stride - the new stride, a multiple of 16.
+     */
+    void Restride(unsigned int stride);
+
+    /**
+     * The array of one coordinate of one control point over all patches.
+     * \param coordinate - the coordinate, 0 = x, 1 = y, 2 = z.
+     * \param controlpoint - the control point, 0 <= controlpoint < 16.
+     * \return the aligned array.
+     */
+    float* Array(int coordinate, int controlpoint);
+
+    unsigned int npatches;      // The number of patches
+    unsigned int stride;        // The distance in floats between consecutive arrays
+
+    // The coordinates, coordinate c of control point k of patch p is entry (16 * c + k) * stride + p
+    std::vector<float, AlignedAllocator<float, Alignment>> coordinates;
+};
+
+#endif
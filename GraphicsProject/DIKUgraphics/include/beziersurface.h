@@ -9,7 +9,10 @@
 #include <vector>
 
 #include "glmutils.h"
+#include "camera.h"
 #include "bezierpatch.h"
+#include "bezierpatchset.h"
+#include "quantization.h"
 
 
 /**
@@ -73,13 +76,111 @@ public:
 
     /**
      * Specify how many times the BezierSurface should be subdivided.
-     * \param subdivisionlevel - the number of subdivisions that should be done.
+     * The sub-patches of the levels within two of the current one are kept, so a finer level subdivides the finest
+     * kept sub-patches further, and a slightly coarser or finer level reuses them, see ReleaseLeaves().
+     * \param subdivisionlevel - the number of subdivisions that should be done, 0 <= Nsubdivisions <= 12.
      * \return the previous number or subdivisions.
      */
     int NumberOfSubdivisions(int Nsubdivisions);
 
+    /**
+     * Releases the kept sub-patches of the uniform subdivision, which are computed again when they are needed.
+     */
+    void ReleaseLeaves();
+
+    /**
+     * Tells whether the patches are tessellated by direct evaluation or by subdivision.
+     * \return true if the patches are evaluated directly, false if they are subdivided.
+     */
+    bool DirectEvaluation() const;
+
+    /**
+     * Chooses whether the patches are tessellated by direct evaluation or by subdivision.
+     * The direct evaluation samples each patch on the same (2^NumberOfSubdivisions() + 1)^2 grid of parameters
+     * as the subdivision, as the products (U M) G (V M)^T of precomputed basis tables, and it computes
+     * the normals from the exact partial derivatives. The triangles are written in the same order in both cases.
+     * \param directevaluation - true if the patches should be evaluated directly, false if they should be subdivided.
+     */
+    void DirectEvaluation(bool directevaluation);
+
+    /**
+     * Tells whether the subdivision produces the sub-patches from precomputed sub-interval operators or recursively.
+     * \return true if the sub-interval operators are used, false if the patches are subdivided recursively.
+     */
+    bool SubintervalOperators() const;
+
+    /**
+     * Chooses whether the subdivision produces the sub-patches from precomputed sub-interval operators or recursively.
+     * The sub-interval operators D_i are the products of DBL and DBR which map the patch to its 2^NumberOfSubdivisions()
+     * sub-intervals, and they are computed once per level, so each leaf sub-patch D_i^T G D_j is produced directly.
+     * The triangles are the same in both cases, and DirectEvaluation() takes precedence over both.
+     * \param subintervaloperators - true if the sub-interval operators should be used, false if the patches should be
+     *                               subdivided recursively.
+     */
+    void SubintervalOperators(bool subintervaloperators);
+
+    /**
+     * Tells whether the patches are subdivided adaptively for a view or uniformly.
+     * \return true if the patches are subdivided adaptively, false if they are subdivided uniformly.
+     */
+    bool AdaptiveSubdivision() const;
+
+    /**
+     * Subdivides the patches adaptively for a view. Each sub-patch is subdivided until the projected flatness error,
+     * i.e. the largest distance on the screen between its control points and the bilinear interpolation of its
+     * corners, is at most pixeltolerance, or until it is subdivided NumberOfSubdivisions() times, so near patches
+     * get detail and far patches almost none. A sub-patch which is partly behind the camera is subdivided fully.
+     * Where a leaf meets finer leaves, inside its patch or in a neighbouring patch with the same edge control points,
+     * the vertices of the finer leaves are inserted into its border, so the mesh has no T-junctions and no cracks.
+     * \param camera - the camera which views the surface.
+     * \param pixeltolerance - the largest projected flatness error of a leaf in pixels, pixeltolerance > 0.
+     * \param screensize - the width and height of the viewport in pixels.
+     * \param model - the transformation from model coordinates to world coordinates.
+     */
+    void AdaptiveSubdivision(Camera const& camera, float pixeltolerance, glm::vec2 const& screensize,
+                             glm::mat4x4 const& model = glm::mat4x4(1.0f));
+
+    /**
+     * Subdivides all patches uniformly NumberOfSubdivisions() times, which is the default.
+     */
+    void UniformSubdivision();
+
+    /**
+     * Tells whether the tessellation is culled against a view.
+     * \return true if the patches are culled, false if all patches are tessellated.
+     */
+    bool Culling() const;
+
+    /**
+     * Culls the tessellation against a view. A patch or sub-patch is rejected during the subdivision if the bounding
+     * box of its control points is outside the view volume, or if backfaces is true and its normal cone, i.e. a cone
+     * which contains the cross products of the differences of its control points, faces away from the camera.
+     * The bounding boxes and normal cones of the patches are computed once and cached. The recursive, the
+     * sub-interval, and the adaptive subdivision cull the sub-patches, the other tessellations cull whole patches.
+     * \param camera - the camera which views the surface.
+     * \param model - the transformation from model coordinates to world coordinates.
+     * \param backfaces - true if patches which face away from the camera should be culled, see FrontFacing().
+     */
+    void Culling(Camera const& camera, glm::mat4x4 const& model = glm::mat4x4(1.0f), bool backfaces = true);
+
+    /**
+     * Culls the tessellation against a view, like Culling(Camera const&, mat4x4 const&, bool).
+     * \param transformation - the transformation from model coordinates to the canonical view volume
+     *                         [-1, 1] x [-1, 1] x [-1, 0], where the viewer is towards z > 0.
+     *                         It may be a perspective or a parallel projection.
+     * \param backfaces - true if patches which face away from the camera should be culled, see FrontFacing().
+     */
+    void Culling(glm::mat4x4 const& transformation, bool backfaces = true);
+
+    /**
+     * Tessellates all patches, which is the default.
+     */
+    void NoCulling();
+
     /**
      * Computes the vertices of the BezierSurface.
+     * The patches are subdivided concurrently, and each patch writes the 6 * 4^NumberOfSubdivisions() triangle
+     * vertices and normals of its range directly, so the result is the same as subdividing the patches in order.
      * \return a vector containing the vertices of the triangles that approximate the BezierSurface.
      */
     std::vector<glm::vec3> const& Vertices();
@@ -91,9 +192,80 @@ public:
      */
     std::vector<glm::vec3> const& Normals();
 
+    /**
+     * The number of triangle vertices, i.e. the number of entries in Vertices() and Normals().
+     * \return the number of triangle vertices.
+     */
+    unsigned int NumberOfVertices();
+
+    /**
+     * Writes the triangle vertices and normals interleaved into a destination supplied by the caller,
+     * e.g. a mapped vertex buffer, i.e. vertex 1, normal 1, vertex 2, normal 2, etc.
+     * \param destination - room for 2 * NumberOfVertices() 3D vectors.
+     */
+    void WriteInterleaved(glm::vec3* destination);
+
+    /**
+     * Computes the axis aligned bounding box of the surface, which is needed to decode quantized vertices.
+     * \param boxmin - on return the lower corner of the bounding box.
+     * \param boxmax - on return the upper corner of the bounding box.
+     */
+    void BoundingBox(glm::vec3& boxmin, glm::vec3& boxmax);
+
+    /**
+     * Writes the triangle vertices and normals as quantized vertices into a destination supplied by the caller.
+     * The positions are quantized relative to the bounding box returned by BoundingBox(...).
+     * \param destination - room for NumberOfVertices() quantized vertices.
+     */
+    void WriteQuantized(QuantizedVertex* destination);
+
+    /**
+     * Computes the vertices of the indexed mesh of the BezierSurface. The patches are tessellated uniformly
+     * NumberOfSubdivisions() times, but each vertex is stored once, and the vertices on a border which patches share,
+     * i.e. where they have the same control point indices in the data file, are shared by the patches,
+     * so adjacent patches meet exactly. The adaptive subdivision and the culling do not apply to the indexed mesh.
+     * \return a vector containing the vertices, which are indexed by Indices().
+     */
+    std::vector<glm::vec3> const& IndexedVertices();
+
+    /**
+     * Computes the normals of the indexed mesh of the BezierSurface. The normal of a shared vertex is the average
+     * of the normals of the patches which share it, and the normals are negated if the surface is not front facing.
+     * \return a vector containing the normals of the vertices of IndexedVertices().
+     */
+    std::vector<glm::vec3> const& IndexedNormals();
+
+    /**
+     * The indices into IndexedVertices() and IndexedNormals() of the triangle vertices.
+     * The first 3 entries define the first triangle, the next 3 entries define the second triangle etc.
+     * The triangles have the same orientation as those returned by Vertices(), except that triangles which
+     * degenerate because an edge of a patch is collapsed to one control point are left out.
+     * \return a vector containing the indices of the triangle vertices.
+     */
+    std::vector<unsigned int> const& Indices();
+
 protected:
 
 private:
+    /**
+     * A leaf of the adaptive subdivision of a patch.
+     */
+    struct Leaf {
+        int level;          // The number of times the patch was subdivided
+        unsigned int U;     // The smallest u of the leaf in units of 2^-NumberOfSubdivisions()
+        unsigned int V;     // The smallest v of the leaf in units of 2^-NumberOfSubdivisions()
+    };
+
+    /**
+     * The bounds of a patch, which are used for culling.
+     */
+    struct Bounds {
+        glm::vec3 boxmin;   // The lower corner of the bounding box of the control points
+        glm::vec3 boxmax;   // The upper corner of the bounding box of the control points
+        glm::vec3 axis;     // The axis of the normal cone, oriented as S_u x S_v
+        float angle;        // The half angle of the normal cone, pi if the normals are not bounded by a cone
+    };
+
     // private member functions
 
     /**
@@ -128,11 +300,141 @@ private:
 			  int index_41, int index_42, int index_43, int index_44) const;
     
     /**
-     * subdivides a BezierPatch
+     * subdivides a BezierPatch, and writes the 6 * 4^level triangle vertices and normals of the subpatches,
+     * except for the subpatches which are culled. Only the destination is written, so several patches can be subdivided concurrently.
      * \param patch - the bezierpatch which should be subdivided.
      * \param level - the number of times the patch should be subdivided.
+     * \param vertices - the destination of the triangle vertices, on return it points past the written vertices.
+     * \param normals - the destination of the normals, on return it points past the written normals.
+     * \param tests - the culling tests which are needed for the sub-patches, see cull_bezierpatch(...).
+     */
+    void subdivide_bezierpatch(BezierPatch const& G, int level, glm::vec3*& vertices, glm::vec3*& normals,
+                               int tests = 0) const;
+
+    /**
+     * Computes the bounding box and the normal cone of a BezierPatch from its control points,
+     * which contain the patch and its normals because of the convex hull property.
+     * \param G - the bezierpatch.
+     * \return the bounds of the patch.
+     */
+    static Bounds bezierpatch_bounds(BezierPatch const& G);
+
+    /**
+     * Caches the bounds of the bezierpatches, unless they are already cached.
+     */
+    void ComputePatchBounds();
+
+    /**
+     * Tests the bounds of a patch against the culling view.
+     * \param bounds - the bounds of the patch.
+     * \param tests - the tests which are needed, i.e. the tests which were inconclusive for the parent patch.
+     * \return -1 if the patch is culled, else the tests which are still needed for its sub-patches.
+     */
+    int cull_bezierpatch(Bounds const& bounds, int tests) const;
+
+    /**
+     * Subdivides the finest kept sub-patches below a level until the sub-patches of the level are kept. If the level
+     * is computed, only the levels within two of it are kept afterwards, i.e. the two coarser levels and any of the
+     * two finer levels which were already computed.
+     * \param level - the number of subdivisions.
+     */
+    void ComputeLeaves(int level);
+
+    /**
+     * Computes the triangles of the adaptive subdivision for the view given by AdaptiveSubdivision(...).
+     */
+    void adaptive_subdivision();
+
+    /**
+     * Subdivides a BezierPatch until its leaves are flat on the screen, and appends the leaves.
+     * \param G - the bezierpatch which should be subdivided.
+     * \param level - the number of times the original patch has been subdivided to obtain G.
+     * \param U - the smallest u of G in units of 2^-NumberOfSubdivisions().
+     * \param V - the smallest v of G in units of 2^-NumberOfSubdivisions().
+     * \param leaves - the leaves of the original patch, the leaves of G are appended.
+     * \param tests - the culling tests which are needed for the sub-patches, see cull_bezierpatch(...).
+     */
+    void adapt_bezierpatch(BezierPatch const& G, int level, unsigned int U, unsigned int V,
+                           std::vector<Leaf>& leaves, int tests) const;
+
+    /**
+     * The projected flatness error of a BezierPatch.
+     * \param G - the bezierpatch.
+     * \return the largest distance in pixels between the projected control points and the bilinear interpolation
+     * of the projected corners, or the largest float if a control point is behind the camera.
+     */
+    float projected_flatness(BezierPatch const& G) const;
+
+    /**
+     * Computes the sub-interval operators of a subdivision level, unless they are already computed.
+     * \param level - the number of subdivisions, i.e. the parameter interval is divided into 2^level sub-intervals.
+     */
+    void ComputeSubintervals(int level);
+
+    /**
+     * Subdivides a BezierPatch without recursion, and writes the same 6 * 4^NumberOfSubdivisions() triangle vertices
+     * and normals as the recursive subdivision, except for the leaves which are culled.
+     * Each leaf sub-patch is produced directly by the sub-interval operators.
+     * \param G - the bezierpatch which should be subdivided.
+     * \param vertices - the destination of the triangle vertices, on return it points past the written vertices.
+     * \param normals - the destination of the normals, on return it points past the written normals.
+     * \param tests - the culling tests which are needed for the leaves, see cull_bezierpatch(...).
+     */
+    void subdivide_bezierpatch(BezierPatch const& G, glm::vec3*& vertices, glm::vec3*& normals, int tests) const;
+
+    /**
+     * Computes the basis tables of the direct evaluation, unless they already have the right size.
+     * \param nsamples - the number of samples of u and of v, i.e. the parameters k / (nsamples - 1).
      */
-    void subdivide_bezierpatch(BezierPatch const& G, int level);
+    void ComputeBasis(unsigned int nsamples);
+
+    /**
+     * Evaluates a BezierPatch at the grid of samples of the basis tables.
+     * \param G - the bezierpatch which should be evaluated.
+     * \param gridvertices - room for nsamples x nsamples points, on return the sample (u_a, v_b) is entry
+     *                       a * nsamples + b.
+     * \param gridnormals - room for nsamples x nsamples normals, on return the unit normals oriented as S_u x S_v.
+     */
+    void sample_bezierpatch(BezierPatch const& G, glm::vec3* gridvertices, glm::vec3* gridnormals) const;
+
+    /**
+     * Tessellates a BezierPatch by evaluating it directly at the samples of the basis tables,
+     * and writes the same 6 * 4^NumberOfSubdivisions() triangle vertices and normals as the subdivision.
+     * \param G - the bezierpatch which should be tessellated.
+     * \param vertices - the destination of the triangle vertices, on return it points past the written vertices.
+     * \param normals - the destination of the normals, on return it points past the written normals.
+     */
+    void evaluate_bezierpatch(BezierPatch const& G, glm::vec3*& vertices, glm::vec3*& normals) const;
+
+    /**
+     * Writes the two triangles of a quadrilateral with the orientation given by FrontFacing().
+     * \param lower_left - the vertex at the smallest u and v.
+     * \param lower_right - the vertex at the largest u and the smallest v.
+     * \param upper_right - the vertex at the largest u and v.
+     * \param upper_left - the vertex at the smallest u and the largest v.
+     * \param normal_lower_left - the unit normal of lower_left, oriented as S_u x S_v.
+     * \param normal_lower_right - the unit normal of lower_right.
+     * \param normal_upper_right - the unit normal of upper_right.
+     * \param normal_upper_left - the unit normal of upper_left.
+     * \param vertices - the destination of the 6 triangle vertices, on return it points past the written vertices.
+     * \param normals - the destination of the 6 normals, on return it points past the written normals.
+     */
+    void write_quadrilateral(glm::vec3 const& lower_left,  glm::vec3 const& lower_right,
+                             glm::vec3 const& upper_right, glm::vec3 const& upper_left,
+                             glm::vec3 const& normal_lower_left,  glm::vec3 const& normal_lower_right,
+                             glm::vec3 const& normal_upper_right, glm::vec3 const& normal_upper_left,
+                             glm::vec3*& vertices, glm::vec3*& normals) const;
+
+    /**
+     * Numbers the control points of the patches, where equal control points get the same number,
+     * for a surface whose patches are not read from a data file.
+     */
+    void ComputeControlPointIndices();
+
+    /**
+     * Computes the indexed mesh, see IndexedVertices(), IndexedNormals(), and Indices().
+     */
+    void indexed_tessellation();
 
     // private variables
 
@@ -151,9 +453,57 @@ private:
     // the number of times the bezierpathces should be devided.
     int nsubdivisions;
 
+    // are the bezierpatches evaluated directly instead of subdivided.
+    bool directevaluation;
+
+    // the basis tables of the direct evaluation, entry i * nsamples + k is the Bernstein polynomial i,
+    // respectively its derivative, at the parameter k / (nsamples - 1).
+    std::vector<float> basis;
+    std::vector<float> dbasis;
+
+    // are the leaf sub-patches produced by the sub-interval operators instead of recursively.
+    bool subintervaloperators;
+
+    // the sub-interval operators of the subdivision, entry i maps a patch to its sub-interval i of 2^level.
+    std::vector<glm::mat4x4> subintervals;
+
+    // are the bezierpatches subdivided adaptively for a view instead of uniformly.
+    bool adaptive;
+
+    // the transformation from model coordinates to clip coordinates of the view of the adaptive subdivision.
+    glm::mat4x4 adaptivetransformation;
+
+    // half the size of the viewport in pixels, i.e. the scaling from normalized device coordinates to pixels.
+    glm::vec2 halfscreensize;
+
+    // the largest projected flatness error of a leaf of the adaptive subdivision in pixels.
+    float pixeltolerance;
+
+    // is the tessellation culled against a view, and are the patches which face away from it culled.
+    bool culling;
+    bool backfaceculling;
+
+    // the transformation from model coordinates to clip coordinates of the culling view.
+    glm::mat4x4 cullingtransformation;
+
+    // the center of projection of the culling view in homogeneous model coordinates, w = 1 for a perspective
+    // projection, and w = 0 for a parallel projection, where it is the direction towards the viewer.
+    glm::vec4 eye;
+
+    // the cached bounds of the bezierpatches.
+    std::vector<Bounds> patchbounds;
+
     // the original bezierpatches.
     std::vector<BezierPatch> BezierPatches;
 
+    // the sub-patches of the uniform subdivision, leaves[k] contains the 4^k sub-patches of each bezierpatch
+    // after k subdivisions in the order of BezierPatchSet::Subdivide(), or nothing if the level is not kept.
+    // They are not copied with the surface.
+    std::vector<BezierPatchSet> leaves;
+
+    // the numbers of the 16 control points of each bezierpatch, i.e. the vertex numbers of the data file.
+    std::vector<int> controlpointindices;
+
     // the vertices of the approximating triangles after subdivision "level" times.
     bool VerticesOK;
     std::vector<glm::vec3> vertices;
@@ -161,6 +511,12 @@ private:
     // the normals of the approximating triangles after subdivision "level" times.
     bool NormalsOK;
     std::vector<glm::vec3> normals;
+
+    // the indexed mesh, where the vertices on the shared borders of the bezierpatches are stored once.
+    bool IndexedOK;
+    std::vector<glm::vec3> indexedvertices;
+    std::vector<glm::vec3> indexednormals;
+    std::vector<unsigned int> indices;
 };
 
 #endif
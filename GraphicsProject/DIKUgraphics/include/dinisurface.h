@@ -60,6 +60,31 @@ public:
      */
     glm::vec3 Normal(float u, float v) const;
 
+    /**
+     * Computes the points and the normals of the surface at a batch of parameters.
+     * The sines and cosines of all the parameters are computed by one vectorized call of SinCos.
+     * \param u - the values of the u-parameter, the height angle.
+     * \param v - the values of the v-parameter, the azimuth angle.
+     * \param count - the number of pairs of parameters.
+     * \param vertices - the destination of the count points on the surface.
+     * \param normals - the destination of the count normals of the surface.
+     */
+    void EvaluateBatch(float const* u, float const* v, unsigned int count,
+                       glm::vec3* vertices, glm::vec3* normals) const;
+
+    /**
+     * Computes the points and the normals of the surface at each pair of parameters (u_i, v_j).
+     * The trigonometric and logarithmic factors are computed once per u-value and once per v-value.
+     * \param u - the values of the u-parameter, the height angle.
+     * \param nu - the number of u-values.
+     * \param v - the values of the v-parameter, the azimuth angle.
+     * \param nv - the number of v-values.
+     * \param vertices - the destination of the nu * nv points on the surface.
+     * \param normals - the destination of the nu * nv normals of the surface.
+     */
+    void EvaluateGridBatch(float const* u, unsigned int nu, float const* v, unsigned int nv,
+                           glm::vec3* vertices, glm::vec3* normals) const;
+
 protected:
 
 private:
@@ -4,10 +4,12 @@
 #include <iostream>
 #include <iomanip>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
 #include "glmutils.h"
 #include "parametricsurface.h"
+#include "seamwelder.h"
 
 
 /**
@@ -48,6 +50,31 @@ public:
      */
     glm::vec3 Normal(float u, float v) const;
 
+    /**
+     * Computes the points and the normals of the surface at a batch of parameters.
+     * The sines and cosines of all the parameters are computed by one vectorized call of SinCos.
+     * \param u - the values of the u-parameter.
+     * \param v - the values of the v-parameter.
+     * \param count - the number of pairs of parameters.
+     * \param vertices - the destination of the count points on the surface.
+     * \param normals - the destination of the count normals of the surface.
+     */
+    void EvaluateBatch(float const* u, float const* v, unsigned int count,
+                       glm::vec3* vertices, glm::vec3* normals) const;
+
+    /**
+     * Computes the points and the normals of the surface at each pair of parameters (u_i, v_j).
+     * The sines and cosines are computed once per u-value and once per v-value.
+     * \param u - the values of the u-parameter.
+     * \param nu - the number of u-values.
+     * \param v - the values of the v-parameter.
+     * \param nv - the number of v-values.
+     * \param vertices - the destination of the nu * nv points on the surface.
+     * \param normals - the destination of the nu * nv normals of the surface.
+     */
+    void EvaluateGridBatch(float const* u, unsigned int nu, float const* v, unsigned int nv,
+                           glm::vec3* vertices, glm::vec3* normals) const;
+
 protected:
   
 private:
@@ -92,6 +119,31 @@ protected:
      * \return a 3D vector containing the coordinates of the normal on the surface.
      */
     glm::vec3 Normal(float u, float v) const;
+
+    /**
+     * Computes the points and the normals of the surface at a batch of parameters.
+     * The sines and cosines of all the parameters are computed by one vectorized call of SinCos.
+     * \param u - the values of the u-parameter.
+     * \param v - the values of the v-parameter.
+     * \param count - the number of pairs of parameters.
+     * \param vertices - the destination of the count points on the surface.
+     * \param normals - the destination of the count normals of the surface.
+     */
+    void EvaluateBatch(float const* u, float const* v, unsigned int count,
+                       glm::vec3* vertices, glm::vec3* normals) const;
+
+    /**
+     * Computes the points and the normals of the surface at each pair of parameters (u_i, v_j).
+     * The sines and cosines are computed once per u-value and once per v-value.
+     * \param u - the values of the u-parameter.
+     * \param nu - the number of u-values.
+     * \param v - the values of the v-parameter.
+     * \param nv - the number of v-values.
+     * \param vertices - the destination of the nu * nv points on the surface.
+     * \param normals - the destination of the nu * nv normals of the surface.
+     */
+    void EvaluateGridBatch(float const* u, unsigned int nu, float const* v, unsigned int nv,
+                           glm::vec3* vertices, glm::vec3* normals) const;
     
 private:
 
@@ -135,6 +187,31 @@ public:
      */
     glm::vec3 Normal(float u, float v) const;
 
+    /**
+     * Computes the points and the normals of the surface at a batch of parameters.
+     * The sines and cosines of all the parameters are computed by one vectorized call of SinCos.
+     * \param u - the values of the u-parameter.
+     * \param v - the values of the v-parameter.
+     * \param count - the number of pairs of parameters.
+     * \param vertices - the destination of the count points on the surface.
+     * \param normals - the destination of the count normals of the surface.
+     */
+    void EvaluateBatch(float const* u, float const* v, unsigned int count,
+                       glm::vec3* vertices, glm::vec3* normals) const;
+
+    /**
+     * Computes the points and the normals of the surface at each pair of parameters (u_i, v_j).
+     * The sines and cosines are computed once per u-value and once per v-value.
+     * \param u - the values of the u-parameter.
+     * \param nu - the number of u-values.
+     * \param v - the values of the v-parameter.
+     * \param nv - the number of v-values.
+     * \param vertices - the destination of the nu * nv points on the surface.
+     * \param normals - the destination of the nu * nv normals of the surface.
+     */
+    void EvaluateGridBatch(float const* u, unsigned int nu, float const* v, unsigned int nv,
+                           glm::vec3* vertices, glm::vec3* normals) const;
+
 protected:
   
 private:
@@ -179,6 +256,31 @@ public:
      */
     glm::vec3 Normal(float u, float v) const;
 
+    /**
+     * Computes the points and the normals of the surface at a batch of parameters.
+     * The sines and cosines of all the parameters are computed by one vectorized call of SinCos.
+     * \param u - the values of the u-parameter.
+     * \param v - the values of the v-parameter.
+     * \param count - the number of pairs of parameters.
+     * \param vertices - the destination of the count points on the surface.
+     * \param normals - the destination of the count normals of the surface.
+     */
+    void EvaluateBatch(float const* u, float const* v, unsigned int count,
+                       glm::vec3* vertices, glm::vec3* normals) const;
+
+    /**
+     * Computes the points and the normals of the surface at each pair of parameters (u_i, v_j).
+     * The sines and cosines are computed once per u-value and once per v-value.
+     * \param u - the values of the u-parameter.
+     * \param nu - the number of u-values.
+     * \param v - the values of the v-parameter.
+     * \param nv - the number of v-values.
+     * \param vertices - the destination of the nu * nv points on the surface.
+     * \param normals - the destination of the nu * nv normals of the surface.
+     */
+    void EvaluateGridBatch(float const* u, unsigned int nu, float const* v, unsigned int nv,
+                           glm::vec3* vertices, glm::vec3* normals) const;
+
 protected:
   
 private:
@@ -186,6 +288,18 @@ private:
 };
 
 
+/**
+ * \struct DrawRange
+ * A named range of the triangle vertices of a surface which is composed of several parts, i.e. the triangle vertices
+ * first, ..., first + count - 1 belong to the part, and can be drawn by glDrawArrays(GL_TRIANGLES, first, count).
+ */
+struct DrawRange {
+    std::string  name;   // the name of the part
+    unsigned int first;  // the index of the first triangle vertex of the part
+    unsigned int count;  // the number of triangle vertices of the part
+};
+
+
 /**
  * \class KleinBottle
  * Implements a Klein Bottle, i.e. a surface with only one side.
@@ -268,10 +382,32 @@ public:
      */
     std::vector<glm::vec3> const& Normals();
 
+    /**
+     * The parts of the Klein Bottle as named ranges of Vertices() and Normals().
+     * Each part is stored once in the composite vectors, so drawing the ranges needs no copies.
+     * \return the ranges of the "top", "bottom", "handle", and "middle" parts in this order.
+     */
+    std::vector<DrawRange> const& DrawRanges();
+
+    /**
+     * Adds the four parts and the seams between them to a seam welder, so SeamWelder::Build() creates
+     * one closed indexed mesh. Each part is closed in the u-direction, and the v-boundaries of the parts
+     * are circles which coincide pairwise, but start at different points and may run in opposite directions.
+     * The parts are referenced by the welder, so the Klein Bottle must exist until the welder is built.
+     * \param welder - the seam welder.
+     */
+    void AddParts(SeamWelder& welder);
 
 protected:
 
 private:
+    /**
+     * Samples the four parts one after another, each with the threads of its own ParallelFor,
+     * and gathers their triangle vertices and normals directly into disjoint ranges of the composite
+     * vertices and normals.
+     */
+    void Compose();
+
     int M;    // Number of samples of the u-parameter
     int N;    // Number of samples of the v-parameter
 
@@ -285,6 +421,7 @@ private:
 
     std::vector<glm::vec3> vertices;    // The sampled vertices
     std::vector<glm::vec3> normals;     // The sampled normals
+    std::vector<DrawRange> drawranges;  // The ranges of the parts in vertices and normals
 };
 
 
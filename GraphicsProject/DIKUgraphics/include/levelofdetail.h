@@ -0,0 +1,199 @@
+#ifndef __LEVELOFDETAIL_H__
+#define __LEVELOFDETAIL_H__
+
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <vector>
+
+#include "glmutils.h"
+#include "camera.h"
+#include "parametricsurface.h"
+#include "kleinbottle.h"
+#include "quantization.h"
+
+
+/**
+ * \class LevelOfDetail
+ * A chain of precomputed resolutions of a surface, i.e. M x N, M/2 x N/2, M/4 x N/4, etc.
+ * At draw time a level is selected from the size of the surface on the screen, so a distant surface
+ * is drawn with fewer vertices and triangles. Level 0 is the finest level.
+ */
+class LevelOfDetail {
+public:
+    /**
+     * Precomputes the levels of a parametric surface. Level k is sampled on the M/2^k x N/2^k grid
+     * and stored as grid vertices, grid normals, and indices, see ParametricSurface::GridVertices().
+     * The number of samples of the surface is restored afterwards.
+     * \param surface - the surface, its current numbers of samples M and N define level 0.
+     * \param nlevels - the number of levels.
+     */
+    LevelOfDetail(ParametricSurface& surface, unsigned int nlevels = 3);
+
+    /**
+     * Precomputes the levels of a Klein Bottle. Level k is sampled on the M/2^k x N/2^k grid
+     * and stored as triangle vertices and normals, i.e. the indices are empty.
+     * The number of samples of the Klein Bottle is restored afterwards.
+     * \param kleinbottle - the Klein Bottle, its current numbers of samples M and N define level 0.
+     * \param nlevels - the number of levels.
+     */
+    LevelOfDetail(KleinBottle& kleinbottle, unsigned int nlevels = 3);
+
+    /**
+     * Destroys the current instance of the level of detail chain.
+     */
+    virtual ~LevelOfDetail();
+
+    /**
+     * The number of levels.
+     * \return the number of levels.
+     */
+    unsigned int NumberOfLevels() const;
+
+    /**
+     * The number of samples in the u-direction of a level.
+     * \param level - the level, 0 <= level < NumberOfLevels().
+     * \return the number of u-samples of the level.
+     */
+    unsigned int Usamples(unsigned int level) const;
+
+    /**
+     * The number of samples in the v-direction of a level.
+     * \param level - the level, 0 <= level < NumberOfLevels().
+     * \return the number of v-samples of the level.
+     */
+    unsigned int Vsamples(unsigned int level) const;
+
+    /**
+     * The vertices of a level.
+     * \param level - the level, 0 <= level < NumberOfLevels().
+     * \return the vertices, which are indexed by Indices(level) if it is not empty, else they are triangle vertices.
+     */
+    std::vector<glm::vec3> const& Vertices(unsigned int level) const;
+
+    /**
+     * The normals of a level.
+     * \param level - the level, 0 <= level < NumberOfLevels().
+     * \return the normals of the vertices returned by Vertices(level).
+     */
+    std::vector<glm::vec3> const& Normals(unsigned int level) const;
+
+    /**
+     * The indices of the triangles of a level.
+     * \param level - the level, 0 <= level < NumberOfLevels().
+     * \return the indices into Vertices(level) and Normals(level), or an empty vector if the level is a triangle soup.
+     */
+    std::vector<unsigned int> const& Indices(unsigned int level) const;
+
+    /**
+     * The number of triangles of a level.
+     * \param level - the level, 0 <= level < NumberOfLevels().
+     * \return the number of triangles.
+     */
+    unsigned int NumberOfTriangles(unsigned int level) const;
+
+    /**
+     * The memory used by the vertices, normals, and indices of a level.
+     * \param level - the level, 0 <= level < NumberOfLevels().
+     * \return the number of bytes.
+     */
+    std::size_t MemoryUsage(unsigned int level) const;
+
+    /**
+     * Writes the resolution, the number of triangles, and the memory usage of each level to a stream.
+     * \param s - the stream which the statistics should be written to.
+     */
+    void Statistics(std::ostream& s) const;
+
+    /**
+     * The bounding box of the finest level, which is used to compute the projected size.
+     * \param boxmin - on return the lower corner of the bounding box.
+     * \param boxmax - on return the upper corner of the bounding box.
+     */
+    void BoundingBox(glm::vec3& boxmin, glm::vec3& boxmax) const;
+
+    /**
+     * The projected size above which the finest level is selected.
+     * \return the projected size of the finest level.
+     */
+    float FinestSize() const;
+
+    /**
+     * Changes the projected size above which the finest level is selected. Level k is selected for projected sizes
+     * between FinestSize() / 2^(k + 1) and FinestSize() / 2^k, i.e. the resolution follows the size on the screen.
+     * \param finestsize - the new projected size of the finest level, a fraction of the viewport.
+     */
+    void FinestSize(float finestsize);
+
+    /**
+     * The hysteresis of the level selection.
+     * \return the hysteresis.
+     */
+    float Hysteresis() const;
+
+    /**
+     * Changes the hysteresis of the level selection. The selected level only changes when the projected size is
+     * the fraction hysteresis beyond the size where the levels meet, so a surface at that distance does not
+     * switch level every frame.
+     * \param hysteresis - the new hysteresis, 0 <= hysteresis < 1.
+     */
+    void Hysteresis(float hysteresis);
+
+    /**
+     * The size of the surface on the screen, i.e. the larger side of the projected bounding box
+     * as a fraction of the viewport.
+     * \param camera - the camera which views the surface.
+     * \param model - the transformation from model coordinates to world coordinates.
+     * \return the projected size, a very large value if a part of the bounding box is behind the camera.
+     */
+    float ProjectedSize(Camera const& camera, glm::mat4x4 const& model = glm::mat4x4(1.0f)) const;
+
+    /**
+     * Selects the level which should be drawn according to the projected size and the hysteresis.
+     * \param camera - the camera which views the surface.
+     * \param model - the transformation from model coordinates to world coordinates.
+     * \return the selected level.
+     */
+    unsigned int SelectLevel(Camera const& camera, glm::mat4x4 const& model = glm::mat4x4(1.0f));
+
+    /**
+     * The level which was selected by the last call of SelectLevel(...).
+     * \return the selected level, initially the finest level.
+     */
+    unsigned int SelectedLevel() const;
+
+private:
+    /**
+     * The data of one level.
+     */
+    struct Level {
+        unsigned int M;                     // Number of samples of the u-parameter.
+        unsigned int N;                     // Number of samples of the v-parameter.
+        std::vector<glm::vec3>    vertices; // The vertices of the level
+        std::vector<glm::vec3>    normals;  // The normals of the level
+        std::vector<unsigned int> indices;  // The indices of the triangles, empty for a triangle soup
+    };
+
+    /**
+     * Checks that a level exists.
+     * \param level - the level.
+     * \return the data of the level.
+     */
+    Level const& CheckLevel(unsigned int level) const;
+
+    /**
+     * Computes the bounding box of the finest level.
+     */
+    void ComputeBoundingBox();
+
+    std::vector<Level> levels;  // The levels, the finest first
+
+    glm::vec3 boxmin;           // The lower corner of the bounding box of the finest level
+    glm::vec3 boxmax;           // The upper corner of the bounding box of the finest level
+
+    float finestsize;           // The projected size above which the finest level is selected
+    float hysteresis;           // The relative distance from the level boundaries before the level changes
+    unsigned int selectedlevel; // The level selected by the last call of SelectLevel
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef __PARALLELFOR_H__
+#define __PARALLELFOR_H__
+
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <vector>
+
+/**
+ * \file parallelfor.h
+ */
+
+/**
+ * The number of threads used by ParallelFor.
+ * \return the number of hardware threads, at least 1.
+ */
+unsigned int NumberOfThreads();
+
+/**
+ * Splits the index range [begin, end) into contiguous blocks, and calls block(first, last) once for each block.
+ * The blocks are processed concurrently, one block per thread, and the call returns when all blocks are done.
+ * The blocks are disjoint, so if each block only writes to its own part of the output no locking is needed,
+ * and the result is identical to processing the range sequentially.
+ * If one of the blocks throws an exception it is rethrown by ParallelFor after all blocks are done.
+ * The blocks may call traced functions, because the indentation of the trace is kept per thread.
+ * A ParallelFor which is called from a block of another ParallelFor processes its range sequentially,
+ * so nested loops do not start more threads than there are hardware threads.
+ * The indices are std::size_t, so the size of a container is passed without narrowing.
+ * \param begin - the first index of the range.
+ * \param end - one past the last index of the range.
+ * \param block - the function which processes the indices first <= index < last of one block.
+ * \param minblocksize - the minimum number of indices in a block, 
+ *                       small ranges are processed by fewer threads, or sequentially.
+ */
+void ParallelFor(std::size_t begin, std::size_t end,
+                 std::function<void(std::size_t, std::size_t)> const& block,
+                 std::size_t minblocksize = 1);
+
+#endif
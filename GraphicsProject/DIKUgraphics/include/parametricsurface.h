@@ -1,12 +1,34 @@
 #ifndef RM_DIKUGRAFIK_PARAMETRICSURFACE_H
 #define RM_DIKUGRAFIK_PARAMETRICSURFACE_H
 
+#include <algorithm>
+#include <functional>
 #include <iostream>
 #include <iomanip>
 #include <stdexcept>
 #include <vector>
 
 #include "glmutils.h"
+#include "quantization.h"
+
+
+/**
+ * \struct SurfaceTile
+ * A rectangular part of the parameter grid of a ParametricSurface, which covers the grid cells
+ * ifirst <= i < ifirst + mcells and jfirst <= j < jfirst + ncells.
+ * The tile contains its own (mcells + 1) x (ncells + 1) grid points, the grid point (u_(ifirst + i), v_(jfirst + j))
+ * is stored in entry i * (ncells + 1) + j, and the indices refer to these local grid points.
+ * The grid points on the borders are shared with the neighbouring tiles, so they are evaluated in both tiles.
+ */
+struct SurfaceTile {
+    unsigned int ifirst;                // the u-index of the first grid cell of the tile
+    unsigned int jfirst;                // the v-index of the first grid cell of the tile
+    unsigned int mcells;                // the number of grid cells in the u-direction
+    unsigned int ncells;                // the number of grid cells in the v-direction
+    std::vector<glm::vec3>    vertices; // the vertices at the grid points of the tile
+    std::vector<glm::vec3>    normals;  // the normals at the grid points of the tile
+    std::vector<unsigned int> indices;  // the indices of the triangles into the grid points of the tile
+};
 
 
 /**
@@ -141,6 +163,7 @@ public:
 
     /**
      * Defines if the surface is front facing or not.
+     * The sampled grid is kept, only the normals are negated and the triangles are reversed.
      * \param frontfacing - true if the surface is front facing, else false.
      */
     void FrontFacing(bool frontfacing);
@@ -154,11 +177,63 @@ public:
     /**
      * Cantrols which quadrilaterals should be shown.
      * It makes it easier to whatch the surface.
+     * The sampled grid is kept, only the triangles are regenerated.
      * \param debug - if false all quadrilaterals are shown, 
      *                else only every other quadrilateral are shown.
      */
     void Debug(bool debug);
 
+    /**
+     * The chordal error tolerance of the adaptive tessellation.
+     * \return the tolerance, or 0 if the surface is sampled on the uniform M x N grid.
+     */
+    float Tolerance() const;
+
+    /**
+     * Switches between the uniform and the curvature adaptive tessellation.
+     * In adaptive mode each cell of the M x N grid is the root of a quadtree, and a cell is split into four
+     * until the chordal error, i.e. the distance between the surface and the bilinear cell at the midpoints of
+     * the cell and its edges, is at most tolerance. The quadtree is restricted, i.e. neighbouring cells differ by
+     * at most one level, and a cell next to finer cells is triangulated as a fan which includes the midpoints of
+     * the shared edges, so the mesh has no cracks.
+     * In adaptive mode GridVertices() contains the vertices of the quadtree cells, and the debug mode shows every
+     * other leaf of each level. The quadtree only wraps across the boundaries of the domain which are declared
+     * by Periodic(), otherwise a closed surface may get cracks along its seam.
+     * \param tolerance - the maximal chordal error, or 0 to select the uniform grid.
+     * \param maxlevel - the maximal number of times a cell of the M x N grid is split, 0 <= maxlevel <= 12.
+     *                   The quadtree addresses the cells on a grid which is 2^maxlevel times finer.
+     */
+    void Adaptive(float tolerance, unsigned int maxlevel = 4);
+
+    /**
+     * Reports if the surface is declared periodic in the u-parameter.
+     * \return true if the edges u = umin and u = umax coincide point by point, else false.
+     */
+    bool PeriodicU() const;
+
+    /**
+     * Reports if the surface is declared periodic in the v-parameter.
+     * \return true if the edges v = vmin and v = vmax coincide point by point, else false.
+     */
+    bool PeriodicV() const;
+
+    /**
+     * Declares which parameters are periodic, i.e. the surface is closed, and the points (umin, v) and (umax, v),
+     * or (u, vmin) and (u, vmax), coincide. The adaptive tessellation then restricts and triangulates the quadtree
+     * across the seam, and the two edges share their vertices. The uniform grid is not affected.
+     * \param periodicu - true if the surface is periodic in u, else false.
+     * \param periodicv - true if the surface is periodic in v, else false.
+     */
+    void Periodic(bool periodicu, bool periodicv);
+
+    /**
+     * Writes statistics of the tessellation to a stream, i.e. the number of triangles and vertices,
+     * and in adaptive mode the number of triangles of the uniform grids with the coarsest and the finest
+     * resolution used by the quadtree.
+     * \param s - the stream which the statistics should be written to.
+     */
+    void Statistics(std::ostream& s);
+
     /**
      * The coordinates of the vertices.
      * \return a vector containing the coordinates of the points.
@@ -170,6 +245,110 @@ public:
      * \return a vector containing the coordinates of the normals.
      */
     std::vector<glm::vec3> const& Normals();
+
+    /**
+     * The coordinates of the vertices on the (M + 1) x (N + 1) parameter grid.
+     * Each grid point is stored once, and the triangles are defined by Indices().
+     * The grid point (u_i, v_j) is stored in entry i * (N + 1) + j.
+     * In adaptive mode the vertices are the corners and fan centers of the quadtree cells in no particular order.
+     * \return a vector containing the coordinates of the grid points.
+     */
+    std::vector<glm::vec3> const& GridVertices();
+
+    /**
+     * The coordinates of the normals on the (M + 1) x (N + 1) parameter grid.
+     * The normals are negated if the surface is not front facing.
+     * \return a vector containing the coordinates of the normals at the grid points.
+     */
+    std::vector<glm::vec3> const& GridNormals();
+
+    /**
+     * The indices into GridVertices() and GridNormals() of the triangle vertices.
+     * The first 3 entries define the first triangle, the next 3 entries define the second triangle etc.
+     * The triangles have the same order and orientation as those returned by Vertices().
+     * \return a vector containing the indices of the triangle vertices.
+     */
+    std::vector<unsigned int> const& Indices();
+
+    /**
+     * The number of triangle vertices, i.e. the number of entries in Vertices() and Normals().
+     * \return the number of triangle vertices.
+     */
+    unsigned int NumberOfVertices();
+
+    /**
+     * Writes the triangle vertices and normals interleaved into a destination supplied by the caller,
+     * e.g. a mapped vertex buffer, i.e. vertex 1, normal 1, vertex 2, normal 2, etc.
+     * The triangle vertices are gathered directly from the grid, so Vertices() and Normals() are not generated.
+     * \param destination - room for 2 * NumberOfVertices() 3D vectors.
+     */
+    void WriteInterleaved(glm::vec3* destination);
+
+    /**
+     * Writes the triangle vertices and normals into destinations supplied by the caller,
+     * e.g. ranges of a buffer shared by several surfaces. The result is identical to Vertices() and Normals(),
+     * but the triangle vertices are gathered directly from the grid, so Vertices() and Normals() are not generated.
+     * \param vertices - room for NumberOfVertices() 3D vectors.
+     * \param normals - room for NumberOfVertices() 3D vectors.
+     */
+    void WriteVertices(glm::vec3* vertices, glm::vec3* normals);
+
+    /**
+     * Writes the grid vertices and grid normals interleaved into a destination supplied by the caller,
+     * i.e. grid vertex 1, grid normal 1, grid vertex 2, grid normal 2, etc. The triangles are defined by Indices().
+     * \param destination - room for 2 * GridVertices().size() 3D vectors.
+     */
+    void WriteInterleavedGrid(glm::vec3* destination);
+
+    /**
+     * Computes the axis aligned bounding box of the surface, which is needed to decode quantized vertices.
+     * \param boxmin - on return the lower corner of the bounding box.
+     * \param boxmax - on return the upper corner of the bounding box.
+     */
+    void BoundingBox(glm::vec3& boxmin, glm::vec3& boxmax);
+
+    /**
+     * Writes the triangle vertices and normals as quantized vertices into a destination supplied by the caller.
+     * The positions are quantized relative to the bounding box returned by BoundingBox(...).
+     * \param destination - room for NumberOfVertices() quantized vertices.
+     */
+    void WriteQuantized(QuantizedVertex* destination);
+
+    /**
+     * Writes the grid vertices and grid normals as quantized vertices into a destination supplied by the caller.
+     * The positions are quantized relative to the bounding box returned by BoundingBox(...),
+     * and the triangles are defined by Indices().
+     * \param destination - room for GridVertices().size() quantized vertices.
+     */
+    void WriteQuantizedGrid(QuantizedVertex* destination);
+
+    /**
+     * The number of tiles which the uniform M x N parameter grid is split into by Tile(...).
+     * \param tilesize - the maximal number of grid cells in each direction of a tile.
+     * \return the number of tiles.
+     */
+    unsigned int NumberOfTiles(unsigned int tilesize) const;
+
+    /**
+     * Evaluates one tile of the uniform M x N parameter grid, without storing the whole surface.
+     * The tiles are numbered such that tile t covers the grid cells from (t / ntiles_v) * tilesize in the u-direction,
+     * and from (t % ntiles_v) * tilesize in the v-direction, where ntiles_v is the number of tiles in the v-direction.
+     * The vertices, normals, and triangles are identical to those given by GridVertices(), GridNormals(),
+     * and Indices() for the same grid cells, except that the adaptive mode is ignored.
+     * \param tile - the number of the tile, 0 <= tile < NumberOfTiles(tilesize).
+     * \param tilesize - the maximal number of grid cells in each direction of a tile.
+     * \param destination - the tile, its vectors are reused, so a tile may be passed to Tile(...) again and again.
+     */
+    void Tile(unsigned int tile, unsigned int tilesize, SurfaceTile& destination) const;
+
+    /**
+     * Streams the surface tile by tile, i.e. evaluates each tile of the uniform M x N parameter grid in turn,
+     * and passes it to a consumer, e.g. a rasterizer, a file writer, or an upload to the graphics card.
+     * Only one tile is stored at a time, so the memory used is bounded by the tile size, not by M and N.
+     * \param tilesize - the maximal number of grid cells in each direction of a tile.
+     * \param consumer - the function which is called with each tile in the order of the tile numbers.
+     */
+    void ForEachTile(unsigned int tilesize, std::function<void(SurfaceTile const&)> const& consumer) const;
       
 protected:
     /**
@@ -188,6 +367,35 @@ protected:
      */
     virtual glm::vec3 Normal(float const u, float const v) const = 0;
 
+    /**
+     * Computes the coordinates of the points and the normals of the surface at a batch of parameters.
+     * The default implementation calls Vertex(u, v) and Normal(u, v) for each pair of parameters.
+     * Subclasses may override it to evaluate many samples per call, e.g. using vectorized trigonometric functions.
+     * \param u - the values of the first parameter of the surface.
+     * \param v - the values of the second parameter of the surface.
+     * \param count - the number of pairs of parameters.
+     * \param vertices - the destination of the count points on the surface.
+     * \param normals - the destination of the count normals of the surface.
+     */
+    virtual void EvaluateBatch(float const* u, float const* v, unsigned int count,
+                               glm::vec3* vertices, glm::vec3* normals) const;
+
+    /**
+     * Computes the coordinates of the points and the normals of the surface at each pair of parameters (u_i, v_j),
+     * i.e. on the grid spanned by the u- and v-values. The result for (u_i, v_j) is stored in entry i * nv + j.
+     * The default implementation calls EvaluateBatch once for each u-value.
+     * Subclasses may override it to compute factors which only depend on u, or only on v, e.g. sines and cosines,
+     * once per u-value and once per v-value instead of once per grid point.
+     * \param u - the values of the first parameter of the surface.
+     * \param nu - the number of u-values.
+     * \param v - the values of the second parameter of the surface.
+     * \param nv - the number of v-values.
+     * \param vertices - the destination of the nu * nv points on the surface.
+     * \param normals - the destination of the nu * nv normals of the surface.
+     */
+    virtual void EvaluateGridBatch(float const* u, unsigned int nu, float const* v, unsigned int nv,
+                                   glm::vec3* vertices, glm::vec3* normals) const;
+
      /**
      * Checks if the geometric data has changed since the last upload the the graphics card.
      * \return true if the geometric data has changed, else false.
@@ -203,50 +411,67 @@ protected:
 private:
     /**
      * Generates the actual vertices, normals, and texture coordinates of the surface.
+     * The triangle vertices are gathered concurrently from the sampled grid into presized vectors.
      */
     void SampleSurface();
 
     /**
-     * Generates two front facing triangles from a quadrilateral using counter clockwize order, 
+     * Brings the grid vertices, grid normals, and indices up to date.
+     * The surface is only evaluated if the parameter grid has changed. A change of front facing only
+     * negates the grid normals and regenerates the indices, and a change of debug mode only regenerates the indices.
+     */
+    void UpdateGrid();
+
+    /**
+     * Evaluates the vertices and normals once at each point of the parameter grid.
+     */
+    void SampleGrid();
+
+    /**
+     * Refines the cells of the parameter grid by a restricted quadtree according to the tolerance,
+     * evaluates the vertices and normals once at each vertex of the quadtree cells,
+     * and generates the indices of the front facing triangles.
+     */
+    void SampleAdaptive();
+
+    /**
+     * Generates the indices of the triangles according to the front facing and debug modes.
+     */
+    void CreateIndices();
+
+    /**
+     * The index of a grid point in GridVertices() and GridNormals().
+     * \param i - the index of the u-parameter, 0 <= i <= M.
+     * \param j - the index of the v-parameter, 0 <= j <= N.
+     * \return the index of the grid point (u_i, v_j).
+     */
+    unsigned int GridIndex(unsigned int i, unsigned int j) const;
+
+    /**
+     * Generates the indices of two front facing triangles from a quadrilateral using counter clockwize order,
      * and specifying the diagonal as the first edge.
-     * \param V_lower_left - the lower left vertex.
-     * \param V_lower_right - the lower right vertex.
-     * \param V_upper_right - the upper right vertex.
-     * \param V_upper_left - the upper left vertex.
-     * \param vertices - a vector containing the vertices.
-     * \param N_lower_left - the lower left normal.
-     * \param N_lower_right - the lower right normal.
-     * \param N_upper_right - the upper right normal.
-     * \param N_upper_left - the upper left normal.
-     * \param normals - a vector containing the normals.
-     */
-    void CreateFrontFacingData(glm::vec3 const& V_lower_left,  glm::vec3 const& V_lower_right,
-                               glm::vec3 const& V_upper_right, glm::vec3 const& V_upper_left,
-                               std::vector<glm::vec3>& vertices,
-                               glm::vec3 const& N_lower_left,  glm::vec3 const& N_lower_right,
-                               glm::vec3 const& N_upper_right, glm::vec3 const& N_upper_left,
-                               std::vector<glm::vec3>& normals) const;
-
-    /**
-     * Generates two back facing triangles from a quadrilateral using clockwize order, 
+     * \param lower_left - the index of the lower left grid point.
+     * \param lower_right - the index of the lower right grid point.
+     * \param upper_right - the index of the upper right grid point.
+     * \param upper_left - the index of the upper left grid point.
+     * \param indices - a vector containing the indices.
+     */
+    void CreateFrontFacingIndices(unsigned int lower_left,  unsigned int lower_right,
+                                  unsigned int upper_right, unsigned int upper_left,
+                                  std::vector<unsigned int>& indices) const;
+
+    /**
+     * Generates the indices of two back facing triangles from a quadrilateral using clockwize order,
      * and specifying the diagonal as the first edge.
-     * \param V_lower_left - the lower left vertex.
-     * \param V_lower_right - the lower right vertex.
-     * \param V_upper_right - the upper right vertex.
-     * \param V_upper_left - the upper left vertex.
-     * \param vertices - a vector containing the vertices.
-     * \param N_lower_left - the lower left normal.
-     * \param N_lower_right - the lower right normal.
-     * \param N_upper_right - the upper right normal.
-     * \param N_upper_left - the upper left normal.
-     * \param normals - a vector containing the normals.
-     */
-    void CreateBackFacingData(glm::vec3 const& V_lower_left,  glm::vec3 const& V_lower_right,
-                              glm::vec3 const& V_upper_right, glm::vec3 const& V_upper_left,
-                              std::vector<glm::vec3>& vertices,
-                              glm::vec3 const& N_lower_left,  glm::vec3 const& N_lower_right,
-                              glm::vec3 const& N_upper_right, glm::vec3 const& N_upper_left,
-                              std::vector<glm::vec3>& normals) const;
+     * \param lower_left - the index of the lower left grid point.
+     * \param lower_right - the index of the lower right grid point.
+     * \param upper_right - the index of the upper right grid point.
+     * \param upper_left - the index of the upper left grid point.
+     * \param indices - a vector containing the indices.
+     */
+    void CreateBackFacingIndices(unsigned int lower_left,  unsigned int lower_right,
+                                 unsigned int upper_right, unsigned int upper_left,
+                                 std::vector<unsigned int>& indices) const;
 
     unsigned int M;   // Number of samples of the u-parameter.
     unsigned int N;   // Number of samples of the v-parameter.
@@ -265,6 +490,23 @@ private:
     
     std::vector<glm::vec3> vertices;   // The computed vertices
     std::vector<glm::vec3> normals;    // The computed normals
+
+    bool validgrid;    // true if the grid vertices and grid normals are up to date
+    bool validindices; // true if the indices are up to date
+    float gridsign;    // the sign which has been applied to the grid normals, 1 for front facing else -1
+
+    std::vector<glm::vec3>    gridvertices;    // The vertices at the grid points
+    std::vector<glm::vec3>    gridnormals;     // The normals at the grid points
+    std::vector<unsigned int> indices;         // The indices of the triangles into the grid
+
+    float tolerance;        // the maximal chordal error of the adaptive tessellation, 0 for the uniform grid
+    unsigned int maxlevel;  // the maximal number of splits of a grid cell in adaptive mode
+    unsigned int maxdepth;  // the finest level of the quadtree cells after the last adaptive tessellation
+    bool periodicu;         // true if the edges u = umin and u = umax coincide
+    bool periodicv;         // true if the edges v = vmin and v = vmax coincide
+
+    std::vector<unsigned int> adaptiveindices;       // The front facing triangles of the adaptive tessellation
+    std::vector<unsigned int> adaptivedebugindices;  // The front facing triangles of every other leaf
 };
 
 #endif
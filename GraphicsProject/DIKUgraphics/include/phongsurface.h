@@ -8,6 +8,7 @@
 #include <vector>
 
 #include "glmutils.h"
+#include "quantization.h"
 
 
 /**
@@ -64,6 +65,8 @@ public:
 
     /**
      * Changes the number of subdivisions of the height angle, i.e. the phi-interval.
+     * If the samples are importance driven, the sampling returns to uniform with the theta-samples from before
+     * the importance sampling, so a later ImportanceSampling(0) keeps the explicit choice.
      * \param newPhiSamples - the new number of samples of the phi-interval.
      * \return - the old number of samples of the phi-interval.
      */
@@ -77,11 +80,31 @@ public:
 
     /**
      * Changes the number of subdivisions of the azimuth angle, i.e. the theta-interval.
+     * If the samples are importance driven, the sampling returns to uniform with the phi-samples from before
+     * the importance sampling, so a later ImportanceSampling(0) keeps the explicit choice.
      * \param newThetaSamples - the new number of samples of the theta-interval.
      * \return - the old number of samples of the theta-interval.
      */
     int ThetaSamples(int newThetaSamples);
 
+    /**
+     * Tells whether the samples are concentrated around the specular lobe, see ImportanceSampling(int).
+     * \return - true if the samples are importance driven, false if they are uniform.
+     */
+    bool ImportanceSampling() const;
+
+    /**
+     * Changes the sampling to a fixed number of triangles, which are concentrated where the Phong function bends
+     * most, i.e. around the peak of the specular lobe at R_user. The phi- and theta-samples are placed
+     * independently, so the surface is still sampled on a grid, and the density of the samples in each direction
+     * is 1/4 uniform plus 3/4 proportional to the square root of the largest second derivative of the lobe,
+     * which distributes the interpolation error evenly.
+     * The numbers of samples are chosen from the budget with the current ratio of ThetaSamples() to PhiSamples().
+     * \param trianglebudget - the maximal number of triangles, or 0 to return to uniform sampling with the numbers
+     *                         of samples from before the importance sampling.
+     */
+    void ImportanceSampling(int trianglebudget);
+
 
     /**
      * Computes a vertex on the Phong reflection surface given parameters phi and theta.
@@ -101,16 +124,46 @@ public:
 
     /**
      * Computes a number of vertices on the PhongSurface, depending on PhiSamples, and ThetaSamples.
+     * The vertices and the normals are computed together, so a following call of Normals() costs nothing.
      * \return - a std::vector<glm::vec3> containing the computed the vertices.
      */
     std::vector<glm::vec3> const& Vertices();
 
     /**
      * Computes a number of normals to the PhongSurface, depending on PhiSamples, and ThetaSamples.
+     * The vertices and the normals are computed together, so a following call of Vertices() costs nothing.
      * \return - a std::vector<glm::vec3> containing the computed the normals.
      */
     std::vector<glm::vec3> const& Normals();
 
+    /**
+     * The number of triangle vertices, i.e. the number of entries in Vertices() and Normals().
+     * \return - the number of triangle vertices.
+     */
+    unsigned int NumberOfVertices() const;
+
+    /**
+     * Writes the triangle vertices and normals interleaved into a destination supplied by the caller,
+     * e.g. a mapped vertex buffer, i.e. vertex 1, normal 1, vertex 2, normal 2, etc.
+     * The surface is evaluated directly into the destination, so Vertices() and Normals() are not generated.
+     * \param destination - room for 2 * NumberOfVertices() 3D vectors.
+     */
+    void WriteInterleaved(glm::vec3* destination) const;
+
+    /**
+     * Computes the axis aligned bounding box of the surface, which is needed to decode quantized vertices.
+     * \param boxmin - on return the lower corner of the bounding box.
+     * \param boxmax - on return the upper corner of the bounding box.
+     */
+    void BoundingBox(glm::vec3& boxmin, glm::vec3& boxmax);
+
+    /**
+     * Writes the triangle vertices and normals as quantized vertices into a destination supplied by the caller.
+     * The positions are quantized relative to the bounding box returned by BoundingBox(...).
+     * \param destination - room for NumberOfVertices() quantized vertices.
+     */
+    void WriteQuantized(QuantizedVertex* destination);
+
 protected:
 
 private:
@@ -119,6 +172,39 @@ private:
      */
     void Initialize();
 
+    /**
+     * The index of the grid point (phi_i, theta_j) in the grids computed by SampleGrid(...).
+     * \param i - the number of the phi-sample, 0 <= i <= PhiSamples().
+     * \param j - the number of the theta-sample, 0 <= j <= ThetaSamples().
+     * \return - the index of the grid point.
+     */
+    unsigned int GridIndex(unsigned int i, unsigned int j) const;
+
+    /**
+     * Computes the samples of the height angle and the azimuth angle, i.e. phi_i and theta_j.
+     * The samples are uniform, i.e. phi_i = phi_start + i * delta_phi and theta_j = theta_start + j * delta_theta,
+     * or they are placed by the inverse of the cumulative importance, see ImportanceSampling(int).
+     * \param phi - on return the PhiSamples() + 1 values of phi.
+     * \param theta - on return the ThetaSamples() + 1 values of theta.
+     */
+    void SampleAngles(std::vector<float>& phi, std::vector<float>& theta) const;
+
+    /**
+     * Computes the vertices and the normals at the grid points (phi_i, theta_j) in one pass, where
+     * phi_i and theta_j are computed by SampleAngles(...). The rows of the grid are
+     * computed in parallel, the sines and cosines are computed once per row and column, and the Phong function
+     * and its derivatives share one power, so each grid point costs a fraction of Vertex(...) plus Normal(...).
+     * \param gridvertices - on return the (PhiSamples() + 1) * (ThetaSamples() + 1) vertices.
+     * \param gridnormals - on return the normals of the grid vertices.
+     */
+    void SampleGrid(std::vector<glm::vec3>& gridvertices, std::vector<glm::vec3>& gridnormals) const;
+
+    /**
+     * Computes the triangle vertices and normals in one pass from the grid computed by SampleGrid(...),
+     * and marks both as OK.
+     */
+    void Sample();
+
     /**
      * The view vector used to visualize the phong surface.
      * \param phi - the height angle of the view vector.
@@ -144,7 +230,8 @@ private:
     glm::vec3 dVdtheta(float phi, float theta) const;
 
     /**
-     * The reflected intensity defined by the Phong reflection function
+     * The reflected intensity defined by the Phong reflection function, where R.V is clamped at 0, so the specular
+     * lobe has no back lobe for even shininess.
      * \param phi - the height angle of the view vector.
      * \param theta - the azimuth angle of the view vector.
      */
@@ -229,6 +316,13 @@ private:
 
     // The spacing between the samples of the azimuth angle, i.e. the theta-interval
     float delta_theta;
+
+    // True if the samples are concentrated around the specular lobe
+    bool importance_sampling;
+
+    // The numbers of samples of the uniform sampling, which are restored by ImportanceSampling(0)
+    int uniform_N_phi;
+    int uniform_N_theta;
 };
 
 #endif
@@ -0,0 +1,78 @@
+#ifndef __QUANTIZATION_H__
+#define __QUANTIZATION_H__
+
+#include <algorithm>
+#include <cmath>
+
+#include "glmutils.h"
+
+/**
+ * \file quantization.h
+ */
+
+/**
+ * \struct QuantizedVertex
+ * A compact encoding of a vertex and its normal, which uses 12 bytes instead of 24 bytes.
+ * The position is quantized to 16 bits per coordinate relative to a bounding box, and the normal is
+ * encoded by the octahedral mapping with 16 bits per component.
+ * In OpenGL the position can be read as 3 x GL_UNSIGNED_SHORT normalized at offset 0, and the normal
+ * as 2 x GL_SHORT normalized at offset 8, both with stride sizeof(QuantizedVertex).
+ */
+struct QuantizedVertex {
+    unsigned short position[3];  // (position - boxmin) / (boxmax - boxmin) scaled to [0, 65535]
+    unsigned short padding;      // keeps the normal 4-byte aligned
+    short          normal[2];    // the octahedral encoding of the normal scaled to [-32767, 32767]
+};
+
+/**
+ * Computes the axis aligned bounding box of an array of points.
+ * \param points - the points.
+ * \param count - the number of points.
+ * \param boxmin - on return the lower corner of the bounding box.
+ * \param boxmax - on return the upper corner of the bounding box.
+ */
+void BoundingBox(glm::vec3 const* points, unsigned int count, glm::vec3& boxmin, glm::vec3& boxmax);
+
+/**
+ * Maps a unit vector to a point in the square [-1, 1] x [-1, 1] by projecting it onto the octahedron
+ * |x| + |y| + |z| = 1, and folding the lower half of the octahedron over the upper half.
+ * \param normal - a unit vector.
+ * \return the octahedral encoding of the vector.
+ */
+glm::vec2 OctahedralEncode(glm::vec3 const& normal);
+
+/**
+ * Maps a point in the square [-1, 1] x [-1, 1] back to a unit vector, the inverse of OctahedralEncode.
+ * \param encoding - the octahedral encoding of a vector.
+ * \return the unit vector.
+ */
+glm::vec3 OctahedralDecode(glm::vec2 const& encoding);
+
+/**
+ * Encodes arrays of vertices and normals as quantized vertices.
+ * The loop is branch free, so the compiler can vectorize it.
+ * \param vertices - the vertices, they should be inside the bounding box.
+ * \param normals - the normals, they should be unit vectors or zero.
+ * \param count - the number of vertices and normals.
+ * \param boxmin - the lower corner of the bounding box.
+ * \param boxmax - the upper corner of the bounding box.
+ * \param destination - the destination of the count quantized vertices.
+ */
+void EncodeVertices(glm::vec3 const* vertices, glm::vec3 const* normals, unsigned int count,
+                    glm::vec3 const& boxmin, glm::vec3 const& boxmax, QuantizedVertex* destination);
+
+/**
+ * Decodes an array of quantized vertices, the inverse of EncodeVertices.
+ * The loop is branch free, so the compiler can vectorize it.
+ * \param source - the quantized vertices.
+ * \param count - the number of quantized vertices.
+ * \param boxmin - the lower corner of the bounding box used for the encoding.
+ * \param boxmax - the upper corner of the bounding box used for the encoding.
+ * \param vertices - the destination of the count vertices.
+ * \param normals - the destination of the count normals.
+ */
+void DecodeVertices(QuantizedVertex const* source, unsigned int count,
+                    glm::vec3 const& boxmin, glm::vec3 const& boxmax,
+                    glm::vec3* vertices, glm::vec3* normals);
+
+#endif
@@ -0,0 +1,166 @@
+#ifndef __SEAMWELDER_H__
+#define __SEAMWELDER_H__
+
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <vector>
+
+#include "glmutils.h"
+#include "parametricsurface.h"
+
+
+/**
+ * \class SeamWelder
+ * Builds one indexed mesh from several parametric surfaces, where the grid points which the surfaces have in common
+ * along their boundaries are shared, i.e. the seams are welded. The welded mesh is smaller, it has no shading seams
+ * because the normals of a shared vertex are averaged, and the shared vertices are reused by the vertex cache.
+ *
+ * The seams can be declared edge by edge, e.g. for a surface which is composed of known parts like the Klein Bottle.
+ * Grid points on the boundaries which are not covered by a declared seam can be welded by a spatial hash,
+ * i.e. boundary grid points which are closer than a tolerance, and whose normals agree, are shared.
+ * A point is compared with the first point of the set which it would join, so a set of welded points stays within
+ * the tolerance, and neighbouring points on the same edge of a part are never welded.
+ */
+class SeamWelder {
+public:
+    /**
+     * The four boundary edges of the parameter domain of a surface.
+     * The edges UMIN and UMAX run in the direction of v, and the edges VMIN and VMAX run in the direction of u.
+     */
+    enum Edge { UMIN = 0, UMAX = 1, VMIN = 2, VMAX = 3 };
+
+    /**
+     * \struct Seam
+     * Declares that an edge of one part coincides with an edge of another part, or of the same part.
+     * If t is the relative position of a point on edge1, i.e. 0 <= t <= 1 in the direction of the edge,
+     * it coincides with the point at position shift + t on edge2, or shift - t if reversed is true,
+     * where the position is wrapped into [0, 1], i.e. the edges may be closed curves which start at different points.
+     * Grid points of edge1 which do not coincide with a grid point of edge2 are not welded by the seam,
+     * and neither are grid points with opposite normals, because a vertex has only one normal.
+     */
+    struct Seam {
+        unsigned int part1;  // the first part
+        Edge         edge1;  // the edge of the first part
+        unsigned int part2;  // the second part
+        Edge         edge2;  // the edge of the second part
+        bool         reversed;  // true if the edges run in opposite directions
+        float        shift;     // the position on edge2 of the start of edge1
+    };
+
+    /**
+     * Creates an empty seam welder.
+     * \param tolerance - the distance below which boundary grid points which are not covered by a declared seam
+     *                    are welded, 0 disables the spatial hash.
+     */
+    SeamWelder(float tolerance = 0.0f);
+
+    /**
+     * Destroys the current instance of the seam welder.
+     */
+    virtual ~SeamWelder();
+
+    /**
+     * Adds a part. The part is sampled by Build(), so it must exist until then, and it must use the uniform grid.
+     * \param part - the parametric surface.
+     * \return the number of the part, which is used to declare seams.
+     */
+    unsigned int AddPart(ParametricSurface& part);
+
+    /**
+     * Declares a seam between two edges.
+     * \param seam - the declaration of the seam.
+     */
+    void AddSeam(Seam const& seam);
+
+    /**
+     * Declares a seam between two edges.
+     * \param part1 - the first part.
+     * \param edge1 - the edge of the first part.
+     * \param part2 - the second part.
+     * \param edge2 - the edge of the second part.
+     * \param reversed - true if the edges run in opposite directions.
+     * \param shift - the position on edge2 of the start of edge1.
+     */
+    void AddSeam(unsigned int part1, Edge edge1, unsigned int part2, Edge edge2,
+                 bool reversed = false, float shift = 0.0f);
+
+    /**
+     * The distance below which boundary grid points are welded by the spatial hash.
+     * \return the tolerance, 0 if the spatial hash is disabled.
+     */
+    float Tolerance() const;
+
+    /**
+     * Changes the distance below which boundary grid points are welded by the spatial hash.
+     * \param tolerance - the new tolerance, 0 disables the spatial hash.
+     */
+    void Tolerance(float tolerance);
+
+    /**
+     * Samples the parts, welds the seams, and builds the indexed mesh.
+     * Triangles which become degenerate because two of their vertices are welded are removed.
+     */
+    void Build();
+
+    /**
+     * The vertices of the welded mesh.
+     * \return the vertices, which are indexed by Indices().
+     */
+    std::vector<glm::vec3> const& Vertices() const;
+
+    /**
+     * The normals of the welded mesh, the normals of welded grid points are averaged. All normals are unit vectors.
+     * \return the normals of the vertices.
+     */
+    std::vector<glm::vec3> const& Normals() const;
+
+    /**
+     * The indices of the triangles of the welded mesh.
+     * \return the indices into Vertices() and Normals(), 3 per triangle.
+     */
+    std::vector<unsigned int> const& Indices() const;
+
+    /**
+     * Writes the number of vertices before and after the welding, the number of grid points welded by the declared
+     * seams and by the spatial hash, the number of coinciding grid points with opposite normals,
+     * and the number of removed triangles to a stream.
+     * \param s - the stream which the statistics should be written to.
+     */
+    void Statistics(std::ostream& s) const;
+
+private:
+    /**
+     * The number of grid cells along an edge of a part.
+     * \param part - the part.
+     * \param edge - the edge.
+     * \return the number of grid cells, i.e. the edge has one more grid point.
+     */
+    unsigned int EdgeLength(unsigned int part, Edge edge) const;
+
+    /**
+     * The index of a grid point on an edge of a part among the grid points of all parts.
+     * \param part - the part.
+     * \param edge - the edge.
+     * \param k - the number of the grid point along the edge, 0 <= k <= EdgeLength(part, edge).
+     * \return the index of the grid point.
+     */
+    unsigned int EdgePoint(unsigned int part, Edge edge, unsigned int k) const;
+
+    float tolerance;                          // The distance below which boundary grid points are welded
+    std::vector<ParametricSurface*> parts;    // The parts
+    std::vector<Seam>               seams;    // The declared seams
+
+    std::vector<unsigned int> offsets;        // The index of the first grid point of each part
+    std::vector<glm::vec3>    vertices;       // The welded vertices
+    std::vector<glm::vec3>    normals;        // The averaged normals
+    std::vector<unsigned int> indices;        // The indices of the triangles
+
+    unsigned int ngridpoints;                 // The number of grid points of all parts
+    unsigned int ndeclaredwelds;              // The number of grid points welded by declared seams
+    unsigned int nopposite;                   // The number of declared grid points not welded because of their normals
+    unsigned int nhashedwelds;                // The number of grid points welded by the spatial hash
+    unsigned int ndegenerate;                 // The number of removed degenerate triangles
+};
+
+#endif
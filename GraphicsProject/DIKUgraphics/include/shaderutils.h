@@ -37,6 +37,16 @@ std::string Read(std::string const& FileName);
  */
 GLuint CreateGpuProgram(std::string const& filename, GLenum programtype);
 
+/**
+ * Creates and compiles a gpu program, where some preprocessor definitions are inserted after the #version line,
+ * e.g. the sizes of uniform arrays which must agree with the application.
+ * \param filename - The name of the file containing the gpu program.
+ * \param programtype - The type of the gpu program.
+ * \param definitions - The lines which are inserted, e.g. "#define NVIEWS 5\n".
+ * \return An identifier for the gpu program.
+ */
+GLuint CreateGpuProgram(std::string const& filename, GLenum programtype, std::string const& definitions);
+
 /**
  * Creates and links a shader program.
  * \param vertexprogID - the ID of a compiled vertex program.
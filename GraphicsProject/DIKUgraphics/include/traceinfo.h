@@ -98,7 +98,7 @@ private:
     /**
      * Static private variables
      */
-    static uint              indentlevel;
+    static thread_local uint indentlevel;  // per thread, because traced functions run in the threads of ParallelFor
     static const std::string enter;
     static const std::string leave;
     static const std::string indentspace;
@@ -0,0 +1,21 @@
+#ifndef __VECTORMATH_H__
+#define __VECTORMATH_H__
+
+#include <cmath>
+
+/**
+ * \file vectormath.h
+ */
+
+/**
+ * Computes the sine and the cosine of an array of angles.
+ * The loop body is branch free, so the compiler can vectorize it, i.e. compute several angles per instruction.
+ * The result is accurate to a few units in the last place for angles with |x| < 8192.
+ * \param x - the angles in radians.
+ * \param count - the number of angles.
+ * \param sine - the destination of the count sines.
+ * \param cosine - the destination of the count cosines.
+ */
+void SinCos(float const* x, unsigned int count, float* sine, float* cosine);
+
+#endif
@@ -61,6 +61,21 @@ BezierRow& BezierRow::operator=(BezierRow const& bezierrow)
     return *this;
 }
 
+/*
+ * Assignent operator assigns the value of a product to the current instance of BezierPatch.
+ * The product may contain the current instance, e.g. G = M * G * glm::transpose(M).
+ * \param product - The product to be evaluated and assigned to this instance.
+ */
+BezierPatch& BezierPatch::operator=(BezierPatchProduct&& product)
+{
+    glm::vec3 entries[4][4];
+    product.Evaluate(entries);
+    for (int i = 0; i < 4; ++i) {
+        this->controlvec[i] = BezierRow(entries[i][0], entries[i][1], entries[i][2], entries[i][3]);
+    }
+    return *this;
+}
+
 /*
  * Index operator - read only - returns the i'th entry in the geometry row vector,
  * \param i - The index of the entry to be returned.
@@ -228,6 +243,16 @@ BezierPatch::BezierPatch(BezierPatch const& bezierpatch)
     }
 }
 
+/*
+ * Conversion constructor creates a new BezierPatch which is the value of a product of a BezierPatch and
+ * ordinary matrices, e.g. BezierPatch G_L = glm::transpose(DBL) * G * DBL.
+ * \param product - The product to be evaluated.
+ */
+BezierPatch::BezierPatch(BezierPatchProduct&& product)
+{
+    *this = std::move(product);
+}
+
 /*
  * Destructor destroys the current instance of BezierPatch.
  */
@@ -281,6 +306,124 @@ BezierRow& BezierPatch::operator[](int i)
 }
 
 
+/*
+ * \class BezierPatchProduct
+ * implements a lazy product left * G * right of a BezierPatch G and two ordinary matrices.
+ */
+
+/*
+ * Parameterized constructor creates the product left * bezierpatch * right.
+ * \param left - The ordinary matrix which left-multiplies the BezierPatch.
+ * \param bezierpatch - The BezierPatch.
+ * \param right - The ordinary matrix which right-multiplies the BezierPatch.
+ */
+BezierPatchProduct::BezierPatchProduct(glm::mat4x4 const& left, BezierPatch const& bezierpatch,
+                                       glm::mat4x4 const& right)
+                  : left(left), bezierpatch(bezierpatch), right(right)
+{}
+
+/*
+ * Move constructor, which the operators need to return a product.
+ * \param product - The product to be moved.
+ */
+BezierPatchProduct::BezierPatchProduct(BezierPatchProduct&& product)
+                  : left(product.left), bezierpatch(product.bezierpatch), right(product.right)
+{}
+
+/*
+ * Destructor destroys the current instance of BezierPatchProduct.
+ */
+BezierPatchProduct::~BezierPatchProduct()
+{}
+
+/*
+ * Index operator - read only - evaluates the i'th row of the product.
+ * \param i - The index of the row to be returned. Notice, the starts at 1 and ends at 4.
+ * \return the i'th row of the product.
+ */
+BezierRow BezierPatchProduct::operator[](int i) &&
+{
+    if ((i < 1) || (i > 4)) {
+        std::stringstream errormessage;
+        errormessage << "BezierPatchProduct::operator[](int): The index is = " << i << " must be in the range {1,...,4}";
+        throw std::out_of_range(errormessage.str().c_str());
+    }
+
+    // The i'th row of left * G, with the terms in the same order as Evaluate(...), times right
+    glm::vec3 row[4];
+    for (int l = 1; l <= 4; ++l) {
+        glm::vec3 element(0.0f);
+        for (int k = 1; k <= 4; ++k) {
+            element += this->left[k - 1][i - 1] * this->bezierpatch[k][l];
+        }
+        row[l - 1] = element;
+    }
+
+    BezierRow result;
+    for (int j = 1; j <= 4; ++j) {
+        glm::vec3 element(0.0f);
+        for (int l = 1; l <= 4; ++l) {
+            element += this->right[j - 1][l - 1] * row[l - 1];
+        }
+        result[j] = element;
+    }
+    return result;
+}
+
+/*
+ * Evaluates the product.
+ * \param entries - On return entries[i - 1][j - 1] is the entry i,j of the product, 1 <= i, j <= 4.
+ */
+void BezierPatchProduct::Evaluate(glm::vec3 entries[4][4]) const
+{
+    // Copy the control points once into one 4 x 4 matrix per coordinate, so the loops below neither check
+    // the indices nor go through glm::vec3, and the compiler can keep the matrices in registers
+    float G[3][4][4];
+    for (int k = 0; k < 4; ++k) {
+        BezierRow const& row = this->bezierpatch[k + 1];
+        for (int l = 0; l < 4; ++l) {
+            glm::vec3 const& controlpoint = row[l + 1];
+            for (int c = 0; c < 3; ++c) {
+                G[c][k][l] = controlpoint[c];
+            }
+        }
+    }
+
+    // The entries are computed in the same order as (left * G) * right, so a product with one factor on each side
+    // rounds like the eager evaluation. In a longer chain like G * A * B the ordinary matrices are multiplied first,
+    // i.e. right = A * B, so the rounding may differ from (G * A) * B.  Notice, glm matrices are indexed [column][row].
+    float L[4][4];
+    float R[4][4];
+    for (int i = 0; i < 4; ++i) {
+        for (int k = 0; k < 4; ++k) {
+            L[i][k] = this->left[k][i];
+            R[i][k] = this->right[k][i];
+        }
+    }
+    for (int c = 0; c < 3; ++c) {
+        float LG[4][4];
+        for (int i = 0; i < 4; ++i) {
+            for (int l = 0; l < 4; ++l) {
+                float entry = 0.0f;
+                for (int k = 0; k < 4; ++k) {
+                    entry += L[i][k] * G[c][k][l];
+                }
+                LG[i][l] = entry;
+            }
+        }
+        for (int i = 0; i < 4; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                float entry = 0.0f;
+                for (int l = 0; l < 4; ++l) {
+                    entry += LG[i][l] * R[l][j];
+                }
+                entries[i][j][c] = entry;
+            }
+        }
+    }
+}
+
+
 /*
  * \file bezierpatch.h
  * \brief Utility Functions opeartors
@@ -563,19 +706,11 @@ BezierRow Transpose(BezierColumn const& beziercolumn)
  * This can be used to right-multiply a Bezier geometry matrix by an ordinary matrix (a basis matrix).
  * \param bezierpatch - The BezierPatch that should be multiplied.
  * \param matrix - The ordinary matrix to be right-multiplied (basis matrix) by the bezier patch.
- * \return The product bezierpatch * matrix which is of type BezierPatch.
+ * \return The product bezierpatch * matrix which is of type BezierPatchProduct, and it converts to a BezierPatch.
  */
-BezierPatch operator*(BezierPatch const& bezierpatch, glm::mat4x4 const& matrix)
+BezierPatchProduct operator*(BezierPatch const& bezierpatch, glm::mat4x4 const& matrix)
 {
-    BezierPatch result;
-
-    for (int i = 1; i <= 4; ++i) {
-        for (int j = 1; j <= 4; ++j) {
-            glm::vec4 column(glm::column(matrix, j - 1));
-            result[i][j] = bezierpatch[i] * column;
-        }
-    }
-    return result;
+    return BezierPatchProduct(glm::mat4x4(1.0f), bezierpatch, matrix);
 }
 
 /*
@@ -583,24 +718,33 @@ BezierPatch operator*(BezierPatch const& bezierpatch, glm::mat4x4 const& matrix)
  * This can be used to left-multiply a BezierPatch by a basis matrix. 
  * \param bezierpatch - The BezierPatch that should be multimplied.
  * \param matrix - The matrix (a basis matrix) that is left-multiplied by the bezier patch.
- * \return The product matrix * bezierpatch which is of type BezierPatch.
+ * \return The product matrix * bezierpatch which is of type BezierPatchProduct, and it converts to a BezierPatch.
  */
-BezierPatch operator*(glm::mat4x4 const& matrix, BezierPatch const& bezierpatch)
+BezierPatchProduct operator*(glm::mat4x4 const& matrix, BezierPatch const& bezierpatch)
 {
-    BezierPatch result;
+    return BezierPatchProduct(matrix, bezierpatch, glm::mat4x4(1.0f));
+}
 
-    for (int i = 1; i <= 4; ++i) {
-        for (int j = 1; j <= 4; ++j) {
-            glm::vec4 row(glm::row(matrix, i - 1));
+/*
+ * Multiplication operator, right-multiplies a product of a BezierPatch by an ordinary matrix (a basis matrix).
+ * \param product - The product that should be multiplied.
+ * \param matrix - The ordinary matrix which right-multiplies the product.
+ * \return The product product * matrix which is of type BezierPatchProduct, and it converts to a BezierPatch.
+ */
+BezierPatchProduct operator*(BezierPatchProduct&& product, glm::mat4x4 const& matrix)
+{
+    return BezierPatchProduct(product.left, product.bezierpatch, product.right * matrix);
+}
 
-            glm::vec3 tmpres(0.0f);
-            for (int k = 1; k <= 4; ++k) {
-                tmpres += row[k - 1] * bezierpatch[k][j];
-            }
-            result[i][j] = tmpres;
-        }
-    }
-    return result;   
+/*
+ * Multiplication operator, left-multiplies a product of a BezierPatch by an ordinary matrix (a basis matrix).
+ * \param matrix - The ordinary matrix which left-multiplies the product.
+ * \param product - The product that should be multiplied.
+ * \return The product matrix * product which is of type BezierPatchProduct, and it converts to a BezierPatch.
+ */
+BezierPatchProduct operator*(glm::mat4x4 const& matrix, BezierPatchProduct&& product)
+{
+    return BezierPatchProduct(matrix * product.left, product.bezierpatch, product.right);
 }
 
 /*
@@ -641,6 +785,62 @@ BezierRow operator*(glm::vec4 const& vector, BezierPatch const& bezierpatch)
     return result;
 }
 
+/*
+ * Multiplication operator, right-multiplies a product of a BezierPatch by an ordinary vector (a parameter vector).
+ * The product is not evaluated, the vector is multiplied through the factors from the right.
+ * \param product - The product that should be multiplied.
+ * \param vector - The vector (a parameter vector) that is right-multiplied by the product.
+ * \return The product product * vector which is of type BezierColumn.
+ */
+BezierColumn operator*(BezierPatchProduct&& product, glm::vec4 const& vector)
+{
+    glm::vec4 weights(product.right * vector);
+    glm::vec3 column[4];
+    for (int k = 1; k <= 4; ++k) {
+        column[k - 1] = product.bezierpatch[k] * weights;
+    }
+
+    BezierColumn result;
+    for (int i = 1; i <= 4; ++i) {
+        glm::vec3 element(0.0f);
+        for (int k = 1; k <= 4; ++k) {
+            element += product.left[k - 1][i - 1] * column[k - 1];
+        }
+        result[i] = element;
+    }
+    return result;
+}
+
+/*
+ * Multiplication operator, left-multiplies a product of a BezierPatch by an ordinary vector (a parameter vector).
+ * The product is not evaluated, the vector is multiplied through the factors from the left.
+ * \param vector - The vector (a parameter vector) that is left-multiplied by the product.
+ * \param product - The product that should be multiplied.
+ * \return The product vector * product which is of type BezierRow.
+ */
+BezierRow operator*(glm::vec4 const& vector, BezierPatchProduct&& product)
+{
+    glm::vec4 weights(vector * product.left);
+    glm::vec3 row[4];
+    for (int l = 1; l <= 4; ++l) {
+        glm::vec3 element(0.0f);
+        for (int k = 1; k <= 4; ++k) {
+            element += weights[k - 1] * product.bezierpatch[k][l];
+        }
+        row[l - 1] = element;
+    }
+
+    BezierRow result;
+    for (int j = 1; j <= 4; ++j) {
+        glm::vec3 element(0.0f);
+        for (int l = 1; l <= 4; ++l) {
+            element += row[l - 1] * product.right[j - 1][l - 1];
+        }
+        result[j] = element;
+    }
+    return result;
+}
+
 /*
  * Multiplication operator, right-multiplies a BezierRow by an ordinary vector (a parameter vector).
  * This can be used to right-multiply a BezierRow by a parameter vector. 
@@ -764,3 +964,14 @@ std::ostream& operator<<(std::ostream& s, BezierPatch const& bezierpatch)
     }
     return s;
 }
+
+/*
+ * Insertion operator, inserts the value of a product of a BezierPatch into an ostream.
+ * \param s - The ostream which the product should be inserted into.
+ * \param product - The product that should be inserted into the ostream.
+ * \return The ostream which the product has been inserted into.
+ */
+std::ostream& operator<<(std::ostream& s, BezierPatchProduct&& product)
+{
+    return s << BezierPatch(std::move(product));
+}
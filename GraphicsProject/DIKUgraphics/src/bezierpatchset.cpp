@@ -0,0 +1,379 @@
+#include <algorithm>
+
+#include "bezierpatchset.h"
+#include "parallelfor.h"
+
+namespace {
+
+// The smallest number of patches which a thread processes in the kernels
+unsigned int const MinBlockSize = 256;
+
+/*
+ * Subdivides a cubic Bezier curve at t = 1/2 by the de Casteljau algorithm.
+ * \param a0 - the first control point.
+ * \param a1 - the second control point.
+ * \param a2 - the third control point.
+ * \param a3 - the fourth control point.
+ * \param left - on return the control points of the half 0 <= t <= 1/2.
+ * \param right - on return the control points of the half 1/2 <= t <= 1.
+ */
+inline void Split(float a0, float a1, float a2, float a3, float left[4], float right[4])
+{
+    float b0 = 0.5f * (a0 + a1);
+    float b1 = 0.5f * (a1 + a2);
+    float b2 = 0.5f * (a2 + a3);
+    float c0 = 0.5f * (b0 + b1);
+    float c1 = 0.5f * (b1 + b2);
+    float d0 = 0.5f * (c0 + c1);
+    left[0]  = a0; left[1]  = b0; left[2]  = c0; left[3]  = d0;
+    right[0] = d0; right[1] = c1; right[2] = b2; right[3] = a3;
+}
+
+/*
+ * The cubic Bernstein polynomials and their derivatives.
+ * \param t - the parameter.
+ * \param B - on return the Bernstein polynomials 0, 1, 2, and 3 at t.
+ * \param dB - on return the derivatives of the Bernstein polynomials at t.
+ */
+void Bernstein(float t, float B[4], float dB[4])
+{
+    float s = 1.0f - t;
+    B[0]  = s * s * s;
+    B[1]  = 3.0f * t * s * s;
+    B[2]  = 3.0f * t * t * s;
+    B[3]  = t * t * t;
+    dB[0] = -3.0f * s * s;
+    dB[1] = 3.0f * s * (s - 2.0f * t);
+    dB[2] = 3.0f * t * (2.0f * s - t);
+    dB[3] = 3.0f * t * t;
+}
+
+}
+
+/**
+ * \class BezierPatchSet
+ * A packed store of many Bezier patches in structure of arrays layout.
+ */
+
+/*
+ * Default constructor, creates an empty set.
+ */
+BezierPatchSet::BezierPatchSet() : npatches(0), stride(0)
+{
+    Trace("BezierPatchSet", "BezierPatchSet()");
+}
+
+/*
+ * Parameterized constructor, packs a vector of bezier patches.
+ * \param bezierpatches - the bezier patches.
+ */
+BezierPatchSet::BezierPatchSet(std::vector<BezierPatch> const& bezierpatches) : npatches(0), stride(0)
+{
+    Trace("BezierPatchSet", "BezierPatchSet(std::vector<BezierPatch> const&)");
+
+    this->Restride((bezierpatches.size() + 15) / 16 * 16);
+    for (BezierPatch const& bezierpatch : bezierpatches) {
+        this->Append(bezierpatch);
+    }
+}
+
+/*
+ * Parameterized constructor, reads the bezier patches from a file.
+ * \param filename - the name of the file containing the bezier patches.
+ */
+BezierPatchSet::BezierPatchSet(std::string const& filename) : npatches(0), stride(0)
+{
+    Trace("BezierPatchSet", "BezierPatchSet(std::string const&)");
+
+    std::vector<BezierPatch> bezierpatches;
+    ReadBezierPatches(filename.c_str(), bezierpatches);
+    *this = BezierPatchSet(bezierpatches);
+}
+
+/*
+ * Destroys the current instance of the set.
+ */
+BezierPatchSet::~BezierPatchSet()
+{
+    Trace("BezierPatchSet", "~BezierPatchSet()");
+}
+
+/*
+ * The number of patches in the set.
+ * \return the number of patches.
+ */
+unsigned int BezierPatchSet::NumberOfPatches() const
+{
+    return this->npatches;
+}
+
+/*
+ * The distance in floats between the arrays of two consecutive control points or coordinates.
+ * \return the stride of the arrays.
+ */
+unsigned int BezierPatchSet::Stride() const
+{
+    return this->stride;
+}
+
+/*
+ * The array of one coordinate of one control point over all patches.
+ * \param coordinate - the coordinate, 0 = x, 1 = y, 2 = z.
+ * \param controlpoint - the control point, 0 <= controlpoint < 16.
+ * \return the aligned array of NumberOfPatches() floats.
+ */
+float const* BezierPatchSet::Coordinates(int coordinate, int controlpoint) const
+{
+    if ((coordinate < 0) || (coordinate > 2) || (controlpoint < 0) || (controlpoint > 15)) {
+        throw std::out_of_range("BezierPatchSet::Coordinates(int, int): the coordinate must be in {0, 1, 2}, "
+                                "and the control point in {0,...,15}");
+    }
+    return this->coordinates.data() + (16 * coordinate + controlpoint) * this->stride;
+}
+
+/*
+ * Appends a patch to the set.
+ * \param bezierpatch - the patch.
+ */
+void BezierPatchSet::Append(BezierPatch const& bezierpatch)
+{
+    if (this->npatches == this->stride) {
+        this->Restride(std::max(16u, 2 * this->stride));
+    }
+    for (int i = 1; i <= 4; ++i) {
+        for (int j = 1; j <= 4; ++j) {
+            glm::vec3 const& controlpoint = bezierpatch[i][j];
+            for (int c = 0; c < 3; ++c) {
+                this->Array(c, 4 * (i - 1) + (j - 1))[this->npatches] = controlpoint[c];
+            }
+        }
+    }
+    ++this->npatches;
+}
+
+/*
+ * Unpacks a patch of the set.
+ * \param patch - the number of the patch, 0 <= patch < NumberOfPatches().
+ * \return the patch as a BezierPatch.
+ */
+BezierPatch BezierPatchSet::Patch(unsigned int patch) const
+{
+    if (patch >= this->npatches) {
+        throw std::out_of_range("BezierPatchSet::Patch(unsigned int): the patch does not exist");
+    }
+    BezierPatch bezierpatch;
+    for (int i = 1; i <= 4; ++i) {
+        for (int j = 1; j <= 4; ++j) {
+            int k = 4 * (i - 1) + (j - 1);
+            bezierpatch[i][j] = glm::vec3(this->Coordinates(0, k)[patch],
+                                          this->Coordinates(1, k)[patch],
+                                          this->Coordinates(2, k)[patch]);
+        }
+    }
+    return bezierpatch;
+}
+
+/*
+ * Transforms the control points of all patches, where a projective transformation is followed by the division by w.
+ * \param matrix - the transformation.
+ */
+void BezierPatchSet::Transform(glm::mat4x4 const& matrix)
+{
+    bool const affine = (matrix[0][3] == 0.0f) && (matrix[1][3] == 0.0f) && (matrix[2][3] == 0.0f)
+                     && (matrix[3][3] == 1.0f);
+    ParallelFor(0, this->npatches, [&](std::size_t first, std::size_t last) {
+        for (int k = 0; k < 16; ++k) {
+            float* x = this->Array(0, k);
+            float* y = this->Array(1, k);
+            float* z = this->Array(2, k);
+            for (unsigned int p = first; p < last; ++p) {
+                float tx = matrix[0][0] * x[p] + matrix[1][0] * y[p] + matrix[2][0] * z[p] + matrix[3][0];
+                float ty = matrix[0][1] * x[p] + matrix[1][1] * y[p] + matrix[2][1] * z[p] + matrix[3][1];
+                float tz = matrix[0][2] * x[p] + matrix[1][2] * y[p] + matrix[2][2] * z[p] + matrix[3][2];
+                float tw = 1.0f;
+                if (!affine) {
+                    tw = matrix[0][3] * x[p] + matrix[1][3] * y[p] + matrix[2][3] * z[p] + matrix[3][3];
+                }
+                x[p] = tx / tw;
+                y[p] = ty / tw;
+                z[p] = tz / tw;
+            }
+        }
+    }, MinBlockSize);
+}
+
+/*
+ * Evaluates all patches at the same parameters.
+ * \param u - the first parameter, 0 <= u <= 1.
+ * \param v - the second parameter, 0 <= v <= 1.
+ * \param points - room for NumberOfPatches() points, on return the points of the patches.
+ * \param normals - room for NumberOfPatches() normals, on return the unit normals, or a null pointer.
+ */
+void BezierPatchSet::Evaluate(float u, float v, glm::vec3* points, glm::vec3* normals) const
+{
+    // The weights of the control points are the same for all patches
+    float Bu[4];
+    float dBu[4];
+    float Bv[4];
+    float dBv[4];
+    Bernstein(u, Bu, dBu);
+    Bernstein(v, Bv, dBv);
+    float weight[16];
+    float weight_u[16];
+    float weight_v[16];
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            weight[4 * i + j]   = Bu[i]  * Bv[j];
+            weight_u[4 * i + j] = dBu[i] * Bv[j];
+            weight_v[4 * i + j] = Bu[i]  * dBv[j];
+        }
+    }
+
+    ParallelFor(0, this->npatches, [&](std::size_t first, std::size_t last) {
+        std::vector<float> S(3 * (last - first), 0.0f);
+        std::vector<float> Su(normals ? 3 * (last - first) : 0, 0.0f);
+        std::vector<float> Sv(normals ? 3 * (last - first) : 0, 0.0f);
+        for (int c = 0; c < 3; ++c) {
+            float* s  = S.data() + c * (last - first);
+            for (int k = 0; k < 16; ++k) {
+                float const* G = this->Coordinates(c, k) + first;
+                for (unsigned int p = 0; p < last - first; ++p) {
+                    s[p] += weight[k] * G[p];
+                }
+                if (normals) {
+                    float* su = Su.data() + c * (last - first);
+                    float* sv = Sv.data() + c * (last - first);
+                    for (unsigned int p = 0; p < last - first; ++p) {
+                        su[p] += weight_u[k] * G[p];
+                        sv[p] += weight_v[k] * G[p];
+                    }
+                }
+            }
+        }
+
+        unsigned int n = last - first;
+        for (unsigned int p = 0; p < n; ++p) {
+            points[first + p] = glm::vec3(S[p], S[n + p], S[2 * n + p]);
+            if (normals) {
+                glm::vec3 normal = glm::cross(glm::vec3(Su[p], Su[n + p], Su[2 * n + p]),
+                                              glm::vec3(Sv[p], Sv[n + p], Sv[2 * n + p]));
+                if (normal != glm::vec3(0.0f)) {
+                    normal = glm::normalize(normal);
+                }
+                normals[first + p] = normal;
+            }
+        }
+    }, MinBlockSize);
+}
+
+/*
+ * Subdivides all patches once at u = 1/2 and v = 1/2.
+ * \return the set of 4 * NumberOfPatches() sub-patches, where sub-patch k of patch p is patch k * NumberOfPatches() + p.
+ */
+BezierPatchSet BezierPatchSet::Subdivide() const
+{
+    unsigned int const n = this->npatches;
+    BezierPatchSet subpatches;
+    subpatches.Restride((4 * n + 15) / 16 * 16);
+    subpatches.npatches = 4 * n;
+
+    ParallelFor(0, n, [&](std::size_t first, std::size_t last) {
+        for (int c = 0; c < 3; ++c) {
+            float const* G[16];
+            float* H[4][16];
+            for (int k = 0; k < 16; ++k) {
+                G[k] = this->Coordinates(c, k);
+                for (int sub = 0; sub < 4; ++sub) {
+                    H[sub][k] = subpatches.Array(c, k) + sub * n;
+                }
+            }
+            for (unsigned int p = first; p < last; ++p) {
+                // Split the columns in the direction of u, and then the rows of both halves in the direction of v
+                float low[4][4];
+                float high[4][4];
+                for (int j = 0; j < 4; ++j) {
+                    float left[4];
+                    float right[4];
+                    Split(G[j][p], G[4 + j][p], G[8 + j][p], G[12 + j][p], left, right);
+                    for (int i = 0; i < 4; ++i) {
+                        low[i][j]  = left[i];
+                        high[i][j] = right[i];
+                    }
+                }
+                for (int i = 0; i < 4; ++i) {
+                    float left[4];
+                    float right[4];
+                    Split(low[i][0], low[i][1], low[i][2], low[i][3], left, right);
+                    for (int j = 0; j < 4; ++j) {
+                        H[0][4 * i + j][p] = left[j];
+                        H[1][4 * i + j][p] = right[j];
+                    }
+                    Split(high[i][0], high[i][1], high[i][2], high[i][3], left, right);
+                    for (int j = 0; j < 4; ++j) {
+                        H[2][4 * i + j][p] = left[j];
+                        H[3][4 * i + j][p] = right[j];
+                    }
+                }
+            }
+        }
+    }, MinBlockSize);
+    return subpatches;
+}
+
+/*
+ * Computes the axis aligned bounding boxes of the control points of all patches.
+ * \param boxmin - room for NumberOfPatches() points, on return the lower corners of the bounding boxes.
+ * \param boxmax - room for NumberOfPatches() points, on return the upper corners of the bounding boxes.
+ */
+void BezierPatchSet::BoundingBoxes(glm::vec3* boxmin, glm::vec3* boxmax) const
+{
+    ParallelFor(0, this->npatches, [&](std::size_t first, std::size_t last) {
+        std::vector<float> lower(last - first);
+        std::vector<float> upper(last - first);
+        for (int c = 0; c < 3; ++c) {
+            float const* G = this->Coordinates(c, 0) + first;
+            std::copy(G, G + (last - first), lower.begin());
+            std::copy(G, G + (last - first), upper.begin());
+            for (int k = 1; k < 16; ++k) {
+                G = this->Coordinates(c, k) + first;
+                for (unsigned int p = 0; p < last - first; ++p) {
+                    lower[p] = std::min(lower[p], G[p]);
+                    upper[p] = std::max(upper[p], G[p]);
+                }
+            }
+            for (unsigned int p = 0; p < last - first; ++p) {
+                boxmin[first + p][c] = lower[p];
+                boxmax[first + p][c] = upper[p];
+            }
+        }
+    }, MinBlockSize);
+}
+
+// Private member functions
+
+/*
+ * Changes the stride of the arrays, and moves the patches to the new positions.
+ * \param stride - the new stride, a multiple of 16.
+ */
+void BezierPatchSet::Restride(unsigned int stride)
+{
+    std::vector<float, AlignedAllocator<float, Alignment>> coordinates(3 * 16 * std::size_t(stride), 0.0f);
+    for (int array = 0; array < 3 * 16; ++array) {
+        std::copy(this->coordinates.begin() + std::size_t(array) * this->stride,
+                  this->coordinates.begin() + std::size_t(array) * this->stride + this->npatches,
+                  coordinates.begin() + std::size_t(array) * stride);
+    }
+    this->coordinates.swap(coordinates);
+    this->stride = stride;
+}
+
+/*
+ * The array of one coordinate of one control point over all patches.
+ * \param coordinate - the coordinate, 0 = x, 1 = y, 2 = z.
+ * \param controlpoint - the control point, 0 <= controlpoint < 16.
+ * \return the aligned array.
+ */
+float* BezierPatchSet::Array(int coordinate, int controlpoint)
+{
+    return this->coordinates.data() + (16 * coordinate + controlpoint) * this->stride;
+}
@@ -1,11 +1,197 @@
+#include <array>
+#include <limits>
+#include <map>
+#include <set>
+
 #include "beziersurface.h"
+#include "parallelfor.h"
+
+namespace {
+
+/*
+ * The normal at a corner of a patch from the 2 x 2 control points at the corner.
+ * If an edge is collapsed to a point, e.g. at the poles of the teapot, the tangent of the neighbouring row
+ * or column is used instead, which is the limit of the tangents towards the corner.
+ * \param corner - the control point at the corner.
+ * \param next_i - the next control point along the first index.
+ * \param next_j - the next control point along the second index.
+ * \param diagonal - the control point next to both next_i and next_j.
+ * \param orientation - 1 if next_i and next_j are both at larger or both at smaller indices than the corner, else -1.
+ * \return the unit normal, oriented as the cross product of the tangents along increasing i and increasing j.
+ */
+glm::vec3 CornerNormal(glm::vec3 const& corner, glm::vec3 const& next_i, glm::vec3 const& next_j,
+                       glm::vec3 const& diagonal, float orientation)
+{
+    glm::vec3 tangent_i = next_i - corner;
+    glm::vec3 tangent_j = next_j - corner;
+    if (glm::dot(tangent_i, tangent_i) < 1.0e-12f) {
+        tangent_i = diagonal - next_j;
+    }
+    if (glm::dot(tangent_j, tangent_j) < 1.0e-12f) {
+        tangent_j = diagonal - next_i;
+    }
+
+    glm::vec3 normal = orientation * glm::cross(tangent_i, tangent_j);
+    if (normal != glm::vec3(0.0f)) {
+        normal = glm::normalize(normal);
+    }
+    return normal;
+}
+
+/*
+ * The normal at a corner of a patch, i.e. the cross product of the tangents along the two edges which meet there.
+ * \param G - the geometry matrix of the patch.
+ * \param i - the row of the corner, 1 or 4.
+ * \param j - the column of the corner, 1 or 4.
+ * \return the unit normal, oriented as the cross product of the tangents along increasing i and increasing j.
+ */
+glm::vec3 CornerNormal(BezierPatch const& G, int i, int j)
+{
+    int di = (i == 1) ? 1 : -1;
+    int dj = (j == 1) ? 1 : -1;
+    return CornerNormal(G[i][j], G[i + di][j], G[i][j + dj], G[i + di][j + dj], float(di * dj));
+}
+
+/*
+ * The index of the quadrilateral number q of a patch which is subdivided level times, in the order in which
+ * the recursive subdivision emits the quadrilaterals, i.e. the bits of q alternate between u and v.
+ * \param q - the number of the quadrilateral, 0 <= q < 4^level.
+ * \param level - the number of subdivisions.
+ * \param i - on return the index of the quadrilateral in the u-direction.
+ * \param j - on return the index of the quadrilateral in the v-direction.
+ */
+void QuadIndex(unsigned int q, int level, unsigned int& i, unsigned int& j)
+{
+    i = 0;
+    j = 0;
+    for (int bit = 0; bit < level; ++bit) {
+        j |= ((q >> (2 * bit))     & 1u) << bit;
+        i |= ((q >> (2 * bit + 1)) & 1u) << bit;
+    }
+}
+
+// The culling tests of a patch, see BezierSurface::cull_bezierpatch(...)
+int const TestFrustum  = 1;
+int const TestBackface = 2;
+
+/*
+ * The vector which is orthogonal to three vectors in 4D, i.e. the generalized cross product.
+ * \param a - the first vector.
+ * \param b - the second vector.
+ * \param c - the third vector.
+ * \return the vector whose dot products with a, b, and c are 0, the zero vector if they are linearly dependent.
+ */
+glm::vec4 NullVector(glm::vec4 const& a, glm::vec4 const& b, glm::vec4 const& c)
+{
+    auto Determinant = [](glm::vec3 const& x, glm::vec3 const& y, glm::vec3 const& z) {
+        return glm::dot(x, glm::cross(y, z));
+    };
+    return glm::vec4( Determinant(glm::vec3(a.y, a.z, a.w), glm::vec3(b.y, b.z, b.w), glm::vec3(c.y, c.z, c.w)),
+                     -Determinant(glm::vec3(a.x, a.z, a.w), glm::vec3(b.x, b.z, b.w), glm::vec3(c.x, c.z, c.w)),
+                      Determinant(glm::vec3(a.x, a.y, a.w), glm::vec3(b.x, b.y, b.w), glm::vec3(c.x, c.y, c.w)),
+                     -Determinant(glm::vec3(a.x, a.y, a.z), glm::vec3(b.x, b.y, b.z), glm::vec3(c.x, c.y, c.z)));
+}
+
+/*
+ * The cubic Bernstein polynomials.
+ * \param t - the parameter.
+ * \return the Bernstein polynomials 0, 1, 2, and 3 at t.
+ */
+glm::vec4 Bernstein(float t)
+{
+    float s = 1.0f - t;
+    return glm::vec4(s * s * s, 3.0f * t * s * s, 3.0f * t * t * s, t * t * t);
+}
+
+/*
+ * The derivatives of the cubic Bernstein polynomials.
+ * \param t - the parameter.
+ * \return the derivatives of the Bernstein polynomials 0, 1, 2, and 3 at t.
+ */
+glm::vec4 DBernstein(float t)
+{
+    float s = 1.0f - t;
+    return glm::vec4(-3.0f * s * s, 3.0f * s * (s - 2.0f * t), 3.0f * t * (2.0f * s - t), 3.0f * t * t);
+}
+
+/*
+ * Finds the edges of a patch which are collapsed to a point, i.e. where all 4 control points coincide.
+ * \param G - the geometry matrix of the patch.
+ * \param collapsed - on return the edges u = 0, u = 1, v = 0, and v = 1 are collapsed.
+ */
+void CollapsedEdges(BezierPatch const& G, bool collapsed[4])
+{
+    int const corner[4][4] = { {1, 0, 1, 1}, {4, 0, 1, 1}, {1, 1, 1, 0}, {1, 1, 4, 0} };
+    for (int edge = 0; edge < 4; ++edge) {
+        int i  = corner[edge][0];
+        int di = corner[edge][1];
+        int j  = corner[edge][2];
+        int dj = corner[edge][3];
+        collapsed[edge] = true;
+        for (int k = 1; k < 4; ++k) {
+            glm::vec3 d = G[i + k * di][j + k * dj] - G[i][j];
+            if (glm::dot(d, d) >= 1.0e-12f) {
+                collapsed[edge] = false;
+            }
+        }
+    }
+}
+
+/*
+ * The normal of a patch, i.e. the normalized cross product of the partial derivatives.
+ * \param G - the geometry matrix of the patch.
+ * \param u - the first parameter.
+ * \param v - the second parameter.
+ * \return the unit normal oriented as S_u x S_v, or the zero vector if it vanishes.
+ */
+glm::vec3 PatchNormal(BezierPatch const& G, float u, float v)
+{
+    glm::vec4 U  = Bernstein(u);
+    glm::vec4 dU = DBernstein(u);
+    glm::vec4 V  = Bernstein(v);
+    glm::vec4 dV = DBernstein(v);
+    glm::vec3 tangent_u(0.0f);
+    glm::vec3 tangent_v(0.0f);
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            tangent_u += (dU[i] * V[j])  * G[i + 1][j + 1];
+            tangent_v += (U[i]  * dV[j]) * G[i + 1][j + 1];
+        }
+    }
+    glm::vec3 normal = glm::cross(tangent_u, tangent_v);
+    if (normal != glm::vec3(0.0f)) {
+        normal = glm::normalize(normal);
+    }
+    return normal;
+}
+
+/*
+ * The limit of the normal of a patch at a point where it vanishes, e.g. on a collapsed edge,
+ * i.e. the normal at a parameter slightly inside the patch.
+ * \param G - the geometry matrix of the patch.
+ * \param u - the first parameter.
+ * \param v - the second parameter.
+ * \return the unit normal oriented as S_u x S_v.
+ */
+glm::vec3 LimitNormal(BezierPatch const& G, float u, float v)
+{
+    float const nudge = 1.0e-3f;
+    u += (u < 0.5f) ? nudge : -nudge;
+    v += (v < 0.5f) ? nudge : -nudge;
+    return PatchNormal(G, u, v);
+}
+
+}
 
 // public member functions
 
 /*
  * Default constructor. Creates a BezierSurface which is empty.
  */
-BezierSurface::BezierSurface() : frontfacing(true), nsubdivisions(3), VerticesOK(false), NormalsOK(false)
+BezierSurface::BezierSurface() : frontfacing(true), nsubdivisions(3), directevaluation(false),
+                                 subintervaloperators(false), adaptive(false), pixeltolerance(1.0f),
+                                 culling(false), backfaceculling(false), VerticesOK(false), NormalsOK(false),
+                                 IndexedOK(false)
 {}
 
 /*
@@ -13,7 +199,9 @@ BezierSurface::BezierSurface() : frontfacing(true), nsubdivisions(3), VerticesOK
  * \param Filename - the name of the file containing the bezier patches.
  */
 BezierSurface::BezierSurface(std::string Filename) : frontfacing(true), nsubdivisions(3),
-                             VerticesOK(false), NormalsOK(false)
+                             directevaluation(false), subintervaloperators(false),
+                             adaptive(false), pixeltolerance(1.0f), culling(false), backfaceculling(false),
+                             VerticesOK(false), NormalsOK(false), IndexedOK(false)
 {
     this->Read(Filename);
 }
@@ -23,7 +211,9 @@ BezierSurface::BezierSurface(std::string Filename) : frontfacing(true), nsubdivi
  * \param patches - the bezier patches which makes up the surface.
  */
 BezierSurface::BezierSurface(std::vector<BezierPatch> const& bezierpatches)
-             : frontfacing(true), nsubdivisions(3), VerticesOK(false), NormalsOK(false)
+             : frontfacing(true), nsubdivisions(3), directevaluation(false),
+               subintervaloperators(false), adaptive(false), pixeltolerance(1.0f),
+               culling(false), backfaceculling(false), VerticesOK(false), NormalsOK(false), IndexedOK(false)
 {
     this->BezierPatches = bezierpatches;
 }
@@ -34,13 +224,33 @@ BezierSurface::BezierSurface(std::vector<BezierPatch> const& bezierpatches)
  */
 BezierSurface::BezierSurface(BezierSurface const& Src)
 {
-    this->frontfacing   = Src.frontfacing;
-    this->nsubdivisions = Src.nsubdivisions;
-    this->VerticesOK    = Src.VerticesOK;
-    this->NormalsOK     = Src.NormalsOK;
-    this->BezierPatches = Src.BezierPatches;
-    this->vertices      = Src.vertices;
-    this->normals       = Src.normals;
+    this->frontfacing            = Src.frontfacing;
+    this->nsubdivisions          = Src.nsubdivisions;
+    this->directevaluation       = Src.directevaluation;
+    this->basis                  = Src.basis;
+    this->dbasis                 = Src.dbasis;
+    this->subintervaloperators   = Src.subintervaloperators;
+    this->subintervals           = Src.subintervals;
+    this->adaptive               = Src.adaptive;
+    this->adaptivetransformation = Src.adaptivetransformation;
+    this->halfscreensize         = Src.halfscreensize;
+    this->pixeltolerance         = Src.pixeltolerance;
+    this->culling                = Src.culling;
+    this->backfaceculling        = Src.backfaceculling;
+    this->cullingtransformation  = Src.cullingtransformation;
+    this->eye                    = Src.eye;
+    this->patchbounds            = Src.patchbounds;
+    this->VerticesOK             = Src.VerticesOK;
+    this->NormalsOK              = Src.NormalsOK;
+    this->BezierPatches          = Src.BezierPatches;
+    this->leaves.clear();
+    this->controlpointindices    = Src.controlpointindices;
+    this->vertices               = Src.vertices;
+    this->normals                = Src.normals;
+    this->IndexedOK              = Src.IndexedOK;
+    this->indexedvertices        = Src.indexedvertices;
+    this->indexednormals         = Src.indexednormals;
+    this->indices                = Src.indices;
 }
 
 /*
@@ -57,13 +267,33 @@ BezierSurface::~BezierSurface()
 BezierSurface& BezierSurface::operator=(BezierSurface const& Src)
 {
     if (this != &Src) {
-        this->frontfacing   = Src.frontfacing;
-        this->nsubdivisions = Src.nsubdivisions;
-        this->VerticesOK    = Src.VerticesOK;
-        this->NormalsOK     = Src.NormalsOK;
-        this->BezierPatches = Src.BezierPatches;
-        this->vertices      = Src.vertices;
-        this->normals       = Src.normals;
+        this->frontfacing            = Src.frontfacing;
+        this->nsubdivisions          = Src.nsubdivisions;
+        this->directevaluation       = Src.directevaluation;
+        this->basis                  = Src.basis;
+        this->dbasis                 = Src.dbasis;
+        this->subintervaloperators   = Src.subintervaloperators;
+        this->subintervals           = Src.subintervals;
+        this->adaptive               = Src.adaptive;
+        this->adaptivetransformation = Src.adaptivetransformation;
+        this->halfscreensize         = Src.halfscreensize;
+        this->pixeltolerance         = Src.pixeltolerance;
+        this->culling                = Src.culling;
+        this->backfaceculling        = Src.backfaceculling;
+        this->cullingtransformation  = Src.cullingtransformation;
+        this->eye                    = Src.eye;
+        this->patchbounds            = Src.patchbounds;
+        this->VerticesOK             = Src.VerticesOK;
+        this->NormalsOK              = Src.NormalsOK;
+        this->BezierPatches          = Src.BezierPatches;
+        this->leaves.clear();
+        this->controlpointindices    = Src.controlpointindices;
+        this->vertices               = Src.vertices;
+        this->normals                = Src.normals;
+        this->IndexedOK              = Src.IndexedOK;
+        this->indexedvertices        = Src.indexedvertices;
+        this->indexednormals         = Src.indexednormals;
+        this->indices                = Src.indices;
     }
     return *this;
 }
@@ -83,7 +313,12 @@ bool BezierSurface::FrontFacing() const
  */
 void BezierSurface::FrontFacing(bool frontfacing)
 {
-    this->frontfacing = frontfacing;
+    if (this->frontfacing != frontfacing) {
+        this->frontfacing = frontfacing;
+        this->VerticesOK  = false;
+        this->NormalsOK   = false;
+        this->IndexedOK   = false;
+    }
 }
 
 /*
@@ -97,18 +332,194 @@ int BezierSurface::NumberOfSubdivisions() const
 
 /*
  * Specify how many times the BezierSurface should be subdivided.
- * \param subdivisionlevel - the number of subdivisions that should be done.
+ * \param subdivisionlevel - the number of subdivisions that should be done, 0 <= Nsubdivisions <= 12.
  * \return the previous number of the subdivision level.
  */
 int BezierSurface::NumberOfSubdivisions(int Nsubdivisions)
 {
+    if ((Nsubdivisions < 0) || (Nsubdivisions > 12)) {
+        throw std::invalid_argument("BezierSurface::NumberOfSubdivisions(int): Nsubdivisions must be in [0, 12]");
+    }
     int OldNumberOfSubdivisions = this->nsubdivisions;
     this->nsubdivisions         = Nsubdivisions;
     this->VerticesOK            = false;
     this->NormalsOK             = false;
+    this->IndexedOK             = false;
     return OldNumberOfSubdivisions;
 }
 
+/*
+ * Releases the kept sub-patches of the uniform subdivision, which are computed again when they are needed.
+ */
+void BezierSurface::ReleaseLeaves()
+{
+    this->leaves.clear();
+}
+
+/*
+ * Tells whether the patches are tessellated by direct evaluation or by subdivision.
+ * \return true if the patches are evaluated directly, false if they are subdivided.
+ */
+bool BezierSurface::DirectEvaluation() const
+{
+    return this->directevaluation;
+}
+
+/*
+ * Chooses whether the patches are tessellated by direct evaluation or by subdivision.
+ * \param directevaluation - true if the patches should be evaluated directly, false if they should be subdivided.
+ */
+void BezierSurface::DirectEvaluation(bool directevaluation)
+{
+    if (this->directevaluation != directevaluation) {
+        this->directevaluation = directevaluation;
+        this->VerticesOK       = false;
+        this->NormalsOK        = false;
+    }
+}
+
+/*
+ * Tells whether the subdivision produces the sub-patches from precomputed sub-interval operators or recursively.
+ * \return true if the sub-interval operators are used, false if the patches are subdivided recursively.
+ */
+bool BezierSurface::SubintervalOperators() const
+{
+    return this->subintervaloperators;
+}
+
+/*
+ * Chooses whether the subdivision produces the sub-patches from precomputed sub-interval operators or recursively.
+ * \param subintervaloperators - true if the sub-interval operators should be used, false if the patches should be
+ *                               subdivided recursively.
+ */
+void BezierSurface::SubintervalOperators(bool subintervaloperators)
+{
+    if (this->subintervaloperators != subintervaloperators) {
+        this->subintervaloperators = subintervaloperators;
+        this->VerticesOK           = false;
+        this->NormalsOK            = false;
+    }
+}
+
+/*
+ * Tells whether the patches are subdivided adaptively for a view or uniformly.
+ * \return true if the patches are subdivided adaptively, false if they are subdivided uniformly.
+ */
+bool BezierSurface::AdaptiveSubdivision() const
+{
+    return this->adaptive;
+}
+
+/*
+ * Subdivides the patches adaptively for a view.
+ * \param camera - the camera which views the surface.
+ * \param pixeltolerance - the largest projected flatness error of a leaf in pixels, pixeltolerance > 0.
+ * \param screensize - the width and height of the viewport in pixels.
+ * \param model - the transformation from model coordinates to world coordinates.
+ */
+void BezierSurface::AdaptiveSubdivision(Camera const& camera, float pixeltolerance, glm::vec2 const& screensize,
+                                        glm::mat4x4 const& model)
+{
+    if (pixeltolerance <= 0.0f) {
+        throw std::invalid_argument("BezierSurface::AdaptiveSubdivision(Camera const&, float, vec2 const&, "
+                                    "mat4x4 const&): the pixel tolerance must be positive");
+    }
+    if ((screensize.x <= 0.0f) || (screensize.y <= 0.0f)) {
+        throw std::invalid_argument("BezierSurface::AdaptiveSubdivision(Camera const&, float, vec2 const&, "
+                                    "mat4x4 const&): the screen size must be positive");
+    }
+    this->adaptive               = true;
+    this->adaptivetransformation = camera.ViewProjection() * camera.ViewOrientation() * model;
+    this->halfscreensize         = 0.5f * screensize;
+    this->pixeltolerance         = pixeltolerance;
+    this->VerticesOK             = false;
+    this->NormalsOK              = false;
+}
+
+/*
+ * Subdivides all patches uniformly NumberOfSubdivisions() times.
+ */
+void BezierSurface::UniformSubdivision()
+{
+    if (this->adaptive) {
+        this->adaptive   = false;
+        this->VerticesOK = false;
+        this->NormalsOK  = false;
+    }
+}
+
+/*
+ * Tells whether the tessellation is culled against a view.
+ * \return true if the patches are culled, false if all patches are tessellated.
+ */
+bool BezierSurface::Culling() const
+{
+    return this->culling;
+}
+
+/*
+ * Culls the tessellation against a view.
+ * \param camera - the camera which views the surface.
+ * \param model - the transformation from model coordinates to world coordinates.
+ * \param backfaces - true if patches which face away from the camera should be culled.
+ */
+void BezierSurface::Culling(Camera const& camera, glm::mat4x4 const& model, bool backfaces)
+{
+    this->Culling(camera.ViewProjection() * camera.ViewOrientation() * model, backfaces);
+}
+
+/*
+ * Culls the tessellation against a view.
+ * \param transformation - the transformation from model coordinates to the canonical view volume.
+ * \param backfaces - true if patches which face away from the camera should be culled.
+ */
+void BezierSurface::Culling(glm::mat4x4 const& transformation, bool backfaces)
+{
+    this->culling               = true;
+    this->backfaceculling       = backfaces;
+    this->cullingtransformation = transformation;
+
+    // The center of projection is the point which is projected to x = y = w = 0, i.e. it is orthogonal
+    // to the rows x, y, and w of the transformation. It is at infinity for a parallel projection,
+    // and then it is the direction towards the front clipping plane z = 0, i.e. the direction in which z grows.
+    glm::mat4x4 const& T = this->cullingtransformation;
+    glm::vec4 row_x(T[0][0], T[1][0], T[2][0], T[3][0]);
+    glm::vec4 row_y(T[0][1], T[1][1], T[2][1], T[3][1]);
+    glm::vec4 row_z(T[0][2], T[1][2], T[2][2], T[3][2]);
+    glm::vec4 row_w(T[0][3], T[1][3], T[2][3], T[3][3]);
+    this->eye = NullVector(row_x, row_y, row_w);
+    float length = glm::length(glm::vec3(this->eye));
+    if (std::fabs(this->eye.w) > 1.0e-6f * length) {
+        this->eye /= this->eye.w;
+    }
+    else if (length > 0.0f) {
+        this->eye = glm::vec4(glm::vec3(this->eye) / length, 0.0f);
+        if (glm::dot(row_z, this->eye) < 0.0f) {
+            this->eye = -this->eye;
+        }
+    }
+    else {
+        throw std::invalid_argument("BezierSurface::Culling(mat4x4 const&, bool): "
+                                    "the transformation is singular");
+    }
+
+    this->ComputePatchBounds();
+    this->VerticesOK = false;
+    this->NormalsOK  = false;
+}
+
+/*
+ * Tessellates all patches.
+ */
+void BezierSurface::NoCulling()
+{
+    if (this->culling) {
+        this->culling    = false;
+        this->VerticesOK = false;
+        this->NormalsOK  = false;
+    }
+}
+
 /*
  * Computes the vertices of the BezierSurface.
  * \return a vector containing the vertices of the triangles that approximate the BezierSurface.
@@ -116,11 +527,113 @@ int BezierSurface::NumberOfSubdivisions(int Nsubdivisions)
 std::vector<glm::vec3> const& BezierSurface::Vertices()
 {
     if (!this->VerticesOK) {
-        this->vertices.clear();
-        this->normals.clear();
+        if (this->adaptive) {
+            this->adaptive_subdivision();
+        }
+        else {
+            // Each patch is subdivided into 4^nsubdivisions quadrilaterals, i.e. a known number of triangle vertices,
+            // so each patch writes its own range of the presized vectors, and the order is the same as sequentially
+            unsigned int patchsize = 6 * (1u << (2 * this->nsubdivisions));
+            this->vertices.resize(this->BezierPatches.size() * patchsize);
+            this->normals.resize(this->BezierPatches.size() * patchsize);
 
-        for (int patch = 0; patch < this->BezierPatches.size(); ++patch) {
-            this->subdivide_bezierpatch(this->BezierPatches[patch], this->nsubdivisions);
+            if (this->directevaluation) {
+                this->ComputeBasis((1u << this->nsubdivisions) + 1);
+            }
+            else if (this->subintervaloperators) {
+                this->ComputeSubintervals(this->nsubdivisions);
+            }
+
+            // Without culling the subdivision only writes the kept sub-patches of the level, see ComputeLeaves(...)
+            bool const cached = !this->directevaluation && !this->subintervaloperators && !this->culling;
+            if (cached) {
+                this->ComputeLeaves(this->nsubdivisions);
+            }
+
+            // A culled patch, or a patch with culled sub-patches, writes less than its range
+            std::vector<unsigned int> nwritten(this->BezierPatches.size(), patchsize);
+            int const tests = this->culling ? (TestFrustum | (this->backfaceculling ? TestBackface : 0)) : 0;
+            ParallelFor(0, this->BezierPatches.size(), [&](std::size_t firstpatch, std::size_t lastpatch) {
+                if (cached) {
+                    // The base 4 digits of leaf number r of the recursive subdivision are its sub-patches from the
+                    // first subdivision to the last, and the set keeps them in reverse order, i.e. leaf r of a patch
+                    // is sub-patch m * npatches + patch, where m has the digits of r reversed. The leaves are read
+                    // in the order of the set, and each leaf is written to its position in the range of its patch.
+                    // The control points are read directly from the arrays of the set, control point 4 * i + j
+                    // is G[i + 1][j + 1], and the quadrilateral is written like a leaf of subdivide_bezierpatch(...)
+                    BezierPatchSet const& leaves = this->leaves[this->nsubdivisions];
+                    float const* arrays[3][16];
+                    for (int c = 0; c < 3; ++c) {
+                        for (int k = 0; k < 16; ++k) {
+                            arrays[c][k] = leaves.Coordinates(c, k);
+                        }
+                    }
+                    unsigned int const npatches = this->BezierPatches.size();
+                    unsigned int const nleaves  = patchsize / 6;
+                    for (unsigned int m = 0; m < nleaves; ++m) {
+                        unsigned int r = 0;
+                        for (int k = 0; k < this->nsubdivisions; ++k) {
+                            r = 4 * r + ((m >> (2 * k)) & 3u);
+                        }
+                        for (unsigned int patch = firstpatch; patch < lastpatch; ++patch) {
+                            unsigned int leaf = m * npatches + patch;
+                            glm::vec3 P[16];
+                            for (int k = 0; k < 16; ++k) {
+                                P[k] = glm::vec3(arrays[0][k][leaf], arrays[1][k][leaf], arrays[2][k][leaf]);
+                            }
+                            glm::vec3* leafvertices = this->vertices.data() + patch * patchsize + 6 * r;
+                            glm::vec3* leafnormals  = this->normals.data()  + patch * patchsize + 6 * r;
+                            this->write_quadrilateral(P[0], P[12], P[15], P[3],
+                                                      CornerNormal(P[0],  P[4],  P[1],  P[5],   1.0f),
+                                                      CornerNormal(P[12], P[8],  P[13], P[9],  -1.0f),
+                                                      CornerNormal(P[15], P[11], P[14], P[10],  1.0f),
+                                                      CornerNormal(P[3],  P[7],  P[2],  P[6],  -1.0f),
+                                                      leafvertices, leafnormals);
+                        }
+                    }
+                    return;
+                }
+                for (unsigned int patch = firstpatch; patch < lastpatch; ++patch) {
+                    int patchtests = 0;
+                    if (tests != 0) {
+                        patchtests = this->cull_bezierpatch(this->patchbounds[patch], tests);
+                        if (patchtests < 0) {
+                            nwritten[patch] = 0;
+                            continue;
+                        }
+                    }
+                    glm::vec3* patchvertices = this->vertices.data() + patch * patchsize;
+                    glm::vec3* patchnormals  = this->normals.data()  + patch * patchsize;
+                    if (this->directevaluation) {
+                        this->evaluate_bezierpatch(this->BezierPatches[patch], patchvertices, patchnormals);
+                    }
+                    else if (this->subintervaloperators) {
+                        this->subdivide_bezierpatch(this->BezierPatches[patch], patchvertices, patchnormals,
+                                                    patchtests);
+                        nwritten[patch] = patchvertices - (this->vertices.data() + patch * patchsize);
+                    }
+                    else {
+                        this->subdivide_bezierpatch(this->BezierPatches[patch], this->nsubdivisions,
+                                                    patchvertices, patchnormals, patchtests);
+                        nwritten[patch] = patchvertices - (this->vertices.data() + patch * patchsize);
+                    }
+                }
+            });
+
+            // Move the written ranges together
+            if (this->culling) {
+                std::size_t nvertices = 0;
+                for (unsigned int patch = 0; patch < this->BezierPatches.size(); ++patch) {
+                    std::size_t first = std::size_t(patch) * patchsize;
+                    std::copy(this->vertices.begin() + first, this->vertices.begin() + first + nwritten[patch],
+                              this->vertices.begin() + nvertices);
+                    std::copy(this->normals.begin() + first, this->normals.begin() + first + nwritten[patch],
+                              this->normals.begin() + nvertices);
+                    nvertices += nwritten[patch];
+                }
+                this->vertices.resize(nvertices);
+                this->normals.resize(nvertices);
+            }
         }
         this->VerticesOK = true;
         this->NormalsOK  = true;
@@ -142,6 +655,91 @@ std::vector<glm::vec3> const& BezierSurface::Normals()
 }
 
 
+/*
+ * The number of triangle vertices, i.e. the number of entries in Vertices() and Normals().
+ * \return the number of triangle vertices.
+ */
+unsigned int BezierSurface::NumberOfVertices()
+{
+    return this->Vertices().size();
+}
+
+/*
+ * Writes the triangle vertices and normals interleaved into a destination supplied by the caller.
+ * \param destination - room for 2 * NumberOfVertices() 3D vectors.
+ */
+void BezierSurface::WriteInterleaved(glm::vec3* destination)
+{
+    std::vector<glm::vec3> const& vertices = this->Vertices();
+    std::vector<glm::vec3> const& normals  = this->Normals();
+    for (std::size_t i = 0; i < vertices.size(); ++i) {
+        destination[2 * i]     = vertices[i];
+        destination[2 * i + 1] = normals[i];
+    }
+}
+
+/*
+ * Computes the axis aligned bounding box of the surface.
+ * \param boxmin - on return the lower corner of the bounding box.
+ * \param boxmax - on return the upper corner of the bounding box.
+ */
+void BezierSurface::BoundingBox(glm::vec3& boxmin, glm::vec3& boxmax)
+{
+    std::vector<glm::vec3> const& vertices = this->Vertices();
+    ::BoundingBox(vertices.data(), vertices.size(), boxmin, boxmax);
+}
+
+/*
+ * Writes the triangle vertices and normals as quantized vertices into a destination supplied by the caller.
+ * \param destination - room for NumberOfVertices() quantized vertices.
+ */
+void BezierSurface::WriteQuantized(QuantizedVertex* destination)
+{
+    glm::vec3 boxmin;
+    glm::vec3 boxmax;
+    this->BoundingBox(boxmin, boxmax);
+
+    std::vector<glm::vec3> const& vertices = this->Vertices();
+    std::vector<glm::vec3> const& normals  = this->Normals();
+    EncodeVertices(vertices.data(), normals.data(), vertices.size(), boxmin, boxmax, destination);
+}
+
+/*
+ * Computes the vertices of the indexed mesh of the BezierSurface.
+ * \return a vector containing the vertices, which are indexed by Indices().
+ */
+std::vector<glm::vec3> const& BezierSurface::IndexedVertices()
+{
+    if (!this->IndexedOK) {
+        this->indexed_tessellation();
+    }
+    return this->indexedvertices;
+}
+
+/*
+ * Computes the normals of the indexed mesh of the BezierSurface.
+ * \return a vector containing the normals of the vertices of IndexedVertices().
+ */
+std::vector<glm::vec3> const& BezierSurface::IndexedNormals()
+{
+    if (!this->IndexedOK) {
+        this->indexed_tessellation();
+    }
+    return this->indexednormals;
+}
+
+/*
+ * The indices into IndexedVertices() and IndexedNormals() of the triangle vertices.
+ * \return a vector containing the indices of the triangle vertices.
+ */
+std::vector<unsigned int> const& BezierSurface::Indices()
+{
+    if (!this->IndexedOK) {
+        this->indexed_tessellation();
+    }
+    return this->indices;
+}
+
 // protected member functions
 
 // private member functions
@@ -316,6 +914,14 @@ void BezierSurface::Read(std::string const& FileName)
                         BPatch[4][4] = Vertices[index_44 - 1];
             
                         this->BezierPatches.push_back(BPatch);
+
+                        // Remember which control points the patch shares with other patches
+                        int const patchindices[16] = { index_11, index_12, index_13, index_14,
+                                                       index_21, index_22, index_23, index_24,
+                                                       index_31, index_32, index_33, index_34,
+                                                       index_41, index_42, index_43, index_44 };
+                        this->controlpointindices.insert(this->controlpointindices.end(),
+                                                         patchindices, patchindices + 16);
                     }
                 }
                 break;
@@ -388,10 +994,929 @@ void BezierSurface::PrintIndexMatrix(int PatchNumber,
  * subdivides a BezierPatch
  * \param patch - the bezierpatch which should be subdivided.
  * \param level - the number of times the patch should be subdivided.
+ * \param vertices - the destination of the triangle vertices, on return it points past the written vertices.
+ * \param normals - the destination of the normals, on return it points past the written normals.
+ * \param tests - the culling tests which are needed for the sub-patches, see cull_bezierpatch(...).
  */
-void BezierSurface::subdivide_bezierpatch(BezierPatch const& G, int level)
+void BezierSurface::subdivide_bezierpatch(BezierPatch const& G, int level,
+                                          glm::vec3*& vertices, glm::vec3*& normals, int tests) const
 {
-    std::cout << "BezierSurface::subdivide_bezierpatch(BezierPatch&, int): Not implemented yet!" << std::endl;
+    if (level > 0) {
+        // DBL and DBR subdivide the columns when they right-multiply the patch, and their transposes subdivide
+        // the rows when they left-multiply it
+        BezierPatch G_L = glm::transpose(DBL) * G;
+        BezierPatch G_R = glm::transpose(DBR) * G;
+        BezierPatch subpatches[4] = { G_L * DBL, G_L * DBR, G_R * DBL, G_R * DBR };
+        for (BezierPatch const& subpatch : subpatches) {
+            int subtests = 0;
+            if (tests != 0) {
+                subtests = this->cull_bezierpatch(bezierpatch_bounds(subpatch), tests);
+                if (subtests < 0) continue;
+            }
+            this->subdivide_bezierpatch(subpatch, level - 1, vertices, normals, subtests);
+        }
+        return;
+    }
+
+    // The patch is flat enough, so it is approximated by the two triangles between its corners,
+    // where the first index of the patch is u and the second index is v
+    this->write_quadrilateral(G[1][1], G[4][1], G[4][4], G[1][4],
+                              CornerNormal(G, 1, 1), CornerNormal(G, 4, 1), CornerNormal(G, 4, 4), CornerNormal(G, 1, 4),
+                              vertices, normals);
+}
+
+/*
+ * Subdivides the finest kept sub-patches below a level until the sub-patches of the level are kept.
+ * \param level - the number of subdivisions.
+ */
+void BezierSurface::ComputeLeaves(int level)
+{
+    int const window = 2;
+
+    if (int(this->leaves.size()) <= level) {
+        this->leaves.resize(level + 1);
+    }
+    if (this->leaves[level].NumberOfPatches() == 0) {
+        // Start from the finest kept level below the level, or from the bezierpatches
+        int start = level;
+        while ((start >= 0) && (this->leaves[start].NumberOfPatches() == 0)) --start;
+        if (start < 0) {
+            start = 0;
+            this->leaves[0] = BezierPatchSet(this->BezierPatches);
+        }
+        for (int k = start; k < level; ++k) {
+            this->leaves[k + 1] = this->leaves[k].Subdivide();
+        }
+    }
+
+    // Only the levels within the window around the level are kept, so a slightly finer or coarser level
+    // than the current one is reused
+    for (int k = 0; k < int(this->leaves.size()); ++k) {
+        if (std::abs(k - level) > window) {
+            this->leaves[k] = BezierPatchSet();
+        }
+    }
+    while (this->leaves.back().NumberOfPatches() == 0) {
+        this->leaves.pop_back();
+    }
+}
+
+/*
+ * Computes the triangles of the adaptive subdivision for the view given by AdaptiveSubdivision(...).
+ */
+void BezierSurface::adaptive_subdivision()
+{
+    int const maxlevel = this->nsubdivisions;
+    unsigned int const N = 1u << maxlevel;
+    unsigned int const npatches = this->BezierPatches.size();
+
+    // Subdivide each patch until its leaves are flat on the screen
+    std::vector<std::vector<Leaf>> leaves(npatches);
+    int const tests = this->culling ? (TestFrustum | (this->backfaceculling ? TestBackface : 0)) : 0;
+    ParallelFor(0, npatches, [&](std::size_t firstpatch, std::size_t lastpatch) {
+        for (unsigned int patch = firstpatch; patch < lastpatch; ++patch) {
+            int patchtests = (tests != 0) ? this->cull_bezierpatch(this->patchbounds[patch], tests) : 0;
+            if (patchtests >= 0) {
+                this->adapt_bezierpatch(this->BezierPatches[patch], 0, 0, 0, leaves[patch], patchtests);
+            }
+        }
+    });
+
+    // The edges u = 0, u = 1, v = 0, and v = 1 of the patches, and their control points in the direction
+    // of the other parameter. Edges with the same control points, possibly in the opposite order, are shared
+    // by neighbouring patches, and they are evaluated in the same direction from both sides, so the vertices
+    // of the neighbours coincide exactly.
+    struct PatchEdge {
+        glm::vec3 P[4];     // The control points of the edge in its canonical direction
+        bool reversed;      // Is the canonical direction opposite to the direction of the parameter
+        int shared;         // The index of the vertices on the shared edge, -1 if the edge is collapsed
+    };
+    std::vector<std::array<PatchEdge, 4>> edges(npatches);
+    std::map<std::array<float, 12>, int> edgeindex;
+    std::vector<std::set<unsigned int>> edgepoints;
+    for (unsigned int patch = 0; patch < npatches; ++patch) {
+        BezierPatch const& G = this->BezierPatches[patch];
+        bool collapsed[4];
+        CollapsedEdges(G, collapsed);
+        for (int e = 0; e < 4; ++e) {
+            PatchEdge& edge = edges[patch][e];
+            for (int k = 0; k < 4; ++k) {
+                edge.P[k] = (e < 2) ? G[(e == 0) ? 1 : 4][k + 1] : G[k + 1][(e == 2) ? 1 : 4];
+            }
+            auto Less = [](glm::vec3 const& a, glm::vec3 const& b) {
+                return (a.x < b.x) || ((a.x == b.x) && ((a.y < b.y) || ((a.y == b.y) && (a.z < b.z))));
+            };
+            edge.reversed = Less(edge.P[3], edge.P[0]) || ((edge.P[3] == edge.P[0]) && Less(edge.P[2], edge.P[1]));
+            if (edge.reversed) {
+                std::swap(edge.P[0], edge.P[3]);
+                std::swap(edge.P[1], edge.P[2]);
+            }
+            edge.shared = -1;
+            if (collapsed[e]) continue;
+
+            std::array<float, 12> key;
+            for (int k = 0; k < 4; ++k) {
+                key[3 * k]     = edge.P[k].x;
+                key[3 * k + 1] = edge.P[k].y;
+                key[3 * k + 2] = edge.P[k].z;
+            }
+            auto found = edgeindex.find(key);
+            if (found == edgeindex.end()) {
+                found = edgeindex.insert(std::make_pair(key, int(edgepoints.size()))).first;
+                edgepoints.push_back(std::set<unsigned int>());
+            }
+            edge.shared = found->second;
+        }
+    }
+
+    // Register the corners of the leaves. A corner inside a patch is registered on the lines u = U and v = V
+    // of the patch, and a corner on the border is registered on the shared edge in its canonical direction.
+    std::vector<std::map<unsigned int, std::set<unsigned int>>> ulines(npatches);
+    std::vector<std::map<unsigned int, std::set<unsigned int>>> vlines(npatches);
+    auto Register = [&](unsigned int patch, unsigned int U, unsigned int V) {
+        if ((U == 0) || (U == N)) {
+            PatchEdge const& edge = edges[patch][(U == 0) ? 0 : 1];
+            if (edge.shared >= 0) edgepoints[edge.shared].insert(edge.reversed ? N - V : V);
+        }
+        else {
+            ulines[patch][U].insert(V);
+        }
+        if ((V == 0) || (V == N)) {
+            PatchEdge const& edge = edges[patch][(V == 0) ? 2 : 3];
+            if (edge.shared >= 0) edgepoints[edge.shared].insert(edge.reversed ? N - U : U);
+        }
+        else {
+            vlines[patch][V].insert(U);
+        }
+    };
+    for (unsigned int patch = 0; patch < npatches; ++patch) {
+        for (Leaf const& leaf : leaves[patch]) {
+            unsigned int size = N >> leaf.level;
+            Register(patch, leaf.U,        leaf.V);
+            Register(patch, leaf.U + size, leaf.V);
+            Register(patch, leaf.U + size, leaf.V + size);
+            Register(patch, leaf.U,        leaf.V + size);
+        }
+    }
+
+    // The registered corners strictly between two points of a line, in increasing order of the parameter,
+    // where the line is u = c if uline is true, and v = c otherwise
+    auto Between = [&](unsigned int patch, bool uline, unsigned int c, unsigned int first, unsigned int last,
+                       std::vector<unsigned int>& points) {
+        points.clear();
+        std::set<unsigned int> const* registered = nullptr;
+        bool reversed = false;
+        if ((c == 0) || (c == N)) {
+            PatchEdge const& edge = edges[patch][(uline ? 0 : 2) + ((c == 0) ? 0 : 1)];
+            if (edge.shared < 0) return;
+            registered = &edgepoints[edge.shared];
+            reversed   = edge.reversed;
+        }
+        else {
+            std::map<unsigned int, std::set<unsigned int>> const& lines = uline ? ulines[patch] : vlines[patch];
+            auto line = lines.find(c);
+            if (line == lines.end()) return;
+            registered = &line->second;
+        }
+        if (!reversed) {
+            for (auto p = registered->upper_bound(first); (p != registered->end()) && (*p < last); ++p) {
+                points.push_back(*p);
+            }
+        }
+        else {
+            for (auto p = registered->upper_bound(N - last); (p != registered->end()) && (*p < N - first); ++p) {
+                points.push_back(N - *p);
+            }
+            std::reverse(points.begin(), points.end());
+        }
+    };
+
+    // The vertex and normal of a corner, where a corner on the border is evaluated on the shared edge,
+    // and a corner on a collapsed edge is the point which the edge is collapsed to
+    auto Vertex = [&](unsigned int patch, unsigned int U, unsigned int V) {
+        int e = -1;
+        unsigned int t = 0;
+        if      (U == 0) { e = 0; t = V; }
+        else if (U == N) { e = 1; t = V; }
+        else if (V == 0) { e = 2; t = U; }
+        else if (V == N) { e = 3; t = U; }
+        if (e >= 0) {
+            PatchEdge const& edge = edges[patch][e];
+            if (edge.shared < 0) return edge.P[0];
+            glm::vec4 B = Bernstein(float(edge.reversed ? N - t : t) / float(N));
+            return B[0] * edge.P[0] + B[1] * edge.P[1] + B[2] * edge.P[2] + B[3] * edge.P[3];
+        }
+        BezierPatch const& G = this->BezierPatches[patch];
+        glm::vec4 Bu = Bernstein(float(U) / float(N));
+        glm::vec4 Bv = Bernstein(float(V) / float(N));
+        glm::vec3 vertex(0.0f);
+        for (int i = 0; i < 4; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                vertex += (Bu[i] * Bv[j]) * G[i + 1][j + 1];
+            }
+        }
+        return vertex;
+    };
+    auto Normal = [&](unsigned int patch, float u, float v) {
+        BezierPatch const& G = this->BezierPatches[patch];
+        glm::vec3 normal = PatchNormal(G, u, v);
+        bool onedge = ((u == 0.0f) && (edges[patch][0].shared < 0)) || ((u == 1.0f) && (edges[patch][1].shared < 0))
+                   || ((v == 0.0f) && (edges[patch][2].shared < 0)) || ((v == 1.0f) && (edges[patch][3].shared < 0));
+        if (onedge || (normal == glm::vec3(0.0f))) {
+            normal = LimitNormal(G, u, v);
+        }
+        return normal;
+    };
+
+    // Each leaf is written as two triangles, unless finer leaves have inserted corners into its border,
+    // in which case it is written as a fan of triangles around its center. The patches are written concurrently.
+    std::vector<std::vector<glm::vec3>> patchvertices(npatches);
+    std::vector<std::vector<glm::vec3>> patchnormals(npatches);
+    ParallelFor(0, npatches, [&](std::size_t firstpatch, std::size_t lastpatch) {
+        std::vector<unsigned int> points;
+        std::vector<glm::uvec2>   border;
+        for (unsigned int patch = firstpatch; patch < lastpatch; ++patch) {
+            std::vector<glm::vec3>& vertices = patchvertices[patch];
+            std::vector<glm::vec3>& normals  = patchnormals[patch];
+            for (Leaf const& leaf : leaves[patch]) {
+                unsigned int size = N >> leaf.level;
+                unsigned int U0 = leaf.U;
+                unsigned int V0 = leaf.V;
+                unsigned int U1 = leaf.U + size;
+                unsigned int V1 = leaf.V + size;
+
+                // The border of the leaf counterclockwise in the parameter plane, starting at the lower left corner
+                border.clear();
+                border.push_back(glm::uvec2(U0, V0));
+                Between(patch, false, V0, U0, U1, points);
+                for (unsigned int U : points) border.push_back(glm::uvec2(U, V0));
+                border.push_back(glm::uvec2(U1, V0));
+                Between(patch, true, U1, V0, V1, points);
+                for (unsigned int V : points) border.push_back(glm::uvec2(U1, V));
+                border.push_back(glm::uvec2(U1, V1));
+                Between(patch, false, V1, U0, U1, points);
+                for (auto U = points.rbegin(); U != points.rend(); ++U) border.push_back(glm::uvec2(*U, V1));
+                border.push_back(glm::uvec2(U0, V1));
+                Between(patch, true, U0, V0, V1, points);
+                for (auto V = points.rbegin(); V != points.rend(); ++V) border.push_back(glm::uvec2(U0, *V));
+
+                std::vector<glm::vec3> bordervertices(border.size());
+                std::vector<glm::vec3> bordernormals(border.size());
+                for (unsigned int k = 0; k < border.size(); ++k) {
+                    bordervertices[k] = Vertex(patch, border[k].x, border[k].y);
+                    bordernormals[k]  = Normal(patch, float(border[k].x) / float(N), float(border[k].y) / float(N));
+                }
+
+                if (border.size() == 4) {
+                    std::size_t offset = vertices.size();
+                    vertices.resize(offset + 6);
+                    normals.resize(offset + 6);
+                    glm::vec3* vertex = vertices.data() + offset;
+                    glm::vec3* normal = normals.data()  + offset;
+                    this->write_quadrilateral(bordervertices[0], bordervertices[1],
+                                              bordervertices[2], bordervertices[3],
+                                              bordernormals[0], bordernormals[1],
+                                              bordernormals[2], bordernormals[3],
+                                              vertex, normal);
+                    continue;
+                }
+
+                float uc = (float(U0) + 0.5f * float(size)) / float(N);
+                float vc = (float(V0) + 0.5f * float(size)) / float(N);
+                BezierPatch const& G = this->BezierPatches[patch];
+                glm::vec4 Bu = Bernstein(uc);
+                glm::vec4 Bv = Bernstein(vc);
+                glm::vec3 center(0.0f);
+                for (int i = 0; i < 4; ++i) {
+                    for (int j = 0; j < 4; ++j) {
+                        center += (Bu[i] * Bv[j]) * G[i + 1][j + 1];
+                    }
+                }
+                glm::vec3 centernormal = Normal(patch, uc, vc);
+
+                float sign = this->frontfacing ? 1.0f : -1.0f;
+                for (unsigned int k = 0; k < border.size(); ++k) {
+                    unsigned int first  = this->frontfacing ? k : (k + 1) % border.size();
+                    unsigned int second = this->frontfacing ? (k + 1) % border.size() : k;
+                    vertices.push_back(center);                 normals.push_back(sign * centernormal);
+                    vertices.push_back(bordervertices[first]);  normals.push_back(sign * bordernormals[first]);
+                    vertices.push_back(bordervertices[second]); normals.push_back(sign * bordernormals[second]);
+                }
+            }
+        }
+    });
+
+    // Collect the triangles of the patches
+    std::size_t nvertices = 0;
+    for (unsigned int patch = 0; patch < npatches; ++patch) {
+        nvertices += patchvertices[patch].size();
+    }
+    this->vertices.clear();
+    this->normals.clear();
+    this->vertices.reserve(nvertices);
+    this->normals.reserve(nvertices);
+    for (unsigned int patch = 0; patch < npatches; ++patch) {
+        this->vertices.insert(this->vertices.end(), patchvertices[patch].begin(), patchvertices[patch].end());
+        this->normals.insert(this->normals.end(), patchnormals[patch].begin(), patchnormals[patch].end());
+    }
+}
+
+/*
+ * Subdivides a BezierPatch until its leaves are flat on the screen, and appends the leaves.
+ * \param G - the bezierpatch which should be subdivided.
+ * \param level - the number of times the original patch has been subdivided to obtain G.
+ * \param U - the smallest u of G in units of 2^-NumberOfSubdivisions().
+ * \param V - the smallest v of G in units of 2^-NumberOfSubdivisions().
+ * \param leaves - the leaves of the original patch, the leaves of G are appended.
+ * \param tests - the culling tests which are needed for the sub-patches, see cull_bezierpatch(...).
+ */
+void BezierSurface::adapt_bezierpatch(BezierPatch const& G, int level, unsigned int U, unsigned int V,
+                                      std::vector<Leaf>& leaves, int tests) const
+{
+    if ((level < this->nsubdivisions) && (this->projected_flatness(G) > this->pixeltolerance)) {
+        unsigned int half = (1u << this->nsubdivisions) >> (level + 1);
+        BezierPatch G_L = glm::transpose(DBL) * G;
+        BezierPatch G_R = glm::transpose(DBR) * G;
+        BezierPatch subpatches[4] = { G_L * DBL, G_L * DBR, G_R * DBL, G_R * DBR };
+        unsigned int subU[4] = { U, U, U + half, U + half };
+        unsigned int subV[4] = { V, V + half, V, V + half };
+        for (int k = 0; k < 4; ++k) {
+            int subtests = 0;
+            if (tests != 0) {
+                subtests = this->cull_bezierpatch(bezierpatch_bounds(subpatches[k]), tests);
+                if (subtests < 0) continue;
+            }
+            this->adapt_bezierpatch(subpatches[k], level + 1, subU[k], subV[k], leaves, subtests);
+        }
+        return;
+    }
+    leaves.push_back(Leaf{level, U, V});
+}
+
+/*
+ * The projected flatness error of a BezierPatch.
+ * \param G - the bezierpatch.
+ * \return the largest distance in pixels between the projected control points and the bilinear interpolation
+ * of the projected corners, or the largest float if a control point is behind the camera.
+ */
+float BezierSurface::projected_flatness(BezierPatch const& G) const
+{
+    glm::vec2 screen[4][4];
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            glm::vec4 projected = this->adaptivetransformation * glm::vec4(G[i + 1][j + 1], 1.0f);
+            if (projected.w <= 0.0f) {
+                return std::numeric_limits<float>::max();
+            }
+            screen[i][j] = this->halfscreensize * glm::vec2(projected.x / projected.w, projected.y / projected.w);
+        }
+    }
+
+    float error = 0.0f;
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            float s = i / 3.0f;
+            float t = j / 3.0f;
+            glm::vec2 bilinear = (1.0f - s) * ((1.0f - t) * screen[0][0] + t * screen[0][3])
+                               + s          * ((1.0f - t) * screen[3][0] + t * screen[3][3]);
+            error = std::max(error, glm::length(screen[i][j] - bilinear));
+        }
+    }
+    return error;
+}
+
+/*
+ * Computes the bounding box and the normal cone of a BezierPatch from its control points.
+ * \param G - the bezierpatch.
+ * \return the bounds of the patch.
+ */
+BezierSurface::Bounds BezierSurface::bezierpatch_bounds(BezierPatch const& G)
+{
+    Bounds bounds;
+    bounds.boxmin = G[1][1];
+    bounds.boxmax = G[1][1];
+    for (int i = 1; i <= 4; ++i) {
+        for (int j = 1; j <= 4; ++j) {
+            bounds.boxmin = glm::min(bounds.boxmin, G[i][j]);
+            bounds.boxmax = glm::max(bounds.boxmax, G[i][j]);
+        }
+    }
+
+    // S_u and S_v are positive combinations of the differences of the control points along u and v,
+    // so S_u x S_v is a positive combination of the cross products of those differences
+    glm::vec3 du[3][4];
+    glm::vec3 dv[4][3];
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            du[j][i] = G[j + 2][i + 1] - G[j + 1][i + 1];
+            dv[i][j] = G[i + 1][j + 2] - G[i + 1][j + 1];
+        }
+    }
+    glm::vec3 crossproducts[144];
+    int ncrossproducts = 0;
+    glm::vec3 sum(0.0f);
+    for (int a = 0; a < 12; ++a) {
+        for (int b = 0; b < 12; ++b) {
+            glm::vec3 crossproduct = glm::cross(du[a / 4][a % 4], dv[b / 3][b % 3]);
+            float length = glm::length(crossproduct);
+            if (length > 0.0f) {
+                crossproducts[ncrossproducts++] = crossproduct / length;
+                sum += crossproduct / length;
+            }
+        }
+    }
+
+    bounds.axis  = glm::vec3(0.0f);
+    bounds.angle = float(M_PI);
+    float length = glm::length(sum);
+    if (length > 0.0f) {
+        bounds.axis = sum / length;
+        float mincos = 1.0f;
+        for (int k = 0; k < ncrossproducts; ++k) {
+            mincos = std::min(mincos, glm::dot(bounds.axis, crossproducts[k]));
+        }
+        bounds.angle = std::acos(std::max(-1.0f, mincos));
+    }
+    return bounds;
+}
+
+/*
+ * Caches the bounds of the bezierpatches, unless they are already cached.
+ */
+void BezierSurface::ComputePatchBounds()
+{
+    if (this->patchbounds.size() == this->BezierPatches.size()) return;
+
+    this->patchbounds.resize(this->BezierPatches.size());
+    for (unsigned int patch = 0; patch < this->BezierPatches.size(); ++patch) {
+        this->patchbounds[patch] = bezierpatch_bounds(this->BezierPatches[patch]);
+    }
+}
+
+/*
+ * Tests the bounds of a patch against the culling view.
+ * \param bounds - the bounds of the patch.
+ * \param tests - the tests which are needed, i.e. the tests which were inconclusive for the parent patch.
+ * \return -1 if the patch is culled, else the tests which are still needed for its sub-patches.
+ */
+int BezierSurface::cull_bezierpatch(Bounds const& bounds, int tests) const
+{
+    if (tests & TestFrustum) {
+        // The patch is outside if all corners of its bounding box are outside the same clipping plane,
+        // and its sub-patches need no test if all corners are inside all clipping planes.
+        // The canonical view volume of the Camera is [-1, 1] x [-1, 1] x [-1, 0], so the front plane is z = 0.
+        int noutside[6] = { 0, 0, 0, 0, 0, 0 };
+        for (int corner = 0; corner < 8; ++corner) {
+            glm::vec4 point((corner & 1) ? bounds.boxmax.x : bounds.boxmin.x,
+                            (corner & 2) ? bounds.boxmax.y : bounds.boxmin.y,
+                            (corner & 4) ? bounds.boxmax.z : bounds.boxmin.z,
+                            1.0f);
+            glm::vec4 clip = this->cullingtransformation * point;
+            if (clip.x < -clip.w) ++noutside[0];
+            if (clip.x >  clip.w) ++noutside[1];
+            if (clip.y < -clip.w) ++noutside[2];
+            if (clip.y >  clip.w) ++noutside[3];
+            if (clip.z < -clip.w) ++noutside[4];
+            if (clip.z >  0.0f)   ++noutside[5];
+        }
+        bool inside = true;
+        for (int plane = 0; plane < 6; ++plane) {
+            if (noutside[plane] == 8) return -1;
+            if (noutside[plane] > 0) inside = false;
+        }
+        if (inside) tests &= ~TestFrustum;
+    }
+
+    if ((tests & TestBackface) && (bounds.angle < float(M_PI_2))) {
+        // The directions from the center of projection to the bounding sphere of the patch form a cone,
+        // and the patch faces away from the viewer if every normal makes an acute angle with every direction
+        glm::vec3 center = 0.5f * (bounds.boxmin + bounds.boxmax);
+        float radius     = 0.5f * glm::length(bounds.boxmax - bounds.boxmin);
+        glm::vec3 direction = this->eye.w * center - glm::vec3(this->eye);
+        float distance      = glm::length(direction);
+        if (distance > this->eye.w * radius) {
+            float spread = std::asin(this->eye.w * radius / distance);
+            float sign   = this->frontfacing ? 1.0f : -1.0f;
+            float angle  = std::acos(std::max(-1.0f, std::min(1.0f, sign * glm::dot(bounds.axis, direction) / distance)));
+            if (angle + bounds.angle + spread < float(M_PI_2)) return -1;
+            if ((float(M_PI) - angle) + bounds.angle + spread < float(M_PI_2)) tests &= ~TestBackface;
+        }
+    }
+    return tests;
+}
+
+/*
+ * Computes the sub-interval operators of a subdivision level, unless they are already computed.
+ * \param level - the number of subdivisions, i.e. the parameter interval is divided into 2^level sub-intervals.
+ */
+void BezierSurface::ComputeSubintervals(int level)
+{
+    unsigned int const nintervals = 1u << level;
+    if (this->subintervals.size() == nintervals) return;
+
+    // The recursive subdivision chooses the left or right half by the bits of the interval number,
+    // starting with the most significant bit, and each choice right-multiplies the patch by DBL or DBR
+    this->subintervals.resize(nintervals);
+    for (unsigned int interval = 0; interval < nintervals; ++interval) {
+        glm::mat4x4 D(1.0f);
+        for (int bit = level - 1; bit >= 0; --bit) {
+            D = D * (((interval >> bit) & 1u) ? DBR : DBL);
+        }
+        this->subintervals[interval] = D;
+    }
+}
+
+/*
+ * Subdivides a BezierPatch without recursion, where each leaf sub-patch is produced directly by the precomputed
+ * sub-interval operators.
+ * \param G - the bezierpatch which should be subdivided.
+ * \param vertices - the destination of the triangle vertices, on return it points past the written vertices.
+ * \param normals - the destination of the normals, on return it points past the written normals.
+ * \param tests - the culling tests which are needed for the leaves, see cull_bezierpatch(...).
+ */
+void BezierSurface::subdivide_bezierpatch(BezierPatch const& G, glm::vec3*& vertices, glm::vec3*& normals,
+                                          int tests) const
+{
+    // The row products D_i^T G are shared by the sub-patches of a row of sub-intervals.
+    // A row is itself a patch, so it is culled once, and its leaves are only tested if the row test is inconclusive
+    int const level = this->nsubdivisions;
+    unsigned int const nquads = 1u << (2 * level);
+    int const untested = -2;
+    std::vector<int> rowtests(std::size_t(1) << level, (tests != 0) ? untested : 0);
+    unsigned int row = ~0u;
+    BezierPatch G_row;
+    for (unsigned int q = 0; q < nquads; ++q) {
+        unsigned int i;
+        unsigned int j;
+        QuadIndex(q, level, i, j);
+        if (rowtests[i] == untested) {
+            rowtests[i] = this->cull_bezierpatch(bezierpatch_bounds(glm::transpose(this->subintervals[i]) * G), tests);
+        }
+        if (rowtests[i] < 0) continue;
+        if (i != row) {
+            row   = i;
+            G_row = glm::transpose(this->subintervals[i]) * G;
+        }
+        BezierPatch leaf = G_row * this->subintervals[j];
+        if ((rowtests[i] != 0) && (this->cull_bezierpatch(bezierpatch_bounds(leaf), rowtests[i]) < 0)) continue;
+        this->write_quadrilateral(leaf[1][1], leaf[4][1], leaf[4][4], leaf[1][4],
+                                  CornerNormal(leaf, 1, 1), CornerNormal(leaf, 4, 1),
+                                  CornerNormal(leaf, 4, 4), CornerNormal(leaf, 1, 4),
+                                  vertices, normals);
+    }
+}
+
+/*
+ * Computes the basis tables of the direct evaluation for a number of samples of each parameter.
+ * \param nsamples - the number of samples of u and of v, i.e. the parameters k / (nsamples - 1).
+ */
+void BezierSurface::ComputeBasis(unsigned int nsamples)
+{
+    if (this->basis.size() == 4 * nsamples) return;
+
+    this->basis.resize(4 * nsamples);
+    this->dbasis.resize(4 * nsamples);
+    for (unsigned int k = 0; k < nsamples; ++k) {
+        float t = float(k) / float(nsamples - 1);
+
+        // The rows T M and T' M, where T = [t^3, t^2, t, 1], are the Bernstein polynomials and their derivatives
+        glm::vec4 row  = glm::vec4(t * t * t, t * t, t, 1.0f) * M;
+        glm::vec4 drow = glm::vec4(3.0f * t * t, 2.0f * t, 1.0f, 0.0f) * M;
+        for (int i = 0; i < 4; ++i) {
+            this->basis[i * nsamples + k]  = row[i];
+            this->dbasis[i * nsamples + k] = drow[i];
+        }
+    }
+}
+
+/*
+ * Evaluates a BezierPatch at the grid of samples of the basis tables.
+ * \param G - the bezierpatch which should be evaluated.
+ * \param gridvertices - room for nsamples x nsamples points, on return the sample (u_a, v_b) is entry a * nsamples + b.
+ * \param gridnormals - room for nsamples x nsamples normals, on return the unit normals oriented as S_u x S_v.
+ */
+void BezierSurface::sample_bezierpatch(BezierPatch const& G, glm::vec3* gridvertices, glm::vec3* gridnormals) const
+{
+    unsigned int const nsamples = this->basis.size() / 4;
+    float const* B  = this->basis.data();
+    float const* dB = this->dbasis.data();
+
+    // The coordinates of the geometry matrix are separated, so each product below is a loop over the samples
+    float g[3][4][4];
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            for (int c = 0; c < 3; ++c) {
+                g[c][i][j] = G[i + 1][j + 1][c];
+            }
+        }
+    }
+
+    // H = G^T (U M)^T and dH = G^T (U' M)^T, i.e. for each column j of G and each u-sample k
+    std::vector<float> H(3 * 4 * nsamples);
+    std::vector<float> dH(3 * 4 * nsamples);
+    for (int c = 0; c < 3; ++c) {
+        for (int j = 0; j < 4; ++j) {
+            float* h  = &H[(c * 4 + j) * nsamples];
+            float* dh = &dH[(c * 4 + j) * nsamples];
+            for (unsigned int k = 0; k < nsamples; ++k) {
+                h[k]  = B[k]  * g[c][0][j] + B[nsamples + k]  * g[c][1][j]
+                      + B[2 * nsamples + k]  * g[c][2][j] + B[3 * nsamples + k]  * g[c][3][j];
+                dh[k] = dB[k] * g[c][0][j] + dB[nsamples + k] * g[c][1][j]
+                      + dB[2 * nsamples + k] * g[c][2][j] + dB[3 * nsamples + k] * g[c][3][j];
+            }
+        }
+    }
+
+    // S = (U M) G (V M)^T, S_u = (U' M) G (V M)^T, and S_v = (U M) G (V' M)^T on the grid of samples,
+    // where each row of the grid is a product of a 4-vector and the 4 x nsamples basis table
+    unsigned int const ngrid = nsamples * nsamples;
+    std::vector<float> S(3 * ngrid);
+    std::vector<float> Su(3 * ngrid);
+    std::vector<float> Sv(3 * ngrid);
+    for (int c = 0; c < 3; ++c) {
+        for (unsigned int a = 0; a < nsamples; ++a) {
+            float h0  = H[(c * 4 + 0) * nsamples + a];
+            float h1  = H[(c * 4 + 1) * nsamples + a];
+            float h2  = H[(c * 4 + 2) * nsamples + a];
+            float h3  = H[(c * 4 + 3) * nsamples + a];
+            float dh0 = dH[(c * 4 + 0) * nsamples + a];
+            float dh1 = dH[(c * 4 + 1) * nsamples + a];
+            float dh2 = dH[(c * 4 + 2) * nsamples + a];
+            float dh3 = dH[(c * 4 + 3) * nsamples + a];
+            float* s  = &S[c * ngrid + a * nsamples];
+            float* su = &Su[c * ngrid + a * nsamples];
+            float* sv = &Sv[c * ngrid + a * nsamples];
+            for (unsigned int b = 0; b < nsamples; ++b) {
+                s[b]  = h0  * B[b]  + h1  * B[nsamples + b]  + h2  * B[2 * nsamples + b]  + h3  * B[3 * nsamples + b];
+                su[b] = dh0 * B[b]  + dh1 * B[nsamples + b]  + dh2 * B[2 * nsamples + b]  + dh3 * B[3 * nsamples + b];
+                sv[b] = h0  * dB[b] + h1  * dB[nsamples + b] + h2  * dB[2 * nsamples + b] + h3  * dB[3 * nsamples + b];
+            }
+        }
+    }
+
+    // The normal vanishes on an edge which is collapsed to a point, e.g. at the poles of the teapot,
+    // and there it is replaced by the normal at a parameter slightly inside the patch, i.e. its limit.
+    // The collapsed edges are found from the control points, because the rounding errors of the products
+    // would otherwise give the normal an arbitrary direction.
+    bool collapsed[4];
+    CollapsedEdges(G, collapsed);
+
+    unsigned int const last = nsamples - 1;
+    for (unsigned int k = 0; k < ngrid; ++k) {
+        unsigned int a = k / nsamples;
+        unsigned int b = k % nsamples;
+        gridvertices[k] = glm::vec3(S[k], S[ngrid + k], S[2 * ngrid + k]);
+        glm::vec3 normal = glm::cross(glm::vec3(Su[k], Su[ngrid + k], Su[2 * ngrid + k]),
+                                      glm::vec3(Sv[k], Sv[ngrid + k], Sv[2 * ngrid + k]));
+        bool degenerate = ((a == 0) && collapsed[0]) || ((a == last) && collapsed[1])
+                       || ((b == 0) && collapsed[2]) || ((b == last) && collapsed[3])
+                       || (normal == glm::vec3(0.0f));
+        if (!degenerate) {
+            normal = glm::normalize(normal);
+        }
+        else {
+            normal = LimitNormal(G, float(a) / float(last), float(b) / float(last));
+        }
+        gridnormals[k] = normal;
+    }
+}
+
+/*
+ * Tessellates a BezierPatch by evaluating it directly at the samples of the basis tables.
+ * \param G - the bezierpatch which should be tessellated.
+ * \param vertices - the destination of the triangle vertices, on return it points past the written vertices.
+ * \param normals - the destination of the normals, on return it points past the written normals.
+ */
+void BezierSurface::evaluate_bezierpatch(BezierPatch const& G, glm::vec3*& vertices, glm::vec3*& normals) const
+{
+    unsigned int const nsamples = this->basis.size() / 4;
+    std::vector<glm::vec3> gridvertices(nsamples * nsamples);
+    std::vector<glm::vec3> gridnormals(nsamples * nsamples);
+    this->sample_bezierpatch(G, gridvertices.data(), gridnormals.data());
+
+    // The quadrilaterals are written in the same order as the recursive subdivision writes them
+    int const level = this->nsubdivisions;
+    unsigned int const nquads = 1u << (2 * level);
+    for (unsigned int q = 0; q < nquads; ++q) {
+        unsigned int i;
+        unsigned int j;
+        QuadIndex(q, level, i, j);
+        unsigned int lower_left  = i       * nsamples + j;
+        unsigned int lower_right = (i + 1) * nsamples + j;
+        unsigned int upper_right = (i + 1) * nsamples + j + 1;
+        unsigned int upper_left  = i       * nsamples + j + 1;
+        this->write_quadrilateral(gridvertices[lower_left], gridvertices[lower_right],
+                                  gridvertices[upper_right], gridvertices[upper_left],
+                                  gridnormals[lower_left], gridnormals[lower_right],
+                                  gridnormals[upper_right], gridnormals[upper_left],
+                                  vertices, normals);
+    }
+}
+
+/*
+ * Writes the two triangles of a quadrilateral with the orientation given by FrontFacing().
+ * \param lower_left - the vertex at the smallest u and v.
+ * \param lower_right - the vertex at the largest u and the smallest v.
+ * \param upper_right - the vertex at the largest u and v.
+ * \param upper_left - the vertex at the smallest u and the largest v.
+ * \param normal_lower_left - the unit normal of lower_left, oriented as S_u x S_v.
+ * \param normal_lower_right - the unit normal of lower_right.
+ * \param normal_upper_right - the unit normal of upper_right.
+ * \param normal_upper_left - the unit normal of upper_left.
+ * \param vertices - the destination of the 6 triangle vertices, on return it points past the written vertices.
+ * \param normals - the destination of the 6 normals, on return it points past the written normals.
+ */
+void BezierSurface::write_quadrilateral(glm::vec3 const& lower_left,  glm::vec3 const& lower_right,
+                                        glm::vec3 const& upper_right, glm::vec3 const& upper_left,
+                                        glm::vec3 const& normal_lower_left,  glm::vec3 const& normal_lower_right,
+                                        glm::vec3 const& normal_upper_right, glm::vec3 const& normal_upper_left,
+                                        glm::vec3*& vertices, glm::vec3*& normals) const
+{
+    if (this->frontfacing) {
+        *vertices++ = lower_left;  *normals++ = normal_lower_left;
+        *vertices++ = upper_right; *normals++ = normal_upper_right;
+        *vertices++ = upper_left;  *normals++ = normal_upper_left;
+
+        *vertices++ = upper_right; *normals++ = normal_upper_right;
+        *vertices++ = lower_left;  *normals++ = normal_lower_left;
+        *vertices++ = lower_right; *normals++ = normal_lower_right;
+    }
+    else {
+        *vertices++ = upper_right; *normals++ = -normal_upper_right;
+        *vertices++ = lower_left;  *normals++ = -normal_lower_left;
+        *vertices++ = upper_left;  *normals++ = -normal_upper_left;
+
+        *vertices++ = lower_left;  *normals++ = -normal_lower_left;
+        *vertices++ = upper_right; *normals++ = -normal_upper_right;
+        *vertices++ = lower_right; *normals++ = -normal_lower_right;
+    }
+}
+
+/*
+ * Numbers the control points of the patches, where equal control points get the same number,
+ * for a surface whose patches are not read from a data file.
+ */
+void BezierSurface::ComputeControlPointIndices()
+{
+    std::map<std::array<float, 3>, int> numbers;
+    this->controlpointindices.clear();
+    for (BezierPatch const& G : this->BezierPatches) {
+        for (int i = 1; i <= 4; ++i) {
+            for (int j = 1; j <= 4; ++j) {
+                std::array<float, 3> controlpoint = { G[i][j].x, G[i][j].y, G[i][j].z };
+                auto number = numbers.emplace(controlpoint, int(numbers.size()) + 1).first;
+                this->controlpointindices.push_back(number->second);
+            }
+        }
+    }
+}
+
+/*
+ * Computes the indexed mesh, see IndexedVertices(), IndexedNormals(), and Indices().
+ */
+void BezierSurface::indexed_tessellation()
+{
+    unsigned int const n        = 1u << this->nsubdivisions;
+    unsigned int const nsamples = n + 1;
+    unsigned int const ngrid    = nsamples * nsamples;
+    unsigned int const npatches = this->BezierPatches.size();
+    this->ComputeBasis(nsamples);
+    if (this->controlpointindices.size() != 16 * std::size_t(npatches)) {
+        this->ComputeControlPointIndices();
+    }
+
+    // Number the vertices of the grid of each patch. A corner is shared by the patches which have the same control
+    // point there, and the samples inside an edge are shared by the patches which have the same 4 control points
+    // along it in either direction. The samples of an edge which is collapsed to one control point are its corner.
+    std::vector<unsigned int> gridindices(std::size_t(npatches) * ngrid);
+    std::map<int, unsigned int> corners;
+    std::map<std::array<int, 4>, unsigned int> edges;
+    unsigned int nvertices = 0;
+    auto Corner = [&corners, &nvertices](int controlpoint) {
+        auto corner = corners.find(controlpoint);
+        if (corner == corners.end()) {
+            corner = corners.emplace(controlpoint, nvertices++).first;
+        }
+        return corner->second;
+    };
+
+    // The control points and the first grid sample and the step between the samples of the edges
+    // u = 0, u = 1, v = 0, and v = 1
+    int const edgecontrolpoints[4][4] = { {0, 1, 2, 3}, {12, 13, 14, 15}, {0, 4, 8, 12}, {3, 7, 11, 15} };
+    unsigned int const edgefirst[4] = { 0, n * nsamples, 0, n };
+    unsigned int const edgestep[4]  = { 1, 1, nsamples, nsamples };
+
+    for (unsigned int patch = 0; patch < npatches; ++patch) {
+        int const* controlpoints = &this->controlpointindices[16 * patch];
+        unsigned int* gridindex = &gridindices[std::size_t(patch) * ngrid];
+
+        for (unsigned int a = 1; a < n; ++a) {
+            for (unsigned int b = 1; b < n; ++b) {
+                gridindex[a * nsamples + b] = nvertices++;
+            }
+        }
+
+        gridindex[0]                = Corner(controlpoints[0]);
+        gridindex[n]                = Corner(controlpoints[3]);
+        gridindex[n * nsamples]     = Corner(controlpoints[12]);
+        gridindex[n * nsamples + n] = Corner(controlpoints[15]);
+
+        for (int edge = 0; edge < 4; ++edge) {
+            std::array<int, 4> key;
+            for (int k = 0; k < 4; ++k) {
+                key[k] = controlpoints[edgecontrolpoints[edge][k]];
+            }
+            bool collapsed = (key[0] == key[1]) && (key[0] == key[2]) && (key[0] == key[3]);
+            bool reversed  = (key[3] < key[0]) || ((key[3] == key[0]) && (key[2] < key[1]));
+            if (reversed) {
+                std::reverse(key.begin(), key.end());
+            }
+            unsigned int first = 0;
+            if (!collapsed) {
+                auto shared = edges.find(key);
+                if (shared == edges.end()) {
+                    shared = edges.emplace(key, nvertices).first;
+                    nvertices += n - 1;
+                }
+                first = shared->second;
+            }
+            for (unsigned int k = 1; k < n; ++k) {
+                unsigned int& index = gridindex[edgefirst[edge] + k * edgestep[edge]];
+                if (collapsed) {
+                    index = Corner(key[0]);
+                }
+                else {
+                    index = first + (reversed ? n - k : k) - 1;
+                }
+            }
+        }
+    }
+
+    // Evaluate the patches on their grids
+    std::vector<glm::vec3> gridvertices(std::size_t(npatches) * ngrid);
+    std::vector<glm::vec3> gridnormals(std::size_t(npatches) * ngrid);
+    ParallelFor(0, npatches, [&](std::size_t firstpatch, std::size_t lastpatch) {
+        for (unsigned int patch = firstpatch; patch < lastpatch; ++patch) {
+            this->sample_bezierpatch(this->BezierPatches[patch], gridvertices.data() + std::size_t(patch) * ngrid,
+                                     gridnormals.data() + std::size_t(patch) * ngrid);
+        }
+    });
+
+    // A shared vertex takes its position from the first patch which has it, so all patches use the same position,
+    // and its normal is the average of the normals of the patches, except normals which point the opposite way
+    std::vector<bool> written(nvertices, false);
+    this->indexedvertices.assign(nvertices, glm::vec3(0.0f));
+    this->indexednormals.assign(nvertices, glm::vec3(0.0f));
+    for (std::size_t k = 0; k < gridindices.size(); ++k) {
+        unsigned int index = gridindices[k];
+        if (!written[index]) {
+            this->indexedvertices[index] = gridvertices[k];
+            this->indexednormals[index]  = gridnormals[k];
+            written[index] = true;
+        }
+        else if (glm::dot(this->indexednormals[index], gridnormals[k]) >= 0.0f) {
+            this->indexednormals[index] += gridnormals[k];
+        }
+    }
+    for (glm::vec3& normal : this->indexednormals) {
+        if (normal != glm::vec3(0.0f)) {
+            normal = glm::normalize(normal);
+        }
+        if (!this->frontfacing) {
+            normal = -normal;
+        }
+    }
+
+    // The triangles have the orientation of write_quadrilateral(...)
+    this->indices.clear();
+    this->indices.reserve(6 * std::size_t(npatches) * n * n);
+    auto Triangle = [this](unsigned int a, unsigned int b, unsigned int c) {
+        if ((a != b) && (b != c) && (c != a)) {
+            this->indices.push_back(a);
+            this->indices.push_back(b);
+            this->indices.push_back(c);
+        }
+    };
+    for (unsigned int patch = 0; patch < npatches; ++patch) {
+        unsigned int const* gridindex = &gridindices[std::size_t(patch) * ngrid];
+        for (unsigned int i = 0; i < n; ++i) {
+            for (unsigned int j = 0; j < n; ++j) {
+                unsigned int lower_left  = gridindex[i       * nsamples + j];
+                unsigned int lower_right = gridindex[(i + 1) * nsamples + j];
+                unsigned int upper_right = gridindex[(i + 1) * nsamples + j + 1];
+                unsigned int upper_left  = gridindex[i       * nsamples + j + 1];
+                if (this->frontfacing) {
+                    Triangle(lower_left, upper_right, upper_left);
+                    Triangle(upper_right, lower_left, lower_right);
+                }
+                else {
+                    Triangle(upper_right, lower_left, upper_left);
+                    Triangle(lower_left, upper_right, lower_right);
+                }
+            }
+        }
+    }
+    this->IndexedOK = true;
 }
 
 /*
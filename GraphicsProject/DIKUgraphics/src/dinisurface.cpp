@@ -1,5 +1,6 @@
 #include "traceinfo.h"
 #include "dinisurface.h"
+#include "vectormath.h"
 
 
 /**
@@ -85,6 +86,106 @@ glm::vec3 DiniSurface::Normal(float u, float v) const
     return normal;
 }
 
+/*
+ * Computes the points and the normals of the Dini surface at a batch of parameters.
+ * \param u - the values of the u-parameter, the height angle.
+ * \param v - the values of the v-parameter, the azimuth angle.
+ * \param count - the number of pairs of parameters.
+ * \param vertices - the destination of the count points on the surface.
+ * \param normals - the destination of the count normals of the surface.
+ */
+void DiniSurface::EvaluateBatch(float const* u, float const* v, unsigned int count,
+                                glm::vec3* vertices, glm::vec3* normals) const
+{
+    std::vector<float> halfv(count);
+    for (unsigned int k = 0; k < count; ++k) {
+        halfv[k] = 0.5f * v[k];
+    }
+
+    std::vector<float> sinphi(count),   cosphi(count);
+    std::vector<float> sintheta(count), costheta(count);
+    std::vector<float> sinhalf(count),  coshalf(count);
+    SinCos(u, count, sinphi.data(), cosphi.data());
+    SinCos(v, count, sintheta.data(), costheta.data());
+    SinCos(halfv.data(), count, sinhalf.data(), coshalf.data());
+
+    for (unsigned int k = 0; k < count; ++k) {
+        vertices[k] = glm::vec3(this->a * cosphi[k] * sintheta[k],
+                                this->a * sinphi[k] * sintheta[k],
+                                this->a * (costheta[k] + std::log(sinhalf[k] / coshalf[k])) + this->b * u[k]);
+
+        glm::vec3 Dphi(-this->a * sinphi[k] * sintheta[k],
+                       this->a * cosphi[k] * sintheta[k],
+                       this->b);
+        glm::vec3 Dtheta(this->a * cosphi[k] * costheta[k],
+                         this->a * sinphi[k] * costheta[k],
+                         0.5f / (sinhalf[k] * coshalf[k]) - sintheta[k]);
+        glm::vec3 normal = glm::cross(Dphi, Dtheta);
+
+        if (normal != glm::vec3(0.0f)) {
+            normal = glm::normalize(normal);
+        }
+        normals[k] = normal;
+    }
+}
+
+/*
+ * Computes the points and the normals of the Dini surface at each pair of parameters (u_i, v_j).
+ * The factors which only depend on theta, including the logarithm, are computed once per v-value.
+ * \param u - the values of the u-parameter, the height angle.
+ * \param nu - the number of u-values.
+ * \param v - the values of the v-parameter, the azimuth angle.
+ * \param nv - the number of v-values.
+ * \param vertices - the destination of the nu * nv points on the surface.
+ * \param normals - the destination of the nu * nv normals of the surface.
+ */
+void DiniSurface::EvaluateGridBatch(float const* u, unsigned int nu, float const* v, unsigned int nv,
+                                    glm::vec3* vertices, glm::vec3* normals) const
+{
+    std::vector<float> halfv(nv);
+    for (unsigned int j = 0; j < nv; ++j) {
+        halfv[j] = 0.5f * v[j];
+    }
+
+    std::vector<float> sinphi(nu),   cosphi(nu);
+    std::vector<float> sintheta(nv), costheta(nv);
+    std::vector<float> sinhalf(nv),  coshalf(nv);
+    SinCos(u, nu, sinphi.data(), cosphi.data());
+    SinCos(v, nv, sintheta.data(), costheta.data());
+    SinCos(halfv.data(), nv, sinhalf.data(), coshalf.data());
+
+    // The z-coordinates of the point and of the partial derivative wrt. theta only depend on theta
+    std::vector<float> dini_z(nv);
+    std::vector<float> Ddini_Dtheta_z(nv);
+    for (unsigned int j = 0; j < nv; ++j) {
+        dini_z[j]         = this->a * (costheta[j] + std::log(sinhalf[j] / coshalf[j]));
+        Ddini_Dtheta_z[j] = 0.5f / (sinhalf[j] * coshalf[j]) - sintheta[j];
+    }
+
+    for (unsigned int i = 0; i < nu; ++i) {
+        glm::vec3* linevertices = vertices + i * nv;
+        glm::vec3* linenormals  = normals  + i * nv;
+        for (unsigned int j = 0; j < nv; ++j) {
+            linevertices[j] = glm::vec3(this->a * cosphi[i] * sintheta[j],
+                                        this->a * sinphi[i] * sintheta[j],
+                                        dini_z[j] + this->b * u[i]);
+
+            glm::vec3 Dphi(-this->a * sinphi[i] * sintheta[j],
+                           this->a * cosphi[i] * sintheta[j],
+                           this->b);
+            glm::vec3 Dtheta(this->a * cosphi[i] * costheta[j],
+                             this->a * sinphi[i] * costheta[j],
+                             Ddini_Dtheta_z[j]);
+            glm::vec3 normal = glm::cross(Dphi, Dtheta);
+
+            if (normal != glm::vec3(0.0f)) {
+                normal = glm::normalize(normal);
+            }
+            linenormals[j] = normal;
+        }
+    }
+}
+
 // Protected member functions
 
 // Private member functions
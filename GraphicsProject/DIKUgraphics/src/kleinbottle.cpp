@@ -1,4 +1,5 @@
 #include "kleinbottle.h"
+#include "vectormath.h"
 
 
 /*
@@ -7,7 +8,9 @@
  */
 KleinTop::KleinTop()
         : ParametricSurface(0.0f, 2.0f * glm::pi<float>(), 20, 0.0f, glm::pi<float>(), 20, true, false)
-{}
+{
+    this->Periodic(true, false);
+}
 
 /*
  * Creates an instance of the top part of the Klein Bottle with
@@ -19,7 +22,9 @@ KleinTop::KleinTop()
  */
 KleinTop::KleinTop(int M, int N, bool frontfacing, bool debug)
         :  ParametricSurface(0.0f, 2.0f * glm::pi<float>(), M, 0.0f, glm::pi<float>(), N, frontfacing, debug)
-{}
+{
+    this->Periodic(true, false);
+}
     
 /*
  * Computes a point on the surface.
@@ -47,6 +52,65 @@ glm::vec3 KleinTop::Normal(float u, float v) const
                      (2.0f + glm::cos(u)) * glm::cos(u) * glm::sin(v));
 }
 
+/*
+ * Computes the points and the normals of the surface at a batch of parameters.
+ * \param u - the values of the u-parameter.
+ * \param v - the values of the v-parameter.
+ * \param count - the number of pairs of parameters.
+ * \param vertices - the destination of the count points on the surface.
+ * \param normals - the destination of the count normals of the surface.
+ */
+void KleinTop::EvaluateBatch(float const* u, float const* v, unsigned int count,
+                             glm::vec3* vertices, glm::vec3* normals) const
+{
+    std::vector<float> sinu(count), cosu(count);
+    std::vector<float> sinv(count), cosv(count);
+    SinCos(u, count, sinu.data(), cosu.data());
+    SinCos(v, count, sinv.data(), cosv.data());
+
+    for (unsigned int k = 0; k < count; ++k) {
+        float r = 2.0f + cosu[k];
+        vertices[k] = glm::vec3(2.0f + r * cosv[k],
+                                sinu[k],
+                                3.0f * glm::pi<float>() + r * sinv[k]);
+        normals[k]  = glm::vec3(r * cosu[k] * cosv[k],
+                                r * sinu[k],
+                                r * cosu[k] * sinv[k]);
+    }
+}
+
+/*
+ * Computes the points and the normals of the surface at each pair of parameters (u_i, v_j).
+ * \param u - the values of the u-parameter.
+ * \param nu - the number of u-values.
+ * \param v - the values of the v-parameter.
+ * \param nv - the number of v-values.
+ * \param vertices - the destination of the nu * nv points on the surface.
+ * \param normals - the destination of the nu * nv normals of the surface.
+ */
+void KleinTop::EvaluateGridBatch(float const* u, unsigned int nu, float const* v, unsigned int nv,
+                                 glm::vec3* vertices, glm::vec3* normals) const
+{
+    std::vector<float> sinu(nu), cosu(nu);
+    std::vector<float> sinv(nv), cosv(nv);
+    SinCos(u, nu, sinu.data(), cosu.data());
+    SinCos(v, nv, sinv.data(), cosv.data());
+
+    for (unsigned int i = 0; i < nu; ++i) {
+        float r = 2.0f + cosu[i];
+        glm::vec3* linevertices = vertices + i * nv;
+        glm::vec3* linenormals  = normals  + i * nv;
+        for (unsigned int j = 0; j < nv; ++j) {
+            linevertices[j] = glm::vec3(2.0f + r * cosv[j],
+                                        sinu[i],
+                                        3.0f * glm::pi<float>() + r * sinv[j]);
+            linenormals[j]  = glm::vec3(r * cosu[i] * cosv[j],
+                                        r * sinu[i],
+                                        r * cosu[i] * sinv[j]);
+        }
+    }
+}
+
 
 /*
  * \class KleinBottom
@@ -59,7 +123,9 @@ glm::vec3 KleinTop::Normal(float u, float v) const
   */
 KleinBottom::KleinBottom()
            : ParametricSurface(0.0f, 2.0f * glm::pi<float>(), 20, 0.0f, glm::pi<float>(), 20, true, false)
-{}
+{
+    this->Periodic(true, false);
+}
 
 /*
  * Creates an instance of the bottom part of the Klein Bottle with
@@ -71,7 +137,9 @@ KleinBottom::KleinBottom()
  */
 KleinBottom::KleinBottom(int M, int N, bool frontfacing, bool debug)
            : ParametricSurface(0.0f, 2.0f * glm::pi<float>(), M, 0.0f, glm::pi<float>(), N, frontfacing, debug)
-{}
+{
+    this->Periodic(true, false);
+}
 
 /*
  * Computes a point on the surface.
@@ -99,6 +167,67 @@ glm::vec3 KleinBottom::Normal(float u, float v) const
                      ( 3.75f + 2.25f * glm::cos(v)) * glm::sin(v));
 }
 
+/*
+ * Computes the points and the normals of the surface at a batch of parameters.
+ * \param u - the values of the u-parameter.
+ * \param v - the values of the v-parameter.
+ * \param count - the number of pairs of parameters.
+ * \param vertices - the destination of the count points on the surface.
+ * \param normals - the destination of the count normals of the surface.
+ */
+void KleinBottom::EvaluateBatch(float const* u, float const* v, unsigned int count,
+                                glm::vec3* vertices, glm::vec3* normals) const
+{
+    std::vector<float> sinu(count), cosu(count);
+    std::vector<float> sinv(count), cosv(count);
+    SinCos(u, count, sinu.data(), cosu.data());
+    SinCos(v, count, sinv.data(), cosv.data());
+
+    for (unsigned int k = 0; k < count; ++k) {
+        float r = 2.5f + 1.5f * cosv[k];
+        float n = (-6.25f - 3.75f * cosv[k]) * cosv[k];
+        vertices[k] = glm::vec3(r * cosu[k],
+                                r * sinu[k],
+                                -2.5f * sinv[k]);
+        normals[k]  = glm::vec3(n * cosu[k],
+                                n * sinu[k],
+                                (3.75f + 2.25f * cosv[k]) * sinv[k]);
+    }
+}
+
+/*
+ * Computes the points and the normals of the surface at each pair of parameters (u_i, v_j).
+ * \param u - the values of the u-parameter.
+ * \param nu - the number of u-values.
+ * \param v - the values of the v-parameter.
+ * \param nv - the number of v-values.
+ * \param vertices - the destination of the nu * nv points on the surface.
+ * \param normals - the destination of the nu * nv normals of the surface.
+ */
+void KleinBottom::EvaluateGridBatch(float const* u, unsigned int nu, float const* v, unsigned int nv,
+                                    glm::vec3* vertices, glm::vec3* normals) const
+{
+    std::vector<float> sinu(nu), cosu(nu);
+    std::vector<float> sinv(nv), cosv(nv);
+    SinCos(u, nu, sinu.data(), cosu.data());
+    SinCos(v, nv, sinv.data(), cosv.data());
+
+    for (unsigned int i = 0; i < nu; ++i) {
+        glm::vec3* linevertices = vertices + i * nv;
+        glm::vec3* linenormals  = normals  + i * nv;
+        for (unsigned int j = 0; j < nv; ++j) {
+            float r = 2.5f + 1.5f * cosv[j];
+            float n = (-6.25f - 3.75f * cosv[j]) * cosv[j];
+            linevertices[j] = glm::vec3(r * cosu[i],
+                                        r * sinu[i],
+                                        -2.5f * sinv[j]);
+            linenormals[j]  = glm::vec3(n * cosu[i],
+                                        n * sinu[i],
+                                        (3.75f + 2.25f * cosv[j]) * sinv[j]);
+        }
+    }
+}
+
 
 /*
  * \class KleinHandle
@@ -111,7 +240,9 @@ glm::vec3 KleinBottom::Normal(float u, float v) const
  */
 KleinHandle::KleinHandle()
            : ParametricSurface(0.0f, 2.0f * glm::pi<float>(), 20, 0.0f, glm::pi<float>(), 20, true, false)
-{}
+{
+    this->Periodic(true, false);
+}
 
 /*
  * Creates an instance of the handle part of the Klein Bottle with
@@ -123,7 +254,9 @@ KleinHandle::KleinHandle()
  */
 KleinHandle::KleinHandle(int M, int N, bool frontfacing, bool debug)
            : ParametricSurface(0.0f, 2.0f * glm::pi<float>(), M, 0.0f, glm::pi<float>(), N, frontfacing, debug)
-{}
+{
+    this->Periodic(true, false);
+}
 
 /*
  * Computes a point on the surface.
@@ -151,6 +284,63 @@ glm::vec3 KleinHandle::Normal(float u, float v) const
                      2.0f * glm::sin(u) * glm::sin(v));
 }
 
+/*
+ * Computes the points and the normals of the surface at a batch of parameters.
+ * \param u - the values of the u-parameter.
+ * \param v - the values of the v-parameter.
+ * \param count - the number of pairs of parameters.
+ * \param vertices - the destination of the count points on the surface.
+ * \param normals - the destination of the count normals of the surface.
+ */
+void KleinHandle::EvaluateBatch(float const* u, float const* v, unsigned int count,
+                                glm::vec3* vertices, glm::vec3* normals) const
+{
+    std::vector<float> sinu(count), cosu(count);
+    std::vector<float> sinv(count), cosv(count);
+    SinCos(u, count, sinu.data(), cosu.data());
+    SinCos(v, count, sinv.data(), cosv.data());
+
+    for (unsigned int k = 0; k < count; ++k) {
+        vertices[k] = glm::vec3(2.0f - 2.0f * cosv[k] + sinu[k],
+                                cosu[k],
+                                3.0f * v[k]);
+        normals[k]  = glm::vec3(-3.0f * sinu[k],
+                                -3.0f * cosu[k],
+                                2.0f * sinu[k] * sinv[k]);
+    }
+}
+
+/*
+ * Computes the points and the normals of the surface at each pair of parameters (u_i, v_j).
+ * \param u - the values of the u-parameter.
+ * \param nu - the number of u-values.
+ * \param v - the values of the v-parameter.
+ * \param nv - the number of v-values.
+ * \param vertices - the destination of the nu * nv points on the surface.
+ * \param normals - the destination of the nu * nv normals of the surface.
+ */
+void KleinHandle::EvaluateGridBatch(float const* u, unsigned int nu, float const* v, unsigned int nv,
+                                    glm::vec3* vertices, glm::vec3* normals) const
+{
+    std::vector<float> sinu(nu), cosu(nu);
+    std::vector<float> sinv(nv), cosv(nv);
+    SinCos(u, nu, sinu.data(), cosu.data());
+    SinCos(v, nv, sinv.data(), cosv.data());
+
+    for (unsigned int i = 0; i < nu; ++i) {
+        glm::vec3* linevertices = vertices + i * nv;
+        glm::vec3* linenormals  = normals  + i * nv;
+        for (unsigned int j = 0; j < nv; ++j) {
+            linevertices[j] = glm::vec3(2.0f - 2.0f * cosv[j] + sinu[i],
+                                        cosu[i],
+                                        3.0f * v[j]);
+            linenormals[j]  = glm::vec3(-3.0f * sinu[i],
+                                        -3.0f * cosu[i],
+                                        2.0f * sinu[i] * sinv[j]);
+        }
+    }
+}
+
 /*
  * \class KleinMiddle
  * implements a surface which is the middle part of the surface.
@@ -162,7 +352,9 @@ glm::vec3 KleinHandle::Normal(float u, float v) const
  */
 KleinMiddle::KleinMiddle()
            : ParametricSurface(0.0f, 2.0f * glm::pi<float>(), 20, 0.0f, glm::pi<float>(), 20, true, false)
-{}
+{
+    this->Periodic(true, false);
+}
 
 /*
  * Creates an instance of the handle part of the Klein Bottle with
@@ -174,7 +366,9 @@ KleinMiddle::KleinMiddle()
  */
 KleinMiddle::KleinMiddle(int M, int N, bool frontfacing, bool debug)
            : ParametricSurface(0.0f, 2.0f * glm::pi<float>(), M, 0.0f, glm::pi<float>(), N, frontfacing, debug)
-{}
+{
+    this->Periodic(true, false);
+}
 
 /*
  * Computes a point on the surface.
@@ -202,6 +396,67 @@ glm::vec3 KleinMiddle::Normal(float u, float v) const
                      (3.75f + 2.25f * glm::cos(v)) * glm::sin(v));
 }
 
+/*
+ * Computes the points and the normals of the surface at a batch of parameters.
+ * \param u - the values of the u-parameter.
+ * \param v - the values of the v-parameter.
+ * \param count - the number of pairs of parameters.
+ * \param vertices - the destination of the count points on the surface.
+ * \param normals - the destination of the count normals of the surface.
+ */
+void KleinMiddle::EvaluateBatch(float const* u, float const* v, unsigned int count,
+                                glm::vec3* vertices, glm::vec3* normals) const
+{
+    std::vector<float> sinu(count), cosu(count);
+    std::vector<float> sinv(count), cosv(count);
+    SinCos(u, count, sinu.data(), cosu.data());
+    SinCos(v, count, sinv.data(), cosv.data());
+
+    for (unsigned int k = 0; k < count; ++k) {
+        float r = 2.5f + 1.5f * cosv[k];
+        float n = 7.5f + 4.5f * cosv[k];
+        vertices[k] = glm::vec3(r * cosu[k],
+                                r * sinu[k],
+                                3.0f * v[k]);
+        normals[k]  = glm::vec3(n * cosu[k],
+                                n * sinu[k],
+                                (3.75f + 2.25f * cosv[k]) * sinv[k]);
+    }
+}
+
+/*
+ * Computes the points and the normals of the surface at each pair of parameters (u_i, v_j).
+ * \param u - the values of the u-parameter.
+ * \param nu - the number of u-values.
+ * \param v - the values of the v-parameter.
+ * \param nv - the number of v-values.
+ * \param vertices - the destination of the nu * nv points on the surface.
+ * \param normals - the destination of the nu * nv normals of the surface.
+ */
+void KleinMiddle::EvaluateGridBatch(float const* u, unsigned int nu, float const* v, unsigned int nv,
+                                    glm::vec3* vertices, glm::vec3* normals) const
+{
+    std::vector<float> sinu(nu), cosu(nu);
+    std::vector<float> sinv(nv), cosv(nv);
+    SinCos(u, nu, sinu.data(), cosu.data());
+    SinCos(v, nv, sinv.data(), cosv.data());
+
+    for (unsigned int i = 0; i < nu; ++i) {
+        glm::vec3* linevertices = vertices + i * nv;
+        glm::vec3* linenormals  = normals  + i * nv;
+        for (unsigned int j = 0; j < nv; ++j) {
+            float r = 2.5f + 1.5f * cosv[j];
+            float n = 7.5f + 4.5f * cosv[j];
+            linevertices[j] = glm::vec3(r * cosu[i],
+                                        r * sinu[i],
+                                        3.0f * v[j]);
+            linenormals[j]  = glm::vec3(n * cosu[i],
+                                        n * sinu[i],
+                                        (3.75f + 2.25f * cosv[j]) * sinv[j]);
+        }
+    }
+}
+
 /*
  * \class KleinBottle
  * Implements a Klein Bottle, i.e. a surface with only one side.
@@ -245,8 +500,9 @@ KleinBottle::KleinBottle(int M, int N, bool frontfacing, bool debug)
  */
 KleinBottle::KleinBottle(KleinBottle const& Src)
            : M(Src.M), N(Src.N), validVertices(Src.validVertices), validNormals(Src.validNormals),
-             kleintop(Src.kleintop), kleinbottom(Src.kleinbottom), kleinhandle(Src.kleinhandle), kleinmiddle(Src.kleinmiddle),
-             vertices(Src.vertices), normals(Src.normals)
+             kleintop(new KleinTop(*Src.kleintop)), kleinbottom(new KleinBottom(*Src.kleinbottom)),
+             kleinhandle(new KleinHandle(*Src.kleinhandle)), kleinmiddle(new KleinMiddle(*Src.kleinmiddle)),
+             vertices(Src.vertices), normals(Src.normals), drawranges(Src.drawranges)
 {
     Trace("KleinBottle", "KleinBottle(KleinBottle const&)");
 }
@@ -278,12 +534,13 @@ KleinBottle& KleinBottle::operator=(KleinBottle const& Src)
         this->N = Src.N;
         this->validVertices = Src.validVertices;
         this->validNormals  = Src.validNormals;
-        this->kleintop      = Src.kleintop;
-        this->kleinbottom   = Src.kleinbottom;
-        this->kleinhandle   = Src.kleinhandle;
-        this->kleinmiddle   = Src.kleinmiddle;
+        *this->kleintop     = *Src.kleintop;
+        *this->kleinbottom  = *Src.kleinbottom;
+        *this->kleinhandle  = *Src.kleinhandle;
+        *this->kleinmiddle  = *Src.kleinmiddle;
         this->vertices           = Src.vertices;
         this->normals            = Src.normals;
+        this->drawranges         = Src.drawranges;
     }
     return *this;
 }
@@ -307,6 +564,7 @@ void KleinBottle::Usamples(int M)
 {
     Trace("KleinBottle", "Usamples(int)");
 
+    this->M = M;
     this->kleintop->ParametricSurface::Usamples(M);
     this->kleinbottom->ParametricSurface::Usamples(M);
     this->kleinhandle->ParametricSurface::Usamples(M);
@@ -335,10 +593,11 @@ void KleinBottle::Vsamples(int N)
 {
     Trace("KleinBottle", "Vsamples(int)");
 
+    this->N = N;
     this->kleintop->ParametricSurface::Vsamples(N);
-    this->kleinbottom->ParametricSurface::Usamples(N);
-    this->kleinhandle->ParametricSurface::Usamples(N);
-    this->kleinmiddle->ParametricSurface::Usamples(N);
+    this->kleinbottom->ParametricSurface::Vsamples(N);
+    this->kleinhandle->ParametricSurface::Vsamples(N);
+    this->kleinmiddle->ParametricSurface::Vsamples(N);
     
     this->validVertices = false;
     this->validNormals  = false;
@@ -356,10 +615,7 @@ std::vector<glm::vec3> const& KleinBottle::Vertices()
     Trace("KleinBottle", "Vertices()");
 
     if (!this->validVertices) {
-        this->vertices.insert(vertices.end(), this->kleintop->Vertices().begin(),    this->kleintop->Vertices().end());
-        this->vertices.insert(vertices.end(), this->kleinbottom->Vertices().begin(), this->kleinbottom->Vertices().end());
-        this->vertices.insert(vertices.end(), this->kleinhandle->Vertices().begin(), this->kleinhandle->Vertices().end());
-        this->vertices.insert(vertices.end(), this->kleinmiddle->Vertices().begin(), this->kleinmiddle->Vertices().end());
+        this->Compose();
     }
     return vertices;
 }
@@ -376,11 +632,84 @@ std::vector<glm::vec3> const& KleinBottle::Normals()
     Trace("KleinBottle", "Normals()");
 
     if (!this->validNormals) {
-        this->normals.insert(this->normals.end(),  this->kleintop->Normals().begin(),    this->kleintop->Normals().end());
-        this->vertices.insert(this->normals.end(), this->kleinbottom->Normals().begin(), this->kleinbottom->Normals().end());
-        this->vertices.insert(this->normals.end(), this->kleinhandle->Normals().begin(), this->kleinhandle->Normals().end());
-        this->vertices.insert(this->normals.end(), this->kleinmiddle->Normals().begin(), this->kleinmiddle->Normals().end());
+        this->Compose();
     }
     return normals;
 }
 
+/*
+ * The parts of the Klein Bottle as named ranges of Vertices() and Normals().
+ * \return the ranges of the "top", "bottom", "handle", and "middle" parts in this order.
+ */
+std::vector<DrawRange> const& KleinBottle::DrawRanges()
+{
+    Trace("KleinBottle", "DrawRanges()");
+
+    if (!this->validVertices || !this->validNormals) {
+        this->Compose();
+    }
+    return this->drawranges;
+}
+
+/*
+ * Adds the four parts and the seams between them to a seam welder.
+ * \param welder - the seam welder.
+ */
+void KleinBottle::AddParts(SeamWelder& welder)
+{
+    Trace("KleinBottle", "AddParts(SeamWelder&)");
+
+    unsigned int top    = welder.AddPart(*this->kleintop);
+    unsigned int bottom = welder.AddPart(*this->kleinbottom);
+    unsigned int handle = welder.AddPart(*this->kleinhandle);
+    unsigned int middle = welder.AddPart(*this->kleinmiddle);
+
+    // Each part is closed in the u-direction
+    welder.AddSeam(top,    SeamWelder::UMIN, top,    SeamWelder::UMAX);
+    welder.AddSeam(bottom, SeamWelder::UMIN, bottom, SeamWelder::UMAX);
+    welder.AddSeam(handle, SeamWelder::UMIN, handle, SeamWelder::UMAX);
+    welder.AddSeam(middle, SeamWelder::UMIN, middle, SeamWelder::UMAX);
+
+    // The v-boundaries are circles. The bottom and the middle start at the same point, the other circles
+    // start a quarter or a half turn apart, and they run in opposite directions. The Klein Bottle has only one
+    // side, so the normals of the top and the handle are opposite, and that seam is left open by the welder.
+    welder.AddSeam(bottom, SeamWelder::VMIN, middle, SeamWelder::VMIN);
+    welder.AddSeam(top,    SeamWelder::VMIN, handle, SeamWelder::VMAX, true, 0.25f);
+    welder.AddSeam(top,    SeamWelder::VMAX, middle, SeamWelder::VMAX, true, 0.5f);
+    welder.AddSeam(bottom, SeamWelder::VMAX, handle, SeamWelder::VMIN, true, 0.25f);
+}
+
+/*
+ * Samples the four parts one after another, each with the threads of its own ParallelFor,
+ * and gathers their triangle vertices and normals directly into disjoint ranges of the composite vertices and normals.
+ */
+void KleinBottle::Compose()
+{
+    Trace("KleinBottle", "Compose()");
+
+    ParametricSurface* parts[4] = {this->kleintop, this->kleinbottom, this->kleinhandle, this->kleinmiddle};
+    char const*        names[4] = {"top", "bottom", "handle", "middle"};
+
+    // The parts are sampled one at a time, because a ParallelFor over the parts would run the ParallelFor
+    // of each part sequentially, i.e. use at most four threads, and the largest part would bound the time
+    this->drawranges.clear();
+    unsigned int total = 0;
+    for (unsigned int p = 0; p < 4; ++p) {
+        unsigned int count = parts[p]->NumberOfVertices();
+        this->drawranges.push_back(DrawRange{names[p], total, count});
+        total += count;
+    }
+
+    // Each part writes its triangle vertices directly into its own range, so the parts never store a triangle soup
+    this->vertices.resize(total);
+    this->normals.resize(total);
+    for (unsigned int p = 0; p < 4; ++p) {
+        parts[p]->WriteVertices(this->vertices.data() + this->drawranges[p].first,
+                                this->normals.data()  + this->drawranges[p].first);
+    }
+
+    // The vertices and normals are always composed together
+    this->validVertices = true;
+    this->validNormals  = true;
+}
+
@@ -0,0 +1,322 @@
+#include <limits>
+
+#include "levelofdetail.h"
+
+/**
+ * \class LevelOfDetail
+ * A chain of precomputed resolutions of a surface, i.e. M x N, M/2 x N/2, M/4 x N/4, etc.
+ */
+
+/*
+ * Precomputes the levels of a parametric surface.
+ * \param surface - the surface, its current numbers of samples M and N define level 0.
+ * \param nlevels - the number of levels.
+ */
+LevelOfDetail::LevelOfDetail(ParametricSurface& surface, unsigned int nlevels)
+             : finestsize(0.5f), hysteresis(0.1f), selectedlevel(0)
+{
+    Trace("LevelOfDetail", "LevelOfDetail(ParametricSurface&, unsigned int)");
+
+    if (nlevels == 0) {
+        throw std::invalid_argument("LevelOfDetail::LevelOfDetail(ParametricSurface&, unsigned int): nlevels must be > 0");
+    }
+
+    int M = surface.Usamples();
+    int N = surface.Vsamples();
+    for (unsigned int k = 0; k < nlevels; ++k) {
+        Level level;
+        level.M = std::max(M >> k, 1);
+        level.N = std::max(N >> k, 1);
+
+        surface.Usamples(level.M);
+        surface.Vsamples(level.N);
+        level.vertices = surface.GridVertices();
+        level.normals  = surface.GridNormals();
+        level.indices  = surface.Indices();
+        this->levels.push_back(level);
+    }
+    surface.Usamples(M);
+    surface.Vsamples(N);
+
+    this->ComputeBoundingBox();
+}
+
+/*
+ * Precomputes the levels of a Klein Bottle.
+ * \param kleinbottle - the Klein Bottle, its current numbers of samples M and N define level 0.
+ * \param nlevels - the number of levels.
+ */
+LevelOfDetail::LevelOfDetail(KleinBottle& kleinbottle, unsigned int nlevels)
+             : finestsize(0.5f), hysteresis(0.1f), selectedlevel(0)
+{
+    Trace("LevelOfDetail", "LevelOfDetail(KleinBottle&, unsigned int)");
+
+    if (nlevels == 0) {
+        throw std::invalid_argument("LevelOfDetail::LevelOfDetail(KleinBottle&, unsigned int): nlevels must be > 0");
+    }
+
+    int M = kleinbottle.Usamples();
+    int N = kleinbottle.Vsamples();
+    for (unsigned int k = 0; k < nlevels; ++k) {
+        Level level;
+        level.M = std::max(M >> k, 1);
+        level.N = std::max(N >> k, 1);
+
+        kleinbottle.Usamples(level.M);
+        kleinbottle.Vsamples(level.N);
+        level.vertices = kleinbottle.Vertices();
+        level.normals  = kleinbottle.Normals();
+        this->levels.push_back(level);
+    }
+    kleinbottle.Usamples(M);
+    kleinbottle.Vsamples(N);
+
+    this->ComputeBoundingBox();
+}
+
+/*
+ * Destroys the current instance of the level of detail chain.
+ */
+LevelOfDetail::~LevelOfDetail()
+{
+    Trace("LevelOfDetail", "~LevelOfDetail()");
+}
+
+/*
+ * The number of levels.
+ * \return the number of levels.
+ */
+unsigned int LevelOfDetail::NumberOfLevels() const
+{
+    return this->levels.size();
+}
+
+/*
+ * The number of samples in the u-direction of a level.
+ * \param level - the level, 0 <= level < NumberOfLevels().
+ * \return the number of u-samples of the level.
+ */
+unsigned int LevelOfDetail::Usamples(unsigned int level) const
+{
+    return this->CheckLevel(level).M;
+}
+
+/*
+ * The number of samples in the v-direction of a level.
+ * \param level - the level, 0 <= level < NumberOfLevels().
+ * \return the number of v-samples of the level.
+ */
+unsigned int LevelOfDetail::Vsamples(unsigned int level) const
+{
+    return this->CheckLevel(level).N;
+}
+
+/*
+ * The vertices of a level.
+ * \param level - the level, 0 <= level < NumberOfLevels().
+ * \return the vertices of the level.
+ */
+std::vector<glm::vec3> const& LevelOfDetail::Vertices(unsigned int level) const
+{
+    return this->CheckLevel(level).vertices;
+}
+
+/*
+ * The normals of a level.
+ * \param level - the level, 0 <= level < NumberOfLevels().
+ * \return the normals of the vertices returned by Vertices(level).
+ */
+std::vector<glm::vec3> const& LevelOfDetail::Normals(unsigned int level) const
+{
+    return this->CheckLevel(level).normals;
+}
+
+/*
+ * The indices of the triangles of a level.
+ * \param level - the level, 0 <= level < NumberOfLevels().
+ * \return the indices into Vertices(level) and Normals(level), or an empty vector if the level is a triangle soup.
+ */
+std::vector<unsigned int> const& LevelOfDetail::Indices(unsigned int level) const
+{
+    return this->CheckLevel(level).indices;
+}
+
+/*
+ * The number of triangles of a level.
+ * \param level - the level, 0 <= level < NumberOfLevels().
+ * \return the number of triangles.
+ */
+unsigned int LevelOfDetail::NumberOfTriangles(unsigned int level) const
+{
+    Level const& data = this->CheckLevel(level);
+    return (data.indices.empty() ? data.vertices.size() : data.indices.size()) / 3;
+}
+
+/*
+ * The memory used by the vertices, normals, and indices of a level.
+ * \param level - the level, 0 <= level < NumberOfLevels().
+ * \return the number of bytes.
+ */
+std::size_t LevelOfDetail::MemoryUsage(unsigned int level) const
+{
+    Level const& data = this->CheckLevel(level);
+    return data.vertices.size() * sizeof(glm::vec3)
+         + data.normals.size()  * sizeof(glm::vec3)
+         + data.indices.size()  * sizeof(unsigned int);
+}
+
+/*
+ * Writes the resolution, the number of triangles, and the memory usage of each level to a stream.
+ * \param s - the stream which the statistics should be written to.
+ */
+void LevelOfDetail::Statistics(std::ostream& s) const
+{
+    std::size_t total = 0;
+    for (unsigned int k = 0; k < this->levels.size(); ++k) {
+        total += this->MemoryUsage(k);
+        s << "Level " << k << ": " << std::setw(4) << this->levels[k].M << " x " << std::setw(4) << this->levels[k].N
+          << ", " << std::setw(8) << this->NumberOfTriangles(k) << " triangles, "
+          << std::setw(10) << this->MemoryUsage(k) << " bytes" << std::endl;
+    }
+    s << "Total: " << total << " bytes" << std::endl;
+}
+
+/*
+ * The bounding box of the finest level.
+ * \param boxmin - on return the lower corner of the bounding box.
+ * \param boxmax - on return the upper corner of the bounding box.
+ */
+void LevelOfDetail::BoundingBox(glm::vec3& boxmin, glm::vec3& boxmax) const
+{
+    boxmin = this->boxmin;
+    boxmax = this->boxmax;
+}
+
+/*
+ * The projected size above which the finest level is selected.
+ * \return the projected size of the finest level.
+ */
+float LevelOfDetail::FinestSize() const
+{
+    return this->finestsize;
+}
+
+/*
+ * Changes the projected size above which the finest level is selected.
+ * \param finestsize - the new projected size of the finest level, a fraction of the viewport.
+ */
+void LevelOfDetail::FinestSize(float finestsize)
+{
+    if (finestsize <= 0.0f) {
+        throw std::invalid_argument("LevelOfDetail::FinestSize(float): finestsize must be > 0");
+    }
+    this->finestsize = finestsize;
+}
+
+/*
+ * The hysteresis of the level selection.
+ * \return the hysteresis.
+ */
+float LevelOfDetail::Hysteresis() const
+{
+    return this->hysteresis;
+}
+
+/*
+ * Changes the hysteresis of the level selection.
+ * \param hysteresis - the new hysteresis, 0 <= hysteresis < 1.
+ */
+void LevelOfDetail::Hysteresis(float hysteresis)
+{
+    if ((hysteresis < 0.0f) || (hysteresis >= 1.0f)) {
+        throw std::invalid_argument("LevelOfDetail::Hysteresis(float): hysteresis must be in [0, 1)");
+    }
+    this->hysteresis = hysteresis;
+}
+
+/*
+ * The size of the surface on the screen as a fraction of the viewport.
+ * \param camera - the camera which views the surface.
+ * \param model - the transformation from model coordinates to world coordinates.
+ * \return the projected size, a very large value if a part of the bounding box is behind the camera.
+ */
+float LevelOfDetail::ProjectedSize(Camera const& camera, glm::mat4x4 const& model) const
+{
+    glm::mat4x4 transformation = camera.ViewProjection() * camera.ViewOrientation() * model;
+
+    // Project the corners of the bounding box to normalized device coordinates, where the viewport is [-1, 1] x [-1, 1]
+    glm::vec2 ndcmin( std::numeric_limits<float>::max());
+    glm::vec2 ndcmax(-std::numeric_limits<float>::max());
+    for (int corner = 0; corner < 8; ++corner) {
+        glm::vec4 point((corner & 1) ? this->boxmax.x : this->boxmin.x,
+                        (corner & 2) ? this->boxmax.y : this->boxmin.y,
+                        (corner & 4) ? this->boxmax.z : this->boxmin.z,
+                        1.0f);
+        glm::vec4 projected = transformation * point;
+        if (projected.w <= 0.0f) {
+            return std::numeric_limits<float>::max();
+        }
+        glm::vec2 ndc(projected.x / projected.w, projected.y / projected.w);
+        ndcmin = glm::min(ndcmin, ndc);
+        ndcmax = glm::max(ndcmax, ndc);
+    }
+    glm::vec2 extent = 0.5f * (ndcmax - ndcmin);
+    return std::max(extent.x, extent.y);
+}
+
+/*
+ * Selects the level which should be drawn according to the projected size and the hysteresis.
+ * \param camera - the camera which views the surface.
+ * \param model - the transformation from model coordinates to world coordinates.
+ * \return the selected level.
+ */
+unsigned int LevelOfDetail::SelectLevel(Camera const& camera, glm::mat4x4 const& model)
+{
+    float size = this->ProjectedSize(camera, model);
+
+    // Level k meets level k + 1 at the size finestsize / 2^(k + 1). The level only changes when the size is
+    // the fraction hysteresis beyond that size, and it may change by several levels in one call.
+    unsigned int coarsest = this->levels.size() - 1;
+    while ((this->selectedlevel < coarsest)
+           && (size < std::ldexp(this->finestsize, -int(this->selectedlevel + 1)) * (1.0f - this->hysteresis))) {
+        ++this->selectedlevel;
+    }
+    while ((this->selectedlevel > 0)
+           && (size > std::ldexp(this->finestsize, -int(this->selectedlevel)) * (1.0f + this->hysteresis))) {
+        --this->selectedlevel;
+    }
+    return this->selectedlevel;
+}
+
+/*
+ * The level which was selected by the last call of SelectLevel(...).
+ * \return the selected level, initially the finest level.
+ */
+unsigned int LevelOfDetail::SelectedLevel() const
+{
+    return this->selectedlevel;
+}
+
+// Private member functions
+
+/*
+ * Checks that a level exists.
+ * \param level - the level.
+ * \return the data of the level.
+ */
+LevelOfDetail::Level const& LevelOfDetail::CheckLevel(unsigned int level) const
+{
+    if (level >= this->levels.size()) {
+        throw std::out_of_range("LevelOfDetail: level out of range");
+    }
+    return this->levels[level];
+}
+
+/*
+ * Computes the bounding box of the finest level.
+ */
+void LevelOfDetail::ComputeBoundingBox()
+{
+    std::vector<glm::vec3> const& vertices = this->levels[0].vertices;
+    ::BoundingBox(vertices.data(), vertices.size(), this->boxmin, this->boxmax);
+}
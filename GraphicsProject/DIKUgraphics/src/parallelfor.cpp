@@ -0,0 +1,86 @@
+#include "parallelfor.h"
+
+/**
+ * \file parallelfor.cpp
+ */
+
+namespace {
+    // True while the current thread processes a block of a ParallelFor
+    thread_local bool insideparallelfor = false;
+}
+
+/*
+ * The number of threads used by ParallelFor.
+ * \return the number of hardware threads, at least 1.
+ */
+unsigned int NumberOfThreads()
+{
+    unsigned int nthreads = std::thread::hardware_concurrency();
+    return (nthreads > 0) ? nthreads : 1;
+}
+
+/*
+ * Splits the index range [begin, end) into contiguous blocks, and calls block(first, last) once for each block.
+ * \param begin - the first index of the range.
+ * \param end - one past the last index of the range.
+ * \param block - the function which processes the indices first <= index < last of one block.
+ * \param minblocksize - the minimum number of indices in a block.
+ */
+void ParallelFor(std::size_t begin, std::size_t end,
+                 std::function<void(std::size_t, std::size_t)> const& block,
+                 std::size_t minblocksize)
+{
+    if (end <= begin) return;
+
+    std::size_t count = end - begin;
+    if (minblocksize < 1) minblocksize = 1;
+
+    std::size_t nblocks = NumberOfThreads();
+    std::size_t maxblocks = (count + minblocksize - 1) / minblocksize;
+    if (nblocks > maxblocks) nblocks = maxblocks;
+
+    // A nested ParallelFor runs in the thread of its block, because the outer level already uses all threads
+    if (insideparallelfor) nblocks = 1;
+
+    if (nblocks <= 1) {
+        block(begin, end);
+        return;
+    }
+
+    // The first (count % nblocks) blocks get one extra index
+    std::size_t blocksize = count / nblocks;
+    std::size_t remainder = count % nblocks;
+
+    std::vector<std::exception_ptr> errors(nblocks);
+    std::vector<std::thread> threads;
+    threads.reserve(nblocks - 1);
+
+    std::size_t first = begin;
+    for (std::size_t b = 0; b < nblocks; ++b) {
+        std::size_t last = first + blocksize + ((b < remainder) ? 1 : 0);
+        auto work = [&block, &errors, b, first, last]() {
+            insideparallelfor = true;
+            try {
+                block(first, last);
+            }
+            catch (...) {
+                errors[b] = std::current_exception();
+            }
+            insideparallelfor = false;
+        };
+        if (b < nblocks - 1) {
+            threads.emplace_back(work);
+        }
+        else {
+            // The calling thread processes the last block itself
+            work();
+        }
+        first = last;
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (auto const& error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+}
@@ -1,4 +1,7 @@
+#include <unordered_map>
+
 #include "parametricsurface.h"
+#include "parallelfor.h"
 
 /**
  * \class ParametricSurface
@@ -29,7 +32,8 @@ ParametricSurface::ParametricSurface(float umin, float umax, int M,
                                      bool frontfacing, bool debug)
                  : M(M), N(N), umin(umin), umax(umax), vmin(vmin), vmax(vmax),
                    frontfacing(frontfacing), debug(debug),
-                   validdata(false)
+                   validdata(false), validgrid(false), validindices(false), gridsign(1.0f),
+                   tolerance(0.0f), maxlevel(0), maxdepth(0), periodicu(false), periodicv(false)
 {
     Trace("ParametricSurface", "ParametricSurface(float, float, int, float, float, int, bool, bool)");
 
@@ -38,6 +42,9 @@ ParametricSurface::ParametricSurface(float umin, float umax, int M,
     
     this->vertices.clear();
     this->normals.clear();
+    this->gridvertices.clear();
+    this->gridnormals.clear();
+    this->indices.clear();
 
     this->DataHasChanged(true);
 }
@@ -56,7 +63,20 @@ ParametricSurface::ParametricSurface(ParametricSurface const& newparamsurface)
                    debug(newparamsurface.debug),
                    validdata(false),
                    vertices(newparamsurface.vertices),
-                   normals(newparamsurface.normals)
+                   normals(newparamsurface.normals),
+                   validgrid(false),
+                   validindices(false),
+                   gridsign(newparamsurface.gridsign),
+                   gridvertices(newparamsurface.gridvertices),
+                   gridnormals(newparamsurface.gridnormals),
+                   indices(newparamsurface.indices),
+                   tolerance(newparamsurface.tolerance),
+                   maxlevel(newparamsurface.maxlevel),
+                   maxdepth(newparamsurface.maxdepth),
+                   periodicu(newparamsurface.periodicu),
+                   periodicv(newparamsurface.periodicv),
+                   adaptiveindices(newparamsurface.adaptiveindices),
+                   adaptivedebugindices(newparamsurface.adaptivedebugindices)
 {
     Trace("ParametricSurface", "ParametricSurface(ParametricSurface const&)");
 
@@ -95,6 +115,17 @@ ParametricSurface& ParametricSurface::operator=(ParametricSurface const& newpara
         this->validdata   = newparamsurface.validdata;
         this->vertices    = newparamsurface.vertices;
         this->normals     = newparamsurface.normals;
+        this->gridsign     = newparamsurface.gridsign;
+        this->gridvertices = newparamsurface.gridvertices;
+        this->gridnormals  = newparamsurface.gridnormals;
+        this->indices      = newparamsurface.indices;
+        this->tolerance       = newparamsurface.tolerance;
+        this->maxlevel        = newparamsurface.maxlevel;
+        this->maxdepth        = newparamsurface.maxdepth;
+        this->periodicu       = newparamsurface.periodicu;
+        this->periodicv       = newparamsurface.periodicv;
+        this->adaptiveindices      = newparamsurface.adaptiveindices;
+        this->adaptivedebugindices = newparamsurface.adaptivedebugindices;
         this->DataHasChanged(true);
     }
     return *this;
@@ -225,13 +256,15 @@ bool ParametricSurface::FrontFacing() const
 
 /*
  * Defines if the surface is front facing or not.
+ * The sampled grid is kept, only the normals are negated and the triangles are reversed.
  * \param frontfacing - true if the surface is front facing, else false.
  */
 void ParametricSurface::FrontFacing(bool frontfacing)
 {
     if (this->frontfacing != frontfacing) {
-        this->frontfacing = frontfacing;
-        this->DataHasChanged(true);
+        this->frontfacing  = frontfacing;
+        this->validindices = false;
+        this->validdata    = false;
     } 
 }
 
@@ -247,6 +280,7 @@ bool ParametricSurface::Debug() const
 /*
  * Cantrols which quadrilaterals should be shown.
  * It makes it easier to whatch the surface.
+ * The sampled grid is kept, only the triangles are regenerated.
  * \parm debug - if false all quadrilaterals are shown, 
  *               else only every other quadrilateral are shown.
  */
@@ -255,7 +289,96 @@ void ParametricSurface::Debug(bool debug)
     if (this->debug != debug) {
         // change the debug mode
         this->debug = debug;
-        this->DataHasChanged(true);
+        this->validindices = false;
+        this->validdata    = false;
+    }
+}
+
+/*
+ * The chordal error tolerance of the adaptive tessellation.
+ * \return the tolerance, or 0 if the surface is sampled on the uniform M x N grid.
+ */
+float ParametricSurface::Tolerance() const
+{
+    return this->tolerance;
+}
+
+/*
+ * Switches between the uniform and the curvature adaptive tessellation.
+ * \param tolerance - the maximal chordal error, or 0 to select the uniform grid.
+ * \param maxlevel - the maximal number of times a cell of the M x N grid is split, 0 <= maxlevel <= 12.
+ */
+void ParametricSurface::Adaptive(float tolerance, unsigned int maxlevel)
+{
+    Trace("ParametricSurface", "Adaptive(float, unsigned int)");
+
+    if (tolerance < 0.0f) {
+        throw std::invalid_argument("ParametricSurface::Adaptive(float, unsigned int): tolerance must be >= 0");
+    }
+    if (maxlevel > 12) {
+        throw std::invalid_argument("ParametricSurface::Adaptive(float, unsigned int): maxlevel must be in [0, 12]");
+    }
+    this->tolerance = tolerance;
+    this->maxlevel  = maxlevel;
+    this->DataHasChanged(true);
+}
+
+/*
+ * Reports if the surface is declared periodic in the u-parameter.
+ * \return true if the edges u = umin and u = umax coincide point by point, else false.
+ */
+bool ParametricSurface::PeriodicU() const
+{
+    return this->periodicu;
+}
+
+/*
+ * Reports if the surface is declared periodic in the v-parameter.
+ * \return true if the edges v = vmin and v = vmax coincide point by point, else false.
+ */
+bool ParametricSurface::PeriodicV() const
+{
+    return this->periodicv;
+}
+
+/*
+ * Declares which parameters are periodic. Only the adaptive tessellation is affected.
+ * \param periodicu - true if the surface is periodic in u, else false.
+ * \param periodicv - true if the surface is periodic in v, else false.
+ */
+void ParametricSurface::Periodic(bool periodicu, bool periodicv)
+{
+    Trace("ParametricSurface", "Periodic(bool, bool)");
+
+    if ((this->periodicu != periodicu) || (this->periodicv != periodicv)) {
+        this->periodicu = periodicu;
+        this->periodicv = periodicv;
+        if (this->tolerance > 0.0f) {
+            this->DataHasChanged(true);
+        }
+    }
+}
+
+/*
+ * Writes statistics of the tessellation to a stream.
+ * \param s - the stream which the statistics should be written to.
+ */
+void ParametricSurface::Statistics(std::ostream& s)
+{
+    Trace("ParametricSurface", "Statistics(std::ostream&)");
+
+    this->UpdateGrid();
+
+    unsigned int ntriangles = this->indices.size() / 3;
+    s << "Tessellation: " << ntriangles << " triangles, " << this->gridvertices.size() << " vertices" << std::endl;
+    if (this->tolerance > 0.0f) {
+        unsigned int scale = 1u << this->maxdepth;
+        unsigned long long coarse = 2ull * this->M * this->N;
+        unsigned long long fine   = coarse * scale * scale;
+        s << "    adaptive, tolerance " << this->tolerance << ", quadtree levels 0.." << this->maxdepth << std::endl;
+        s << "    uniform " << this->M << " x " << this->N << ": " << coarse << " triangles" << std::endl;
+        s << "    uniform " << this->M * scale << " x " << this->N * scale << ": " << fine << " triangles, "
+          << std::setprecision(3) << 100.0 * ntriangles / fine << "% of which are used" << std::endl;
     }
 }
 
@@ -287,10 +410,311 @@ std::vector<glm::vec3> const& ParametricSurface::Normals()
     return this->normals;
 }
 
+/*
+ * The coordinates of the vertices on the (M + 1) x (N + 1) parameter grid.
+ * Each grid point is stored once, and the triangles are defined by Indices().
+ * The grid point (u_i, v_j) is stored in entry i * (N + 1) + j.
+ * \return a vector containing the coordinates of the grid points.
+ */
+std::vector<glm::vec3> const& ParametricSurface::GridVertices()
+{
+    Trace("ParametricSurface", "GridVertices()");
+
+    this->UpdateGrid();
+    return this->gridvertices;
+}
+
+/*
+ * The coordinates of the normals on the (M + 1) x (N + 1) parameter grid.
+ * The normals are negated if the surface is not front facing.
+ * \return a vector containing the coordinates of the normals at the grid points.
+ */
+std::vector<glm::vec3> const& ParametricSurface::GridNormals()
+{
+    Trace("ParametricSurface", "GridNormals()");
+
+    this->UpdateGrid();
+    return this->gridnormals;
+}
+
+/*
+ * The indices into GridVertices() and GridNormals() of the triangle vertices.
+ * The first 3 entries define the first triangle, the next 3 entries define the second triangle etc.
+ * The triangles have the same order and orientation as those returned by Vertices().
+ * \return a vector containing the indices of the triangle vertices.
+ */
+std::vector<unsigned int> const& ParametricSurface::Indices()
+{
+    Trace("ParametricSurface", "Indices()");
+
+    this->UpdateGrid();
+    return this->indices;
+}
+
+/*
+ * The number of triangle vertices, i.e. the number of entries in Vertices() and Normals().
+ * \return the number of triangle vertices.
+ */
+unsigned int ParametricSurface::NumberOfVertices()
+{
+    Trace("ParametricSurface", "NumberOfVertices()");
+
+    this->UpdateGrid();
+    return this->indices.size();
+}
+
+/*
+ * Writes the triangle vertices and normals interleaved into a destination supplied by the caller.
+ * \param destination - room for 2 * NumberOfVertices() 3D vectors.
+ */
+void ParametricSurface::WriteInterleaved(glm::vec3* destination)
+{
+    Trace("ParametricSurface", "WriteInterleaved(glm::vec3*)");
+
+    this->UpdateGrid();
+    ParallelFor(0, this->indices.size(), [&](std::size_t first, std::size_t last) {
+        for (unsigned int k = first; k < last; ++k) {
+            destination[2 * k]     = this->gridvertices[this->indices[k]];
+            destination[2 * k + 1] = this->gridnormals[this->indices[k]];
+        }
+    }, 4096);
+}
+
+/*
+ * Writes the triangle vertices and normals into destinations supplied by the caller.
+ * \param vertices - room for NumberOfVertices() 3D vectors.
+ * \param normals - room for NumberOfVertices() 3D vectors.
+ */
+void ParametricSurface::WriteVertices(glm::vec3* vertices, glm::vec3* normals)
+{
+    Trace("ParametricSurface", "WriteVertices(glm::vec3*, glm::vec3*)");
+
+    this->UpdateGrid();
+
+    // Each triangle vertex is a copy of a grid point, so the vertices are gathered concurrently,
+    // and the result does not depend on the number of threads.
+    ParallelFor(0, this->indices.size(), [&](std::size_t first, std::size_t last) {
+        for (unsigned int k = first; k < last; ++k) {
+            vertices[k] = this->gridvertices[this->indices[k]];
+            normals[k]  = this->gridnormals[this->indices[k]];
+        }
+    }, 4096);
+}
+
+/*
+ * Writes the grid vertices and grid normals interleaved into a destination supplied by the caller.
+ * \param destination - room for 2 * GridVertices().size() 3D vectors.
+ */
+void ParametricSurface::WriteInterleavedGrid(glm::vec3* destination)
+{
+    Trace("ParametricSurface", "WriteInterleavedGrid(glm::vec3*)");
+
+    this->UpdateGrid();
+    ParallelFor(0, this->gridvertices.size(), [&](std::size_t first, std::size_t last) {
+        for (unsigned int k = first; k < last; ++k) {
+            destination[2 * k]     = this->gridvertices[k];
+            destination[2 * k + 1] = this->gridnormals[k];
+        }
+    }, 4096);
+}
+
+/*
+ * Computes the axis aligned bounding box of the surface.
+ * \param boxmin - on return the lower corner of the bounding box.
+ * \param boxmax - on return the upper corner of the bounding box.
+ */
+void ParametricSurface::BoundingBox(glm::vec3& boxmin, glm::vec3& boxmax)
+{
+    Trace("ParametricSurface", "BoundingBox(glm::vec3&, glm::vec3&)");
+
+    this->UpdateGrid();
+    ::BoundingBox(this->gridvertices.data(), this->gridvertices.size(), boxmin, boxmax);
+}
+
+/*
+ * Writes the triangle vertices and normals as quantized vertices into a destination supplied by the caller.
+ * \param destination - room for NumberOfVertices() quantized vertices.
+ */
+void ParametricSurface::WriteQuantized(QuantizedVertex* destination)
+{
+    Trace("ParametricSurface", "WriteQuantized(QuantizedVertex*)");
+
+    // Each grid vertex is shared by up to six triangles, so it is encoded once and gathered afterwards
+    std::vector<QuantizedVertex> quantizedgrid(this->GridVertices().size());
+    this->WriteQuantizedGrid(quantizedgrid.data());
+
+    ParallelFor(0, this->indices.size(), [&](std::size_t first, std::size_t last) {
+        for (unsigned int k = first; k < last; ++k) {
+            destination[k] = quantizedgrid[this->indices[k]];
+        }
+    }, 4096);
+}
+
+/*
+ * Writes the grid vertices and grid normals as quantized vertices into a destination supplied by the caller.
+ * \param destination - room for GridVertices().size() quantized vertices.
+ */
+void ParametricSurface::WriteQuantizedGrid(QuantizedVertex* destination)
+{
+    Trace("ParametricSurface", "WriteQuantizedGrid(QuantizedVertex*)");
+
+    glm::vec3 boxmin;
+    glm::vec3 boxmax;
+    this->BoundingBox(boxmin, boxmax);
+
+    ParallelFor(0, this->gridvertices.size(), [&](std::size_t first, std::size_t last) {
+        EncodeVertices(&this->gridvertices[first], &this->gridnormals[first], last - first,
+                       boxmin, boxmax, &destination[first]);
+    }, 4096);
+}
+
+/*
+ * The number of tiles which the uniform M x N parameter grid is split into by Tile(...).
+ * \param tilesize - the maximal number of grid cells in each direction of a tile.
+ * \return the number of tiles.
+ */
+unsigned int ParametricSurface::NumberOfTiles(unsigned int tilesize) const
+{
+    if (tilesize == 0) {
+        throw std::invalid_argument("ParametricSurface::NumberOfTiles(unsigned int): tilesize must be > 0");
+    }
+    unsigned int ntiles_u = (this->M + tilesize - 1) / tilesize;
+    unsigned int ntiles_v = (this->N + tilesize - 1) / tilesize;
+    return ntiles_u * ntiles_v;
+}
+
+/*
+ * Evaluates one tile of the uniform M x N parameter grid, without storing the whole surface.
+ * \param tile - the number of the tile, 0 <= tile < NumberOfTiles(tilesize).
+ * \param tilesize - the maximal number of grid cells in each direction of a tile.
+ * \param destination - the tile, its vectors are reused.
+ */
+void ParametricSurface::Tile(unsigned int tile, unsigned int tilesize, SurfaceTile& destination) const
+{
+    Trace("ParametricSurface", "Tile(unsigned int, unsigned int, SurfaceTile&)");
+
+    if (tile >= this->NumberOfTiles(tilesize)) {
+        throw std::out_of_range("ParametricSurface::Tile(unsigned int, unsigned int, SurfaceTile&): tile out of range");
+    }
+    unsigned int ntiles_v = (this->N + tilesize - 1) / tilesize;
+    destination.ifirst = (tile / ntiles_v) * tilesize;
+    destination.jfirst = (tile % ntiles_v) * tilesize;
+    destination.mcells = std::min(tilesize, this->M - destination.ifirst);
+    destination.ncells = std::min(tilesize, this->N - destination.jfirst);
+
+    // The parameter values are computed exactly as in SampleGrid(), so the tiles match the whole grid
+    float du = (this->umax - this->umin) / this->M;
+    float dv = (this->vmax - this->vmin) / this->N;
+    float sign = this->frontfacing ? 1.0f : -1.0f;
+    unsigned int nu = destination.mcells + 1;
+    unsigned int nv = destination.ncells + 1;
+
+    std::vector<float> u(nu);
+    std::vector<float> v(nv);
+    for (unsigned int i = 0; i < nu; ++i) {
+        u[i] = this->umin + (destination.ifirst + i) * du;
+    }
+    for (unsigned int j = 0; j < nv; ++j) {
+        v[j] = this->vmin + (destination.jfirst + j) * dv;
+    }
+
+    destination.vertices.resize(nu * nv);
+    destination.normals.resize(nu * nv);
+    unsigned int minlines = 1 + 1024 / nv;
+    ParallelFor(0, nu, [&](std::size_t firstline, std::size_t lastline) {
+        glm::vec3* blockvertices = destination.vertices.data() + firstline * nv;
+        glm::vec3* blocknormals  = destination.normals.data()  + firstline * nv;
+        unsigned int blocksize = (lastline - firstline) * nv;
+
+        this->EvaluateGridBatch(u.data() + firstline, lastline - firstline, v.data(), nv,
+                                blockvertices, blocknormals);
+        for (unsigned int k = 0; k < blocksize; ++k) {
+            blocknormals[k] = sign * blocknormals[k];
+        }
+    }, minlines);
+
+    // The debug mode uses the global grid indices, so the pattern continues across the tiles
+    destination.indices.clear();
+    for (unsigned int i = 0; i < destination.mcells; ++i) {
+        for (unsigned int j = 0; j < destination.ncells; ++j) {
+            if (this->debug && ((destination.ifirst + i + destination.jfirst + j) % 2 == 1)) continue;
+
+            unsigned int lower_left  = i       * nv + j;
+            unsigned int lower_right = (i + 1) * nv + j;
+            unsigned int upper_right = (i + 1) * nv + j + 1;
+            unsigned int upper_left  = i       * nv + j + 1;
+
+            if (this->frontfacing) {
+                this->CreateFrontFacingIndices(lower_left, lower_right, upper_right, upper_left, destination.indices);
+            }
+            else {
+                this->CreateBackFacingIndices(lower_left, lower_right, upper_right, upper_left, destination.indices);
+            }
+        }
+    }
+}
+
+/*
+ * Streams the surface tile by tile, and passes each tile to a consumer.
+ * \param tilesize - the maximal number of grid cells in each direction of a tile.
+ * \param consumer - the function which is called with each tile in the order of the tile numbers.
+ */
+void ParametricSurface::ForEachTile(unsigned int tilesize,
+                                    std::function<void(SurfaceTile const&)> const& consumer) const
+{
+    Trace("ParametricSurface", "ForEachTile(unsigned int, std::function<void(SurfaceTile const&)> const&)");
+
+    SurfaceTile tile;
+    unsigned int ntiles = this->NumberOfTiles(tilesize);
+    for (unsigned int t = 0; t < ntiles; ++t) {
+        this->Tile(t, tilesize, tile);
+        consumer(tile);
+    }
+}
+
 /*
  * Protected members
  */
 
+/*
+ * Computes the coordinates of the points and the normals of the surface at a batch of parameters.
+ * The default implementation calls Vertex(u, v) and Normal(u, v) for each pair of parameters.
+ * \param u - the values of the first parameter of the surface.
+ * \param v - the values of the second parameter of the surface.
+ * \param count - the number of pairs of parameters.
+ * \param vertices - the destination of the count points on the surface.
+ * \param normals - the destination of the count normals of the surface.
+ */
+void ParametricSurface::EvaluateBatch(float const* u, float const* v, unsigned int count,
+                                      glm::vec3* vertices, glm::vec3* normals) const
+{
+    for (unsigned int k = 0; k < count; ++k) {
+        vertices[k] = this->Vertex(u[k], v[k]);
+        normals[k]  = this->Normal(u[k], v[k]);
+    }
+}
+
+/*
+ * Computes the coordinates of the points and the normals of the surface at each pair of parameters (u_i, v_j).
+ * The result for (u_i, v_j) is stored in entry i * nv + j.
+ * The default implementation calls EvaluateBatch once for each u-value.
+ * \param u - the values of the first parameter of the surface.
+ * \param nu - the number of u-values.
+ * \param v - the values of the second parameter of the surface.
+ * \param nv - the number of v-values.
+ * \param vertices - the destination of the nu * nv points on the surface.
+ * \param normals - the destination of the nu * nv normals of the surface.
+ */
+void ParametricSurface::EvaluateGridBatch(float const* u, unsigned int nu, float const* v, unsigned int nv,
+                                          glm::vec3* vertices, glm::vec3* normals) const
+{
+    std::vector<float> uline(nv);
+    for (unsigned int i = 0; i < nu; ++i) {
+        std::fill(uline.begin(), uline.end(), u[i]);
+        this->EvaluateBatch(uline.data(), v, nv, vertices + i * nv, normals + i * nv);
+    }
+}
+
 /*
  * Checks if the geometric data has changed since the last upload the the graphics card.
  * \return true if the geometric data has changed, else false.
@@ -311,6 +735,10 @@ void ParametricSurface::DataHasChanged(bool datachanged)
     Trace("ParametricSurface", "DataHasChanged(bool)");
 
     this->validdata = !datachanged;
+    if (datachanged) {
+        this->validgrid    = false;
+        this->validindices = false;
+    }
 }
 
 /*
@@ -324,97 +752,409 @@ void ParametricSurface::SampleSurface()
 {
     Trace("ParametricSurface", "SampleSurface()");
 
-    std::cout << "ParametricSurface::SampleSurface(): Not implemented yet!" << std::endl;
-    
+    this->UpdateGrid();
+
+    this->vertices.resize(this->indices.size());
+    this->normals.resize(this->indices.size());
+    this->WriteVertices(this->vertices.data(), this->normals.data());
+
     this->validdata = true;
 }
 
 /*
- * Generates two front facing triangles from a quadrilateral using counter clockwize order, 
- * and specifying the diagonal as the first edge.
- * \param V_lower_left - the lower left vertex.
- * \param V_lower_right - the lower right vertex.
- * \param V_upper_right - the upper right vertex.
- * \param V_upper_left - the upper left vertex.
- * \param vertices - a vector containing the vertices.
- * \param N_lower_left - the lower left normal.
- * \param N_lower_right - the lower right normal.
- * \param N_upper_right - the upper right normal.
- * \param N_upper_left - the upper left normal.
- * \param normals - a vector containing the normals.
- */
-void ParametricSurface::CreateFrontFacingData(glm::vec3 const& V_lower_left,  glm::vec3 const& V_lower_right,
-                                              glm::vec3 const& V_upper_right, glm::vec3 const& V_upper_left,
-                                              std::vector<glm::vec3>& vertices,
-                                              glm::vec3 const& N_lower_left,  glm::vec3 const& N_lower_right,
-                                              glm::vec3 const& N_upper_right, glm::vec3 const& N_upper_left,
-                                              std::vector<glm::vec3>& normals) const
-{
-    Trace("ParametricSurface", "CreateFrontFacingData(...)");
-
-    // Split Quadrilaterls into Triangles.
-    // Add Triangles counter clockwize starting with the diagonal
-    vertices.push_back(V_lower_left);
-    normals.push_back(N_lower_left);
+ * Brings the grid vertices, grid normals, and indices up to date.
+ * The surface is only evaluated if the parameter grid has changed.
+ */
+void ParametricSurface::UpdateGrid()
+{
+    Trace("ParametricSurface", "UpdateGrid()");
+
+    if (!this->validgrid) {
+        if (this->tolerance > 0.0f) {
+            this->SampleAdaptive();
+        }
+        else {
+            this->SampleGrid();
+        }
+    }
+
+    // A change of front facing only negates the normals
+    float sign = this->frontfacing ? 1.0f : -1.0f;
+    if (this->gridsign != sign) {
+        ParallelFor(0, this->gridnormals.size(), [&](std::size_t first, std::size_t last) {
+            for (unsigned int k = first; k < last; ++k) {
+                this->gridnormals[k] = -this->gridnormals[k];
+            }
+        }, 4096);
+        this->gridsign = sign;
+    }
+
+    if (!this->validindices) {
+        this->CreateIndices();
+    }
+}
+
+/*
+ * Evaluates the vertices and normals once at each point of the parameter grid.
+ */
+void ParametricSurface::SampleGrid()
+{
+    Trace("ParametricSurface", "SampleGrid()");
+
+    float du = (this->umax - this->umin) / this->M;
+    float dv = (this->vmax - this->vmin) / this->N;
+    float sign = this->frontfacing ? 1.0f : -1.0f;
+
+    std::vector<float> u(this->M + 1);
+    std::vector<float> v(this->N + 1);
+    for (unsigned int i = 0; i <= this->M; ++i) {
+        u[i] = this->umin + i * du;
+    }
+    for (unsigned int j = 0; j <= this->N; ++j) {
+        v[j] = this->vmin + j * dv;
+    }
+
+    this->gridvertices.resize((this->M + 1) * (this->N + 1));
+    this->gridnormals.resize((this->M + 1) * (this->N + 1));
 
-    vertices.push_back(V_upper_right);
-    normals.push_back(N_upper_right);
-                
-    vertices.push_back(V_upper_left);
-    normals.push_back(N_upper_left);
+    // Each block of grid lines of constant u is evaluated by one call of EvaluateGridBatch,
+    // and a block should contain at least about 1024 grid points to be worth a thread.
+    unsigned int minlines = 1 + 1024 / (this->N + 1);
+    ParallelFor(0, this->M + 1, [&](std::size_t firstline, std::size_t lastline) {
+        glm::vec3* blockvertices = this->gridvertices.data() + this->GridIndex(firstline, 0);
+        glm::vec3* blocknormals  = this->gridnormals.data()  + this->GridIndex(firstline, 0);
+        unsigned int blocksize = (lastline - firstline) * (this->N + 1);
 
-    // Add the second Triangle counter clockwize starting with the diagonal
-    vertices.push_back(V_upper_right);
-    normals.push_back(N_upper_right);
+        this->EvaluateGridBatch(u.data() + firstline, lastline - firstline, v.data(), this->N + 1,
+                                blockvertices, blocknormals);
+        for (unsigned int k = 0; k < blocksize; ++k) {
+            blocknormals[k] = sign * blocknormals[k];
+        }
+    }, minlines);
+    this->gridsign  = sign;
+    this->validgrid = true;
+}
+
+/*
+ * A cell of the quadtree used by the adaptive tessellation.
+ * The lower left corner (x, y) and the size are measured on the finest lattice, which splits each cell of
+ * the M x N grid into 2^maxlevel x 2^maxlevel cells. The four children of a cell are stored consecutively
+ * in the order (x, y), (x, y + size), (x + size, y), (x + size, y + size).
+ */
+namespace {
+    struct QuadtreeCell {
+        unsigned int x;
+        unsigned int y;
+        unsigned int level;
+        int          child;  // the index of the first child, or -1 if the cell is a leaf
+    };
+}
+
+/*
+ * Refines the cells of the parameter grid by a restricted quadtree according to the tolerance,
+ * evaluates the vertices and normals once at each vertex of the quadtree cells,
+ * and generates the indices of the front facing triangles.
+ */
+void ParametricSurface::SampleAdaptive()
+{
+    Trace("ParametricSurface", "SampleAdaptive()");
+
+    unsigned int const F  = 1u << this->maxlevel;
+    unsigned int const XF = this->M * F;
+    unsigned int const YF = this->N * F;
+    float const du = (this->umax - this->umin) / XF;
+    float const dv = (this->vmax - this->vmin) / YF;
+    float sign = this->frontfacing ? 1.0f : -1.0f;
+
+    // The roots are the cells of the M x N grid, the root of grid cell (i, j) has index i * N + j
+    std::vector<QuadtreeCell> cells;
+    std::vector<unsigned int> candidates;
+    for (unsigned int i = 0; i < this->M; ++i) {
+        for (unsigned int j = 0; j < this->N; ++j) {
+            candidates.push_back(cells.size());
+            cells.push_back(QuadtreeCell{i * F, j * F, 0, -1});
+        }
+    }
+
+    auto Split = [&cells, F](unsigned int c) {
+        QuadtreeCell cell = cells[c];
+        unsigned int half = F >> (cell.level + 1);
+        cells[c].child = cells.size();
+        cells.push_back(QuadtreeCell{cell.x,        cell.y,        cell.level + 1, -1});
+        cells.push_back(QuadtreeCell{cell.x,        cell.y + half, cell.level + 1, -1});
+        cells.push_back(QuadtreeCell{cell.x + half, cell.y,        cell.level + 1, -1});
+        cells.push_back(QuadtreeCell{cell.x + half, cell.y + half, cell.level + 1, -1});
+    };
+
+    // Refine level by level. The corners, edge midpoints, and center of all candidates of a level are evaluated
+    // as one batch, and a candidate is split if a midpoint deviates more than tolerance from the bilinear cell.
+    int const offsets[9][2] = {{0, 0}, {2, 0}, {2, 2}, {0, 2}, {1, 0}, {2, 1}, {1, 2}, {0, 1}, {1, 1}};
+    for (unsigned int level = 0; level < this->maxlevel && !candidates.empty(); ++level) {
+        unsigned int half = F >> (level + 1);
+        unsigned int nsamples = 9 * candidates.size();
+        std::vector<float> u(nsamples);
+        std::vector<float> v(nsamples);
+        for (unsigned int c = 0; c < candidates.size(); ++c) {
+            QuadtreeCell const& cell = cells[candidates[c]];
+            for (unsigned int k = 0; k < 9; ++k) {
+                u[9 * c + k] = this->umin + (cell.x + offsets[k][0] * half) * du;
+                v[9 * c + k] = this->vmin + (cell.y + offsets[k][1] * half) * dv;
+            }
+        }
+        std::vector<glm::vec3> points(nsamples);
+        std::vector<glm::vec3> normals(nsamples);
+        ParallelFor(0, candidates.size(), [&](std::size_t first, std::size_t last) {
+            this->EvaluateBatch(&u[9 * first], &v[9 * first], 9 * (last - first), &points[9 * first], &normals[9 * first]);
+        }, 128);
+
+        std::vector<unsigned int> nextcandidates;
+        for (unsigned int c = 0; c < candidates.size(); ++c) {
+            glm::vec3 const* p = &points[9 * c];
+            float error = glm::length(p[8] - 0.25f * (p[0] + p[1] + p[2] + p[3]));
+            for (unsigned int k = 0; k < 4; ++k) {
+                error = std::max(error, glm::length(p[4 + k] - 0.5f * (p[k] + p[(k + 1) % 4])));
+            }
+            if (error > this->tolerance) {
+                Split(candidates[c]);
+                for (unsigned int k = 0; k < 4; ++k) {
+                    nextcandidates.push_back(cells[candidates[c]].child + k);
+                }
+            }
+        }
+        candidates.swap(nextcandidates);
+    }
+
+    // The leaf containing the cell (x, y) of the finest lattice
+    auto Leaf = [&cells, F, this](unsigned int x, unsigned int y) {
+        unsigned int c = (x / F) * this->N + (y / F);
+        while (cells[c].child >= 0) {
+            unsigned int half = F >> (cells[c].level + 1);
+            c = cells[c].child + ((x - cells[c].x >= half) ? 2 : 0) + ((y - cells[c].y >= half) ? 1 : 0);
+        }
+        return c;
+    };
+
+    // The leaf containing the cell (x, y) of the finest lattice, where x and y may be one cell outside the domain.
+    // They are wrapped across the periodic seams, and the function returns false if there is no such cell.
+    auto Neighbour = [&Leaf, XF, YF, this](long x, long y, unsigned int& leaf) {
+        if ((x < 0) || (x >= long(XF))) {
+            if (!this->periodicu) return false;
+            x = (x < 0) ? x + XF : x - XF;
+        }
+        if ((y < 0) || (y >= long(YF))) {
+            if (!this->periodicv) return false;
+            y = (y < 0) ? y + YF : y - YF;
+        }
+        leaf = Leaf(x, y);
+        return true;
+    };
+
+    // Restrict the quadtree, i.e. split leaves which are more than one level coarser than a neighbour.
+    // A coarser neighbour covers the whole shared edge, so it suffices to look at the lattice cell next to the first corner.
+    bool restricted = false;
+    while (!restricted) {
+        restricted = true;
+        for (unsigned int c = 0; c < cells.size(); ++c) {
+            if (cells[c].child >= 0 || cells[c].level < 2) continue;
+
+            unsigned int x = cells[c].x;
+            unsigned int y = cells[c].y;
+            unsigned int size = F >> cells[c].level;
+            unsigned int neighbours[4];
+            unsigned int nneighbours = 0;
+            if (Neighbour(long(x) - 1, y,           neighbours[nneighbours])) ++nneighbours;
+            if (Neighbour(x + size,    y,           neighbours[nneighbours])) ++nneighbours;
+            if (Neighbour(x,           long(y) - 1, neighbours[nneighbours])) ++nneighbours;
+            if (Neighbour(x,           y + size,    neighbours[nneighbours])) ++nneighbours;
+            for (unsigned int k = 0; k < nneighbours; ++k) {
+                if (cells[neighbours[k]].level + 1 < cells[c].level) {
+                    Split(neighbours[k]);
+                    restricted = false;
+                }
+            }
+        }
+    }
+
+    // Number the corners of the leaves, each lattice point gets one vertex, and the two edges of a periodic seam share theirs
+    std::unordered_map<unsigned long long, unsigned int> vertexindex;
+    std::vector<float> u;
+    std::vector<float> v;
+    auto CornerIndex = [&](unsigned int x, unsigned int y) {
+        if (this->periodicu && (x == XF)) x = 0;
+        if (this->periodicv && (y == YF)) y = 0;
+        unsigned long long key = static_cast<unsigned long long>(x) * (YF + 1) + y;
+        auto inserted = vertexindex.insert(std::make_pair(key, static_cast<unsigned int>(u.size())));
+        if (inserted.second) {
+            u.push_back(this->umin + x * du);
+            v.push_back(this->vmin + y * dv);
+        }
+        return inserted.first->second;
+    };
+
+    // Triangulate the leaves counter clockwize. A leaf without finer neighbours becomes two triangles like a grid cell,
+    // otherwise it becomes a fan around its center which includes the midpoints of the edges shared with finer leaves.
+    // In debug mode only every other leaf of each level is shown, like the quadrilaterals of the uniform grid.
+    this->maxdepth = 0;
+    this->adaptiveindices.clear();
+    this->adaptivedebugindices.clear();
+    for (unsigned int c = 0; c < cells.size(); ++c) {
+        if (cells[c].child >= 0) continue;
+
+        unsigned int x = cells[c].x;
+        unsigned int y = cells[c].y;
+        unsigned int level = cells[c].level;
+        unsigned int size = F >> level;
+        unsigned int half = size / 2;
+        this->maxdepth = std::max(this->maxdepth, level);
+
+        unsigned int n;
+        bool bottom = (size > 1) && Neighbour(x,           long(y) - 1, n) && (cells[n].level > level);
+        bool right  = (size > 1) && Neighbour(x + size,    y,           n) && (cells[n].level > level);
+        bool top    = (size > 1) && Neighbour(x,           y + size,    n) && (cells[n].level > level);
+        bool left   = (size > 1) && Neighbour(long(x) - 1, y,           n) && (cells[n].level > level);
+
+        unsigned int lower_left  = CornerIndex(x,        y);
+        unsigned int lower_right = CornerIndex(x + size, y);
+        unsigned int upper_right = CornerIndex(x + size, y + size);
+        unsigned int upper_left  = CornerIndex(x,        y + size);
+
+        std::size_t first = this->adaptiveindices.size();
+        if (!(bottom || right || top || left)) {
+            this->CreateFrontFacingIndices(lower_left, lower_right, upper_right, upper_left, this->adaptiveindices);
+        }
+        else {
+            std::vector<unsigned int> boundary;
+            boundary.push_back(lower_left);
+            if (bottom) boundary.push_back(CornerIndex(x + half, y));
+            boundary.push_back(lower_right);
+            if (right)  boundary.push_back(CornerIndex(x + size, y + half));
+            boundary.push_back(upper_right);
+            if (top)    boundary.push_back(CornerIndex(x + half, y + size));
+            boundary.push_back(upper_left);
+            if (left)   boundary.push_back(CornerIndex(x,        y + half));
+
+            unsigned int center = CornerIndex(x + half, y + half);
+            for (unsigned int k = 0; k < boundary.size(); ++k) {
+                this->adaptiveindices.push_back(center);
+                this->adaptiveindices.push_back(boundary[k]);
+                this->adaptiveindices.push_back(boundary[(k + 1) % boundary.size()]);
+            }
+        }
+        if ((x / size + y / size) % 2 == 0) {
+            this->adaptivedebugindices.insert(this->adaptivedebugindices.end(),
+                                              this->adaptiveindices.begin() + first, this->adaptiveindices.end());
+        }
+    }
 
-    vertices.push_back(V_lower_left);
-    normals.push_back(N_lower_left);
-                
-    vertices.push_back(V_lower_right);
-    normals.push_back(N_lower_right);
+    // Evaluate the surface once at each vertex
+    this->gridvertices.resize(u.size());
+    this->gridnormals.resize(u.size());
+    ParallelFor(0, u.size(), [&](std::size_t first, std::size_t last) {
+        this->EvaluateBatch(&u[first], &v[first], last - first, &this->gridvertices[first], &this->gridnormals[first]);
+        for (unsigned int k = first; k < last; ++k) {
+            this->gridnormals[k] = sign * this->gridnormals[k];
+        }
+    }, 1024);
+    this->gridsign  = sign;
+    this->validgrid = true;
 }
 
 /*
- * Generates two back facing triangles from a quadrilateral using clockwize order, 
+ * Generates the indices of the triangles according to the front facing and debug modes.
+ */
+void ParametricSurface::CreateIndices()
+{
+    Trace("ParametricSurface", "CreateIndices()");
+
+    this->indices.clear();
+
+    // The adaptive triangles are stored front facing, and a triangle is reversed by swapping its first two vertices
+    if (this->tolerance > 0.0f) {
+        this->indices = this->debug ? this->adaptivedebugindices : this->adaptiveindices;
+        if (!this->frontfacing) {
+            for (unsigned int k = 0; k < this->indices.size(); k += 3) {
+                std::swap(this->indices[k], this->indices[k + 1]);
+            }
+        }
+        this->validindices = true;
+        return;
+    }
+
+    this->indices.reserve(6 * this->M * this->N);
+    for (unsigned int i = 0; i < this->M; ++i) {
+        for (unsigned int j = 0; j < this->N; ++j) {
+            // In debug mode only every other quadrilateral is shown
+            if (this->debug && ((i + j) % 2 == 1)) continue;
+
+            unsigned int lower_left  = this->GridIndex(i,     j);
+            unsigned int lower_right = this->GridIndex(i + 1, j);
+            unsigned int upper_right = this->GridIndex(i + 1, j + 1);
+            unsigned int upper_left  = this->GridIndex(i,     j + 1);
+
+            if (this->frontfacing) {
+                this->CreateFrontFacingIndices(lower_left, lower_right, upper_right, upper_left, this->indices);
+            }
+            else {
+                this->CreateBackFacingIndices(lower_left, lower_right, upper_right, upper_left, this->indices);
+            }
+        }
+    }
+    this->validindices = true;
+}
+
+/*
+ * The index of a grid point in GridVertices() and GridNormals().
+ * \param i - the index of the u-parameter, 0 <= i <= M.
+ * \param j - the index of the v-parameter, 0 <= j <= N.
+ * \return the index of the grid point (u_i, v_j).
+ */
+unsigned int ParametricSurface::GridIndex(unsigned int i, unsigned int j) const
+{
+    return i * (this->N + 1) + j;
+}
+
+/*
+ * Generates the indices of two front facing triangles from a quadrilateral using counter clockwize order,
+ * and specifying the diagonal as the first edge.
+ * \param lower_left - the index of the lower left grid point.
+ * \param lower_right - the index of the lower right grid point.
+ * \param upper_right - the index of the upper right grid point.
+ * \param upper_left - the index of the upper left grid point.
+ * \param indices - a vector containing the indices.
+ */
+void ParametricSurface::CreateFrontFacingIndices(unsigned int lower_left,  unsigned int lower_right,
+                                                 unsigned int upper_right, unsigned int upper_left,
+                                                 std::vector<unsigned int>& indices) const
+{
+    // Add Triangles counter clockwize starting with the diagonal
+    indices.push_back(lower_left);
+    indices.push_back(upper_right);
+    indices.push_back(upper_left);
+
+    indices.push_back(upper_right);
+    indices.push_back(lower_left);
+    indices.push_back(lower_right);
+}
+
+/*
+ * Generates the indices of two back facing triangles from a quadrilateral using clockwize order,
  * and specifying the diagonal as the first edge.
- * \param V_lower_left - the lower left vertex.
- * \param V_lower_right - the lower right vertex.
- * \param V_upper_right - the upper right vertex.
- * \param V_upper_left - the upper left vertex.
- * \param vertices - a vector containing the vertices.
- * \param N_lower_left - the lower left normal.
- * \param N_lower_right - the lower right normal.
- * \param N_upper_right - the upper right normal.
- * \param N_upper_left - the upper left normal.
- * \param normals - a vector containing the normals.
- */
-void ParametricSurface::CreateBackFacingData(glm::vec3 const& V_lower_left,  glm::vec3 const& V_lower_right,
-                                             glm::vec3 const& V_upper_right, glm::vec3 const& V_upper_left,
-                                             std::vector<glm::vec3>& vertices,
-                                             glm::vec3 const& N_lower_left,  glm::vec3 const& N_lower_right,
-                                             glm::vec3 const& N_upper_right, glm::vec3 const& N_upper_left,
-                                             std::vector<glm::vec3>& normals) const
-{
-    Trace("ParametricSurface", "CreateBackFacingData(...)");
-
-    // Split Quadrilaterals into Triangles
-    // Add Triangles clockwize starting with the diagonal and negate the normals
-    vertices.push_back(V_upper_right);
-    normals.push_back(-N_upper_right);
-
-    vertices.push_back(V_lower_left);
-    normals.push_back(-N_lower_left);
-                
-    vertices.push_back(V_upper_left);
-    normals.push_back(-N_upper_left);
-                
-    // Add the second Triangle clockwize starting with the diagonal
-    vertices.push_back(V_lower_left);
-    normals.push_back(-N_lower_left);
-
-    vertices.push_back(V_upper_right);
-    normals.push_back(-N_upper_right);
-                
-    vertices.push_back(V_lower_right);
-    normals.push_back(-N_lower_right);
+ * \param lower_left - the index of the lower left grid point.
+ * \param lower_right - the index of the lower right grid point.
+ * \param upper_right - the index of the upper right grid point.
+ * \param upper_left - the index of the upper left grid point.
+ * \param indices - a vector containing the indices.
+ */
+void ParametricSurface::CreateBackFacingIndices(unsigned int lower_left,  unsigned int lower_right,
+                                                unsigned int upper_right, unsigned int upper_left,
+                                                std::vector<unsigned int>& indices) const
+{
+    // Add Triangles clockwize starting with the diagonal
+    indices.push_back(upper_right);
+    indices.push_back(lower_left);
+    indices.push_back(upper_left);
+
+    indices.push_back(lower_left);
+    indices.push_back(upper_right);
+    indices.push_back(lower_right);
 }
@@ -1,7 +1,11 @@
 #define _USE_MATH_DEFINES
 
+#include <algorithm>
+
 #include "traceinfo.h"
 #include "phongsurface.h"
+#include "parallelfor.h"
+#include "vectormath.h"
 
 /*
  * \class PhongSurface
@@ -65,6 +69,7 @@ PhongSurface::PhongSurface(PhongSurface const& Src)
 
     this->N_user = Src.N_user;
     this->L_user = Src.L_user;
+    this->R_user = Src.R_user;
     this->N_user_dot_L_user = Src.N_user_dot_L_user;
 
     this->I_a = Src.I_a;
@@ -89,6 +94,10 @@ PhongSurface::PhongSurface(PhongSurface const& Src)
     this->theta_stop  = Src.theta_stop;
     this->N_theta     = Src.N_theta;
     this->delta_theta = Src.delta_theta;
+
+    this->importance_sampling = Src.importance_sampling;
+    this->uniform_N_phi       = Src.uniform_N_phi;
+    this->uniform_N_theta     = Src.uniform_N_theta;
 }
 
 /*
@@ -111,6 +120,7 @@ PhongSurface& PhongSurface::operator=(PhongSurface const& Src)
 
         this->N_user = Src.N_user;
         this->L_user = Src.L_user;
+        this->R_user = Src.R_user;
         this->N_user_dot_L_user = Src.N_user_dot_L_user;
 
         this->I_a = Src.I_a;
@@ -135,6 +145,10 @@ PhongSurface& PhongSurface::operator=(PhongSurface const& Src)
         this->theta_stop  = Src.theta_stop;
         this->N_theta     = Src.N_theta;
         this->delta_theta = Src.delta_theta;
+
+        this->importance_sampling = Src.importance_sampling;
+        this->uniform_N_phi       = Src.uniform_N_phi;
+        this->uniform_N_theta     = Src.uniform_N_theta;
     }
     return *this;
 }
@@ -150,12 +164,19 @@ int PhongSurface::PhiSamples() const
 
 /*
  * Changes the number of subdivisions of the height angle, i.e. the phi-interval.
+ * If the samples are importance driven, the sampling returns to uniform.
  * \param newPhiSamples - the new number of samples of the phi-interval.
  * \return - the old number of samples of the phi-interval.
  */
 int PhongSurface::PhiSamples(int newPhiSamples)
 {
     int old_N_phi = this->N_phi;
+
+    // An explicit number of samples ends the importance sampling, and the theta-samples become uniform again
+    if (this->importance_sampling) {
+        this->importance_sampling = false;
+        this->ThetaSamples(this->uniform_N_theta);
+    }
     this->N_phi = newPhiSamples;
     this->delta_phi = (this->phi_stop - this->phi_start) / float(this->N_phi);
     this->verticesOK = false;
@@ -174,12 +195,19 @@ int PhongSurface::ThetaSamples() const
 
 /*
  * Changes the number of subdivisions of the azimuth angle, i.e. the theta-interval.
+ * If the samples are importance driven, the sampling returns to uniform.
  * \param newThetaSamples - the new number of samples of the theta-interval.
  * \return - the old number of samples of the theta-interval.
  */
 int PhongSurface::ThetaSamples(int newThetaSamples)
 {
     int old_N_theta = this->N_theta;
+
+    // An explicit number of samples ends the importance sampling, and the phi-samples become uniform again
+    if (this->importance_sampling) {
+        this->importance_sampling = false;
+        this->PhiSamples(this->uniform_N_phi);
+    }
     this->N_theta = newThetaSamples;
     this->delta_theta = (this->theta_stop - this->theta_start) / float(this->N_theta);
     this->verticesOK = false;
@@ -187,6 +215,55 @@ int PhongSurface::ThetaSamples(int newThetaSamples)
     return old_N_theta;
 }
 
+/*
+ * Tells whether the samples are concentrated around the specular lobe.
+ * \return - true if the samples are importance driven, false if they are uniform.
+ */
+bool PhongSurface::ImportanceSampling() const
+{
+    return this->importance_sampling;
+}
+
+/*
+ * Changes the sampling to a fixed number of triangles, which are concentrated around the specular lobe.
+ * \param trianglebudget - the maximal number of triangles, or 0 to return to uniform sampling with the numbers
+ *                         of samples from before the importance sampling.
+ */
+void PhongSurface::ImportanceSampling(int trianglebudget)
+{
+    if (trianglebudget < 0) {
+        throw std::invalid_argument("PhongSurface::ImportanceSampling(int): trianglebudget must be >= 0");
+    }
+    if (trianglebudget == 0) {
+        if (this->importance_sampling) {
+            this->importance_sampling = false;
+            this->PhiSamples(this->uniform_N_phi);
+            this->ThetaSamples(this->uniform_N_theta);
+        }
+    }
+    else {
+        if (trianglebudget < 2) {
+            throw std::invalid_argument("PhongSurface::ImportanceSampling(int): trianglebudget must be 0 or >= 2");
+        }
+
+        // The uniform numbers of samples are saved, so ImportanceSampling(0) can restore them
+        if (!this->importance_sampling) {
+            this->uniform_N_phi   = this->N_phi;
+            this->uniform_N_theta = this->N_theta;
+        }
+
+        // Each quadrilateral is 2 triangles, and the shape of the uniform grid is kept
+        float ratio = float(this->uniform_N_theta) / float(this->uniform_N_phi);
+        int nphi = std::max(1, int(std::floor(std::sqrt(0.5f * trianglebudget / ratio))));
+        int ntheta = std::max(1, trianglebudget / (2 * nphi));
+        this->PhiSamples(nphi);
+        this->ThetaSamples(ntheta);
+        this->importance_sampling = true;
+    }
+    this->verticesOK = false;
+    this->normalsOK  = false;
+}
+
 /*
  * Computes a vertex on the Phong reflection surface given parameters phi and theta.
  * \param phi - the height angle of the view vector.
@@ -228,26 +305,7 @@ glm::vec3 PhongSurface::Normal(float phi, float theta) const
 std::vector<glm::vec3> const& PhongSurface::Vertices()
 {
     if (!this->verticesOK) {
-        this->vertices.clear();
-        for (float phi = this->phi_start; phi < this->phi_stop; phi += this->delta_phi) {
-            for (float theta = this->theta_start; theta < this->theta_stop; theta += delta_theta) {
-                glm::vec3 v_11 = this->Vertex(phi, theta);
-                glm::vec3 v_12 = this->Vertex(phi, theta + this->delta_theta);
-                glm::vec3 v_21 = this->Vertex(phi + this->delta_phi, theta);
-                glm::vec3 v_22 = this->Vertex(phi + this->delta_phi, theta + this->delta_theta);
-
-                // The first triangle
-                this->vertices.push_back(v_11);
-                this->vertices.push_back(v_12);
-                this->vertices.push_back(v_22);
-        
-                // The second triangle
-                this->vertices.push_back(v_11);
-                this->vertices.push_back(v_22);
-                this->vertices.push_back(v_21);
-            }
-        }
-        this->verticesOK = true;
+        this->Sample();
     }
     return this->vertices;
 }
@@ -259,34 +317,283 @@ std::vector<glm::vec3> const& PhongSurface::Vertices()
 std::vector<glm::vec3> const& PhongSurface::Normals()
 {
     if (!this->normalsOK) {
-        this->normals.clear();
-        for (float phi = this->phi_start; phi < this->phi_stop; phi += this->delta_phi) {
-            for (float theta = this->theta_start; theta < this->theta_stop; theta += delta_theta) {
-                glm::vec3 n_11 = this->Normal(phi, theta);
-                glm::vec3 n_12 = this->Normal(phi, theta + delta_theta);
-                glm::vec3 n_21 = this->Normal(phi + delta_phi, theta);
-                glm::vec3 n_22 = this->Normal(phi + delta_phi, theta + delta_theta);
+        this->Sample();
+    }
+    return this->normals;
+}
+
+/*
+ * The number of triangle vertices, i.e. the number of entries in Vertices() and Normals().
+ * \return - the number of triangle vertices.
+ */
+unsigned int PhongSurface::NumberOfVertices() const
+{
+    return 6 * this->N_phi * this->N_theta;
+}
+
+/*
+ * Writes the triangle vertices and normals interleaved into a destination supplied by the caller.
+ * \param destination - room for 2 * NumberOfVertices() 3D vectors.
+ */
+void PhongSurface::WriteInterleaved(glm::vec3* destination) const
+{
+    std::vector<glm::vec3> gridvertices;
+    std::vector<glm::vec3> gridnormals;
+    this->SampleGrid(gridvertices, gridnormals);
+
+    // Each row of quadrilaterals writes its own range of the destination
+    unsigned int nquads = this->N_theta;
+    ParallelFor(0, this->N_phi, [&](std::size_t firstrow, std::size_t lastrow) {
+        for (unsigned int i = firstrow; i < lastrow; ++i) {
+            glm::vec3* target = destination + 12 * i * nquads;
+            for (unsigned int j = 0; j < nquads; ++j) {
+                unsigned int k_11 = this->GridIndex(i, j);
+                unsigned int k_12 = this->GridIndex(i, j + 1);
+                unsigned int k_21 = this->GridIndex(i + 1, j);
+                unsigned int k_22 = this->GridIndex(i + 1, j + 1);
 
                 // The first triangle
-                this->normals.push_back(n_11);
-                this->normals.push_back(n_12);
-                this->normals.push_back(n_22);
+                *target++ = gridvertices[k_11]; *target++ = gridnormals[k_11];
+                *target++ = gridvertices[k_12]; *target++ = gridnormals[k_12];
+                *target++ = gridvertices[k_22]; *target++ = gridnormals[k_22];
 
                 // The second triangle
-                this->normals.push_back(n_11);
-                this->normals.push_back(n_22);
-                this->normals.push_back(n_21);
+                *target++ = gridvertices[k_11]; *target++ = gridnormals[k_11];
+                *target++ = gridvertices[k_22]; *target++ = gridnormals[k_22];
+                *target++ = gridvertices[k_21]; *target++ = gridnormals[k_21];
             }
         }
-        this->normalsOK = true;
-    }
-    return this->normals;
+    });
+}
+
+/*
+ * Computes the axis aligned bounding box of the surface.
+ * \param boxmin - on return the lower corner of the bounding box.
+ * \param boxmax - on return the upper corner of the bounding box.
+ */
+void PhongSurface::BoundingBox(glm::vec3& boxmin, glm::vec3& boxmax)
+{
+    std::vector<glm::vec3> const& vertices = this->Vertices();
+    ::BoundingBox(vertices.data(), vertices.size(), boxmin, boxmax);
+}
+
+/*
+ * Writes the triangle vertices and normals as quantized vertices into a destination supplied by the caller.
+ * \param destination - room for NumberOfVertices() quantized vertices.
+ */
+void PhongSurface::WriteQuantized(QuantizedVertex* destination)
+{
+    glm::vec3 boxmin;
+    glm::vec3 boxmax;
+    this->BoundingBox(boxmin, boxmax);
+
+    std::vector<glm::vec3> const& vertices = this->Vertices();
+    std::vector<glm::vec3> const& normals  = this->Normals();
+    EncodeVertices(vertices.data(), normals.data(), vertices.size(), boxmin, boxmax, destination);
 }
 
 // Protected member functions
 
 // Private member functions
 
+/*
+ * The index of the grid point (phi_i, theta_j) in the grids computed by SampleGrid(...).
+ * \param i - the number of the phi-sample, 0 <= i <= PhiSamples().
+ * \param j - the number of the theta-sample, 0 <= j <= ThetaSamples().
+ * \return - the index of the grid point.
+ */
+unsigned int PhongSurface::GridIndex(unsigned int i, unsigned int j) const
+{
+    return i * (this->N_theta + 1) + j;
+}
+
+/*
+ * Computes the samples of the height angle and the azimuth angle.
+ * \param phi - on return the PhiSamples() + 1 values of phi.
+ * \param theta - on return the ThetaSamples() + 1 values of theta.
+ */
+void PhongSurface::SampleAngles(std::vector<float>& phi, std::vector<float>& theta) const
+{
+    unsigned int nphi   = this->N_phi + 1;
+    unsigned int ntheta = this->N_theta + 1;
+
+    // The samples are computed from their integer indices, so the number of samples is exact
+    phi.resize(nphi);
+    theta.resize(ntheta);
+    for (unsigned int i = 0; i < nphi; ++i) {
+        phi[i] = this->phi_start + i * this->delta_phi;
+    }
+    for (unsigned int j = 0; j < ntheta; ++j) {
+        theta[j] = this->theta_start + j * this->delta_theta;
+    }
+    if (!this->importance_sampling) return;
+
+    // The error of the linear interpolation between two samples at distance h is about h^2 |P''| / 8, so it is
+    // the same everywhere if the density of the samples is proportional to sqrt|P''|. The gradient of the lobe
+    // vanishes at its peak, where P'' is largest, so the importance of a phi-value is the largest sqrt|d2P/dphi2|
+    // over all theta, and vice versa. Only the specular term depends on the angles, and it is clamped at R.V = 0.
+    unsigned int const nfinephi   = 256;
+    unsigned int const nfinetheta = 512;
+    float finedelta_phi   = (this->phi_stop - this->phi_start) / (nfinephi - 1);
+    float finedelta_theta = (this->theta_stop - this->theta_start) / (nfinetheta - 1);
+    float specular = this->k_s * this->O_s * this->I_s;
+
+    std::vector<float> lobe(nfinephi * nfinetheta);
+    for (unsigned int i = 0; i < nfinephi; ++i) {
+        float finephi = this->phi_start + i * finedelta_phi;
+        for (unsigned int j = 0; j < nfinetheta; ++j) {
+            float finetheta = this->theta_start + j * finedelta_theta;
+            float RdotV = std::max(glm::dot(this->R_user, this->V(finephi, finetheta)), 0.0f);
+            lobe[i * nfinetheta + j] = specular * std::pow(RdotV, this->shininess);
+        }
+    }
+
+    std::vector<float> importance_phi(nfinephi, 0.0f);
+    std::vector<float> importance_theta(nfinetheta, 0.0f);
+    for (unsigned int i = 1; i < nfinephi - 1; ++i) {
+        for (unsigned int j = 1; j < nfinetheta - 1; ++j) {
+            float const* center = &lobe[i * nfinetheta + j];
+            float d2Pdphi2   = (center[nfinetheta] - 2.0f * center[0] + center[-int(nfinetheta)])
+                             / (finedelta_phi * finedelta_phi);
+            float d2Pdtheta2 = (center[1] - 2.0f * center[0] + center[-1]) / (finedelta_theta * finedelta_theta);
+            importance_phi[i]   = std::max(importance_phi[i],   std::sqrt(std::fabs(d2Pdphi2)));
+            importance_theta[j] = std::max(importance_theta[j], std::sqrt(std::fabs(d2Pdtheta2)));
+        }
+    }
+
+    // Places count + 1 samples in [start, stop] such that each interval holds the same share of the density,
+    // i.e. the inverse of the cumulative density is sampled uniformly
+    auto Place = [](std::vector<float> const& importance, float start, float stop, std::vector<float>& samples) {
+        unsigned int nfine = importance.size();
+        std::vector<float> cumulative(nfine, 0.0f);
+        for (unsigned int k = 1; k < nfine; ++k) {
+            cumulative[k] = cumulative[k - 1] + 0.5f * (importance[k - 1] + importance[k]);
+        }
+        float total = cumulative[nfine - 1];
+
+        // A quarter of the samples are uniform, so flat regions are never empty
+        for (unsigned int k = 0; k < nfine; ++k) {
+            float uniform = float(k) / (nfine - 1);
+            cumulative[k] = (total > 0.0f) ? 0.25f * uniform + 0.75f * cumulative[k] / total : uniform;
+        }
+
+        unsigned int count = samples.size() - 1;
+        unsigned int k = 0;
+        for (unsigned int n = 1; n < count; ++n) {
+            float target = float(n) / count;
+            while ((k < nfine - 2) && (cumulative[k + 1] < target)) ++k;
+            float t = (target - cumulative[k]) / (cumulative[k + 1] - cumulative[k]);
+            samples[n] = start + (k + t) * (stop - start) / (nfine - 1);
+        }
+        samples[0] = start;
+        samples[count] = stop;
+    };
+    Place(importance_phi,   this->phi_start,   this->phi_stop,   phi);
+    Place(importance_theta, this->theta_start, this->theta_stop, theta);
+}
+
+/*
+ * Computes the vertices and the normals at the grid points (phi_i, theta_j) in one pass.
+ * \param gridvertices - on return the (PhiSamples() + 1) * (ThetaSamples() + 1) vertices.
+ * \param gridnormals - on return the normals of the grid vertices.
+ */
+void PhongSurface::SampleGrid(std::vector<glm::vec3>& gridvertices, std::vector<glm::vec3>& gridnormals) const
+{
+    unsigned int nphi   = this->N_phi + 1;
+    unsigned int ntheta = this->N_theta + 1;
+
+    std::vector<float> phi;
+    std::vector<float> theta;
+    this->SampleAngles(phi, theta);
+
+    // The sines and cosines are computed once per phi-value and once per theta-value
+    std::vector<float> sin_phi(nphi);
+    std::vector<float> cos_phi(nphi);
+    std::vector<float> sin_theta(ntheta);
+    std::vector<float> cos_theta(ntheta);
+    SinCos(phi.data(),   nphi,   sin_phi.data(),   cos_phi.data());
+    SinCos(theta.data(), ntheta, sin_theta.data(), cos_theta.data());
+
+    float ambient_diffuse = this->k_a * this->O_a * this->I_a
+                          + this->k_d * this->O_d * this->I_d * this->N_user_dot_L_user;
+    float specular = this->k_s * this->O_s * this->I_s;
+
+    gridvertices.resize(nphi * ntheta);
+    gridnormals.resize(nphi * ntheta);
+    unsigned int minrows = 1 + 1024 / ntheta;
+    ParallelFor(0, nphi, [&](std::size_t firstrow, std::size_t lastrow) {
+        for (unsigned int i = firstrow; i < lastrow; ++i) {
+            float sp = sin_phi[i];
+            float cp = cos_phi[i];
+            for (unsigned int j = 0; j < ntheta; ++j) {
+                float st = sin_theta[j];
+                float ct = cos_theta[j];
+
+                // The view vector and its partial derivatives, see V(...), dVdphi(...), and dVdtheta(...)
+                glm::vec3 V(cp * ct, cp * st, sp);
+                glm::vec3 dVdphi(-sp * ct, -sp * st, cp);
+                glm::vec3 dVdtheta(-cp * st, cp * ct, 0.0f);
+
+                // The Phong function and its partial derivatives share one power of R.V, which is clamped at 0
+                // like the lobe of SampleAngles(...), see P(...), dPdphi(...), and dPdtheta(...)
+                float RdotV = std::max(glm::dot(this->R_user, V), 0.0f);
+                float power = std::pow(RdotV, this->shininess - 1.0f);
+                float P = ambient_diffuse + specular * power * RdotV;
+                float dPdphi   = specular * this->shininess * power * glm::dot(this->R_user, dVdphi);
+                float dPdtheta = specular * this->shininess * power * glm::dot(this->R_user, dVdtheta);
+
+                glm::vec3 Dphi   = dPdphi   * V + P * dVdphi;
+                glm::vec3 Dtheta = dPdtheta * V + P * dVdtheta;
+                glm::vec3 normal = glm::cross(Dtheta, Dphi);
+                if (normal != glm::vec3(0.0f)) {
+                    normal = glm::normalize(normal);
+                }
+
+                unsigned int k = this->GridIndex(i, j);
+                gridvertices[k] = P * V;
+                gridnormals[k]  = normal;
+            }
+        }
+    }, minrows);
+}
+
+/*
+ * Computes the triangle vertices and normals in one pass, and marks both as OK.
+ */
+void PhongSurface::Sample()
+{
+    std::vector<glm::vec3> gridvertices;
+    std::vector<glm::vec3> gridnormals;
+    this->SampleGrid(gridvertices, gridnormals);
+
+    // Each row of quadrilaterals writes its own range of the presized vectors
+    unsigned int nquads = this->N_theta;
+    this->vertices.resize(this->NumberOfVertices());
+    this->normals.resize(this->NumberOfVertices());
+    ParallelFor(0, this->N_phi, [&](std::size_t firstrow, std::size_t lastrow) {
+        for (unsigned int i = firstrow; i < lastrow; ++i) {
+            unsigned int first = 6 * i * nquads;
+            glm::vec3* targetvertices = this->vertices.data() + first;
+            glm::vec3* targetnormals  = this->normals.data()  + first;
+            for (unsigned int j = 0; j < nquads; ++j) {
+                unsigned int k[6] = {this->GridIndex(i, j),         // The first triangle
+                                     this->GridIndex(i, j + 1),
+                                     this->GridIndex(i + 1, j + 1),
+                                     this->GridIndex(i, j),         // The second triangle
+                                     this->GridIndex(i + 1, j + 1),
+                                     this->GridIndex(i + 1, j)};
+                for (unsigned int n = 0; n < 6; ++n) {
+                    *targetvertices++ = gridvertices[k[n]];
+                    *targetnormals++  = gridnormals[k[n]];
+                }
+            }
+        }
+    });
+
+    this->verticesOK = true;
+    this->normalsOK  = true;
+}
+
 /*
  * Initializes the private variables.
  */
@@ -309,6 +616,11 @@ void PhongSurface::Initialize()
     this->theta_stop =  M_PI;
     this->delta_theta = (this->theta_stop - this->theta_start) / float(this->N_theta);
 
+    // The samples are uniform until ImportanceSampling(int) is called
+    this->importance_sampling = false;
+    this->uniform_N_phi       = this->N_phi;
+    this->uniform_N_theta     = this->N_theta;
+
     // Neither the Vertices nor the Normals are computed yet, so they are not OK.
     this->verticesOK = false;
     this->normalsOK  = false;
@@ -358,7 +670,7 @@ glm::vec3 PhongSurface::dVdtheta(float phi, float theta) const
  */
 float PhongSurface::P(float phi, float theta) const
 {
-    float RdotV = glm::dot(this->R_user, this->V(phi, theta));
+    float RdotV = std::max(glm::dot(this->R_user, this->V(phi, theta)), 0.0f);
 
     float Pvalue = 0.0f;
     Pvalue += this->k_a * this->O_a * this->I_a;
@@ -376,7 +688,7 @@ float PhongSurface::P(float phi, float theta) const
  */
 float PhongSurface::dPdphi(float phi, float theta) const
 {
-    float RdotV = glm::dot(this->R_user, this->V(phi, theta));
+    float RdotV = std::max(glm::dot(this->R_user, this->V(phi, theta)), 0.0f);
     float dPvalue_dphi = this->k_s * this->O_s * this->I_s * this->shininess
                          * glm::pow(RdotV, this->shininess - 1.0f)
                          * glm::dot(this->R_user, this->dVdphi(phi, theta));
@@ -391,7 +703,7 @@ float PhongSurface::dPdphi(float phi, float theta) const
  */
 float PhongSurface::dPdtheta(float phi, float theta) const
 {
-    float RdotV = glm::dot(this->R_user, this->V(phi, theta));
+    float RdotV = std::max(glm::dot(this->R_user, this->V(phi, theta)), 0.0f);
     float dPvalue_dtheta = this->k_s * this->O_s * this->I_s
                            * this->shininess * glm::pow(RdotV, this->shininess - 1.0f)
                            * glm::dot(this->R_user, this->dVdtheta(phi, theta));
@@ -0,0 +1,192 @@
+#include "quantization.h"
+
+/**
+ * \file quantization.cpp
+ */
+
+/*
+ * The loops below are written with plain floats, copysign/signbit and integer clamping instead of
+ * branches and floating point comparisons, so the compiler can vectorize them.
+ */
+
+/*
+ * Computes the axis aligned bounding box of an array of points.
+ * \param points - the points.
+ * \param count - the number of points.
+ * \param boxmin - on return the lower corner of the bounding box.
+ * \param boxmax - on return the upper corner of the bounding box.
+ */
+void BoundingBox(glm::vec3 const* points, unsigned int count, glm::vec3& boxmin, glm::vec3& boxmax)
+{
+    if (count == 0) {
+        boxmin = glm::vec3(0.0f);
+        boxmax = glm::vec3(0.0f);
+        return;
+    }
+    float xmin = points[0].x, ymin = points[0].y, zmin = points[0].z;
+    float xmax = points[0].x, ymax = points[0].y, zmax = points[0].z;
+    for (unsigned int k = 1; k < count; ++k) {
+        xmin = std::min(xmin, points[k].x); xmax = std::max(xmax, points[k].x);
+        ymin = std::min(ymin, points[k].y); ymax = std::max(ymax, points[k].y);
+        zmin = std::min(zmin, points[k].z); zmax = std::max(zmax, points[k].z);
+    }
+    boxmin = glm::vec3(xmin, ymin, zmin);
+    boxmax = glm::vec3(xmax, ymax, zmax);
+}
+
+/*
+ * Maps a unit vector to a point in the square [-1, 1] x [-1, 1].
+ * \param nx, ny, nz - the coordinates of a unit vector.
+ * \param x, y - on return the octahedral encoding of the vector.
+ */
+static inline void OctahedralEncode(float nx, float ny, float nz, float& x, float& y)
+{
+    // A zero vector stays zero, because the norm is offset from zero instead of tested
+    float scale = 1.0f / (std::fabs(nx) + std::fabs(ny) + std::fabs(nz) + 1.0e-30f);
+    float px = nx * scale;
+    float py = ny * scale;
+    float pz = nz * scale;
+
+    // Fold the lower half of the octahedron over the upper half, i.e. (x, y) -> (1 - |y|, 1 - |x|) with the signs of (x, y).
+    // On the octahedron 1 - |y| = |x| + |z|, so the fold adds |z| to |x| and |y| when z < 0.
+    float t = 0.5f * (std::fabs(pz) - pz);
+    x = px + std::copysign(t, px);
+    y = py + std::copysign(t, py);
+}
+
+/*
+ * Maps a point in the square [-1, 1] x [-1, 1] back to a unit vector.
+ * \param ex, ey - the octahedral encoding of a vector.
+ * \param nx, ny, nz - on return the coordinates of the unit vector.
+ */
+static inline void OctahedralDecode(float ex, float ey, float& nx, float& ny, float& nz)
+{
+    float z = 1.0f - std::fabs(ex) - std::fabs(ey);
+
+    // Unfold the lower half of the octahedron
+    float t = 0.5f * (std::fabs(z) - z);
+    float x = ex - std::copysign(t, ex);
+    float y = ey - std::copysign(t, ey);
+
+    // The point is on the octahedron, so its squared length is in [1/3, 1]. On that interval a linear
+    // guess of 1 / sqrt(length2) followed by three Newton steps is accurate to float precision, and unlike
+    // std::sqrt it does not need errno handling, which would prevent vectorization.
+    float length2 = x * x + y * y + z * z;
+    float scale   = 1.98f - 1.03f * length2;
+    scale *= 1.5f - 0.5f * length2 * scale * scale;
+    scale *= 1.5f - 0.5f * length2 * scale * scale;
+    scale *= 1.5f - 0.5f * length2 * scale * scale;
+    nx = x * scale;
+    ny = y * scale;
+    nz = z * scale;
+}
+
+/*
+ * Maps a unit vector to a point in the square [-1, 1] x [-1, 1].
+ * \param normal - a unit vector.
+ * \return the octahedral encoding of the vector.
+ */
+glm::vec2 OctahedralEncode(glm::vec3 const& normal)
+{
+    glm::vec2 encoding;
+    OctahedralEncode(normal.x, normal.y, normal.z, encoding.x, encoding.y);
+    return encoding;
+}
+
+/*
+ * Maps a point in the square [-1, 1] x [-1, 1] back to a unit vector.
+ * \param encoding - the octahedral encoding of a vector.
+ * \return the unit vector.
+ */
+glm::vec3 OctahedralDecode(glm::vec2 const& encoding)
+{
+    glm::vec3 normal;
+    OctahedralDecode(encoding.x, encoding.y, normal.x, normal.y, normal.z);
+    return normal;
+}
+
+/*
+ * Quantizes a value in [0, extent] to 16 bits.
+ * \param value - the value relative to the lower corner of the bounding box.
+ * \param scale - 65535 divided by the extent of the bounding box.
+ * \return the quantized value.
+ */
+static inline unsigned short QuantizeUnsigned(float value, float scale)
+{
+    // Clamping the integer rather than the float keeps the loops free of branches
+    return static_cast<unsigned short>(std::min(std::max(static_cast<int>(value * scale + 0.5f), 0), 65535));
+}
+
+/*
+ * Quantizes a value in [-1, 1] to a 16-bit signed normalized value.
+ * \param value - the value.
+ * \return the quantized value.
+ */
+static inline short QuantizeSigned(float value)
+{
+    float scaled = value * 32767.0f + std::copysign(0.5f, value);
+    return static_cast<short>(std::min(std::max(static_cast<int>(scaled), -32767), 32767));
+}
+
+/*
+ * Encodes arrays of vertices and normals as quantized vertices.
+ * \param vertices - the vertices, they should be inside the bounding box.
+ * \param normals - the normals, they should be unit vectors or zero.
+ * \param count - the number of vertices and normals.
+ * \param boxmin - the lower corner of the bounding box.
+ * \param boxmax - the upper corner of the bounding box.
+ * \param destination - the destination of the count quantized vertices.
+ */
+void EncodeVertices(glm::vec3 const* vertices, glm::vec3 const* normals, unsigned int count,
+                    glm::vec3 const& boxmin, glm::vec3 const& boxmax, QuantizedVertex* destination)
+{
+    // A flat bounding box maps all the coordinates in that direction to 0
+    float xmin = boxmin.x;
+    float ymin = boxmin.y;
+    float zmin = boxmin.z;
+    float xscale = (boxmax.x > boxmin.x) ? 65535.0f / (boxmax.x - boxmin.x) : 0.0f;
+    float yscale = (boxmax.y > boxmin.y) ? 65535.0f / (boxmax.y - boxmin.y) : 0.0f;
+    float zscale = (boxmax.z > boxmin.z) ? 65535.0f / (boxmax.z - boxmin.z) : 0.0f;
+
+    for (unsigned int k = 0; k < count; ++k) {
+        float ex;
+        float ey;
+        OctahedralEncode(normals[k].x, normals[k].y, normals[k].z, ex, ey);
+
+        destination[k].position[0] = QuantizeUnsigned(vertices[k].x - xmin, xscale);
+        destination[k].position[1] = QuantizeUnsigned(vertices[k].y - ymin, yscale);
+        destination[k].position[2] = QuantizeUnsigned(vertices[k].z - zmin, zscale);
+        destination[k].padding     = 0;
+        destination[k].normal[0]   = QuantizeSigned(ex);
+        destination[k].normal[1]   = QuantizeSigned(ey);
+    }
+}
+
+/*
+ * Decodes an array of quantized vertices.
+ * \param source - the quantized vertices.
+ * \param count - the number of quantized vertices.
+ * \param boxmin - the lower corner of the bounding box used for the encoding.
+ * \param boxmax - the upper corner of the bounding box used for the encoding.
+ * \param vertices - the destination of the count vertices.
+ * \param normals - the destination of the count normals.
+ */
+void DecodeVertices(QuantizedVertex const* source, unsigned int count,
+                    glm::vec3 const& boxmin, glm::vec3 const& boxmax,
+                    glm::vec3* vertices, glm::vec3* normals)
+{
+    float xmin = boxmin.x;
+    float ymin = boxmin.y;
+    float zmin = boxmin.z;
+    float xscale = (boxmax.x - boxmin.x) / 65535.0f;
+    float yscale = (boxmax.y - boxmin.y) / 65535.0f;
+    float zscale = (boxmax.z - boxmin.z) / 65535.0f;
+
+    for (unsigned int k = 0; k < count; ++k) {
+        vertices[k].x = xmin + source[k].position[0] * xscale;
+        vertices[k].y = ymin + source[k].position[1] * yscale;
+        vertices[k].z = zmin + source[k].position[2] * zscale;
+        OctahedralDecode(source[k].normal[0] / 32767.0f, source[k].normal[1] / 32767.0f,
+                         normals[k].x, normals[k].y, normals[k].z);
+    }
+}
@@ -0,0 +1,362 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+#include "seamwelder.h"
+
+/**
+ * \class SeamWelder
+ * Builds one indexed mesh from several parametric surfaces, where the grid points which the surfaces have in common
+ * along their boundaries are shared.
+ */
+
+/*
+ * Creates an empty seam welder.
+ * \param tolerance - the distance below which boundary grid points which are not covered by a declared seam
+ *                    are welded, 0 disables the spatial hash.
+ */
+SeamWelder::SeamWelder(float tolerance)
+          : tolerance(tolerance), ngridpoints(0), ndeclaredwelds(0), nopposite(0),
+            nhashedwelds(0), ndegenerate(0)
+{
+    Trace("SeamWelder", "SeamWelder(float)");
+}
+
+/*
+ * Destroys the current instance of the seam welder.
+ */
+SeamWelder::~SeamWelder()
+{
+    Trace("SeamWelder", "~SeamWelder()");
+}
+
+/*
+ * Adds a part.
+ * \param part - the parametric surface.
+ * \return the number of the part, which is used to declare seams.
+ */
+unsigned int SeamWelder::AddPart(ParametricSurface& part)
+{
+    this->parts.push_back(&part);
+    return this->parts.size() - 1;
+}
+
+/*
+ * Declares a seam between two edges.
+ * \param seam - the declaration of the seam.
+ */
+void SeamWelder::AddSeam(Seam const& seam)
+{
+    if ((seam.part1 >= this->parts.size()) || (seam.part2 >= this->parts.size())) {
+        throw std::out_of_range("SeamWelder::AddSeam(Seam const&): unknown part");
+    }
+    this->seams.push_back(seam);
+}
+
+/*
+ * Declares a seam between two edges.
+ * \param part1 - the first part.
+ * \param edge1 - the edge of the first part.
+ * \param part2 - the second part.
+ * \param edge2 - the edge of the second part.
+ * \param reversed - true if the edges run in opposite directions.
+ * \param shift - the position on edge2 of the start of edge1.
+ */
+void SeamWelder::AddSeam(unsigned int part1, Edge edge1, unsigned int part2, Edge edge2, bool reversed, float shift)
+{
+    this->AddSeam(Seam{part1, edge1, part2, edge2, reversed, shift});
+}
+
+/*
+ * The distance below which boundary grid points are welded by the spatial hash.
+ * \return the tolerance, 0 if the spatial hash is disabled.
+ */
+float SeamWelder::Tolerance() const
+{
+    return this->tolerance;
+}
+
+/*
+ * Changes the distance below which boundary grid points are welded by the spatial hash.
+ * \param tolerance - the new tolerance, 0 disables the spatial hash.
+ */
+void SeamWelder::Tolerance(float tolerance)
+{
+    this->tolerance = tolerance;
+}
+
+/*
+ * Samples the parts, welds the seams, and builds the indexed mesh.
+ */
+void SeamWelder::Build()
+{
+    Trace("SeamWelder", "Build()");
+
+    // Collect the grid points and triangles of all parts
+    std::vector<glm::vec3>    gridvertices;
+    std::vector<glm::vec3>    gridnormals;
+    std::vector<unsigned int> gridindices;
+    this->offsets.clear();
+    for (unsigned int p = 0; p < this->parts.size(); ++p) {
+        ParametricSurface& part = *this->parts[p];
+        if (part.Tolerance() > 0.0f) {
+            throw std::invalid_argument("SeamWelder::Build(): the parts must use the uniform grid");
+        }
+        unsigned int offset = gridvertices.size();
+        this->offsets.push_back(offset);
+        gridvertices.insert(gridvertices.end(), part.GridVertices().begin(), part.GridVertices().end());
+        gridnormals.insert(gridnormals.end(), part.GridNormals().begin(), part.GridNormals().end());
+        for (unsigned int index : part.Indices()) {
+            gridindices.push_back(offset + index);
+        }
+    }
+    this->ngridpoints = gridvertices.size();
+
+    // Welded grid points form sets, which are represented by the smallest grid point in the set
+    std::vector<unsigned int> representative(this->ngridpoints);
+    std::iota(representative.begin(), representative.end(), 0);
+    auto Find = [&representative](unsigned int k) {
+        while (representative[k] != k) {
+            representative[k] = representative[representative[k]];
+            k = representative[k];
+        }
+        return k;
+    };
+    auto Weld = [&representative, &Find](unsigned int a, unsigned int b) {
+        a = Find(a);
+        b = Find(b);
+        if (a == b) return false;
+        representative[std::max(a, b)] = std::min(a, b);
+        return true;
+    };
+
+    // Weld the grid points of the declared seams
+    std::vector<bool> declared(this->ngridpoints, false);
+    this->ndeclaredwelds = 0;
+    this->nopposite      = 0;
+    for (Seam const& seam : this->seams) {
+        unsigned int length1 = this->EdgeLength(seam.part1, seam.edge1);
+        unsigned int length2 = this->EdgeLength(seam.part2, seam.edge2);
+        for (unsigned int k = 0; k <= length1; ++k) {
+            float t = static_cast<float>(k) / length1;
+            float position = seam.reversed ? seam.shift - t : seam.shift + t;
+            if (position < 0.0f) position += 1.0f;
+            if (position > 1.0f) position -= 1.0f;
+
+            // Only grid points which coincide with a grid point of the other edge are welded
+            float k2 = position * length2;
+            float nearest = std::floor(k2 + 0.5f);
+            if (std::fabs(k2 - nearest) > 1.0e-3f) continue;
+
+            // A vertex has one normal, so grid points with opposite normals are not welded,
+            // e.g. where the orientation of a one-sided surface flips
+            unsigned int point1 = this->EdgePoint(seam.part1, seam.edge1, k);
+            unsigned int point2 = this->EdgePoint(seam.part2, seam.edge2, static_cast<unsigned int>(nearest));
+            if (glm::dot(gridnormals[point1], gridnormals[point2]) < 0.0f) {
+                ++this->nopposite;
+                continue;
+            }
+            declared[point1] = true;
+            declared[point2] = true;
+            if (Weld(point1, point2)) {
+                ++this->ndeclaredwelds;
+            }
+        }
+    }
+
+    // Weld the remaining boundary grid points, i.e. those which are not covered by a declared seam,
+    // which are closer than the tolerance. The grid points are hashed by the cube of side tolerance
+    // which contains them, so close points are found in the 27 surrounding cubes.
+    // Points on the same edge of the same part are not welded, except the two ends of a closed edge, because that
+    // would collapse the edge if the grid spacing is below the tolerance, and a point is compared with the representative of the set
+    // which it would join, so the welds do not chain into sets which are larger than the tolerance.
+    this->nhashedwelds = 0;
+    if (this->tolerance > 0.0f) {
+        std::vector<unsigned int>  boundary;
+        std::vector<unsigned int>  partof(this->ngridpoints, 0);
+        std::vector<unsigned char> edgesof(this->ngridpoints, 0);
+        for (unsigned int p = 0; p < this->parts.size(); ++p) {
+            for (int edge = UMIN; edge <= VMAX; ++edge) {
+                for (unsigned int k = 0; k <= this->EdgeLength(p, Edge(edge)); ++k) {
+                    unsigned int point = this->EdgePoint(p, Edge(edge), k);
+                    if (declared[point]) continue;
+                    if (edgesof[point] == 0) {
+                        boundary.push_back(point);
+                    }
+                    partof[point]   = p;
+                    edgesof[point] |= static_cast<unsigned char>(1 << edge);
+                }
+            }
+        }
+
+        // The ends of an edge are corners, which are on two edges, and they may coincide if the edge is closed
+        auto IsCorner = [](unsigned char edges) {
+            return (edges & (edges - 1)) != 0;
+        };
+        auto Cell = [this](glm::vec3 const& point) {
+            return glm::ivec3(std::floor(point.x / this->tolerance),
+                              std::floor(point.y / this->tolerance),
+                              std::floor(point.z / this->tolerance));
+        };
+        auto Key = [](glm::ivec3 const& cell) {
+            return (static_cast<unsigned long long>(static_cast<unsigned int>(cell.x)) * 73856093ull)
+                 ^ (static_cast<unsigned long long>(static_cast<unsigned int>(cell.y)) * 19349663ull)
+                 ^ (static_cast<unsigned long long>(static_cast<unsigned int>(cell.z)) * 83492791ull);
+        };
+
+        std::unordered_map<unsigned long long, std::vector<unsigned int>> hash;
+        for (unsigned int k : boundary) {
+            hash[Key(Cell(gridvertices[k]))].push_back(k);
+        }
+        for (unsigned int k : boundary) {
+            glm::ivec3 cell = Cell(gridvertices[k]);
+            for (int dx = -1; dx <= 1; ++dx) {
+                for (int dy = -1; dy <= 1; ++dy) {
+                    for (int dz = -1; dz <= 1; ++dz) {
+                        auto bucket = hash.find(Key(cell + glm::ivec3(dx, dy, dz)));
+                        if (bucket == hash.end()) continue;
+                        for (unsigned int other : bucket->second) {
+                            if ((partof[other] == partof[k]) && ((edgesof[other] & edgesof[k]) != 0)
+                                && !(IsCorner(edgesof[other]) && IsCorner(edgesof[k]))) continue;
+
+                            unsigned int root      = Find(k);
+                            unsigned int otherroot = Find(other);
+                            if (root == otherroot) continue;
+                            if ((glm::length(gridvertices[other]     - gridvertices[root]) <= this->tolerance)
+                                && (glm::length(gridvertices[otherroot] - gridvertices[root]) <= this->tolerance)
+                                && (glm::dot(gridnormals[other],     gridnormals[root]) >= 0.0f)
+                                && (glm::dot(gridnormals[otherroot], gridnormals[root]) >= 0.0f)
+                                && Weld(root, otherroot)) {
+                                ++this->nhashedwelds;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Number the sets of welded grid points, and average the normals of each set
+    unsigned int const unused = std::numeric_limits<unsigned int>::max();
+    std::vector<unsigned int> newindex(this->ngridpoints, unused);
+    this->vertices.clear();
+    this->normals.clear();
+    for (unsigned int k = 0; k < this->ngridpoints; ++k) {
+        unsigned int root = Find(k);
+        if (newindex[root] == unused) {
+            newindex[root] = this->vertices.size();
+            this->vertices.push_back(gridvertices[root]);
+            this->normals.push_back(glm::vec3(0.0f));
+        }
+        newindex[k] = newindex[root];
+
+        float length = glm::length(gridnormals[k]);
+        if (length > 0.0f) {
+            this->normals[newindex[k]] += gridnormals[k] / length;
+        }
+    }
+    for (glm::vec3& normal : this->normals) {
+        float length = glm::length(normal);
+        if (length > 0.0f) {
+            normal /= length;
+        }
+    }
+
+    // Renumber the triangles, and remove those which have become degenerate
+    this->indices.clear();
+    this->ndegenerate = 0;
+    for (unsigned int k = 0; k < gridindices.size(); k += 3) {
+        unsigned int a = newindex[gridindices[k]];
+        unsigned int b = newindex[gridindices[k + 1]];
+        unsigned int c = newindex[gridindices[k + 2]];
+        if ((a == b) || (b == c) || (c == a)) {
+            ++this->ndegenerate;
+            continue;
+        }
+        this->indices.push_back(a);
+        this->indices.push_back(b);
+        this->indices.push_back(c);
+    }
+}
+
+/*
+ * The vertices of the welded mesh.
+ * \return the vertices, which are indexed by Indices().
+ */
+std::vector<glm::vec3> const& SeamWelder::Vertices() const
+{
+    return this->vertices;
+}
+
+/*
+ * The normals of the welded mesh.
+ * \return the normals of the vertices.
+ */
+std::vector<glm::vec3> const& SeamWelder::Normals() const
+{
+    return this->normals;
+}
+
+/*
+ * The indices of the triangles of the welded mesh.
+ * \return the indices into Vertices() and Normals(), 3 per triangle.
+ */
+std::vector<unsigned int> const& SeamWelder::Indices() const
+{
+    return this->indices;
+}
+
+/*
+ * Writes statistics of the welding to a stream.
+ * \param s - the stream which the statistics should be written to.
+ */
+void SeamWelder::Statistics(std::ostream& s) const
+{
+    s << "Welded " << this->parts.size() << " parts: " << this->ngridpoints << " grid points -> "
+      << this->vertices.size() << " vertices" << std::endl;
+    s << "    " << this->ndeclaredwelds << " welded by " << this->seams.size() << " declared seams, "
+      << this->nhashedwelds << " welded by the spatial hash, "
+      << this->nopposite << " not welded because of opposite normals" << std::endl;
+    s << "    " << this->indices.size() / 3 << " triangles, " << this->ndegenerate << " degenerate triangles removed"
+      << std::endl;
+}
+
+// Private member functions
+
+/*
+ * The number of grid cells along an edge of a part.
+ * \param part - the part.
+ * \param edge - the edge.
+ * \return the number of grid cells.
+ */
+unsigned int SeamWelder::EdgeLength(unsigned int part, Edge edge) const
+{
+    if ((edge == UMIN) || (edge == UMAX)) {
+        return this->parts[part]->Vsamples();
+    }
+    return this->parts[part]->Usamples();
+}
+
+/*
+ * The index of a grid point on an edge of a part among the grid points of all parts.
+ * The grid point (u_i, v_j) of a part is stored in entry i * (N + 1) + j, see ParametricSurface::GridVertices().
+ * \param part - the part.
+ * \param edge - the edge.
+ * \param k - the number of the grid point along the edge.
+ * \return the index of the grid point.
+ */
+unsigned int SeamWelder::EdgePoint(unsigned int part, Edge edge, unsigned int k) const
+{
+    unsigned int M = this->parts[part]->Usamples();
+    unsigned int N = this->parts[part]->Vsamples();
+    unsigned int offset = this->offsets[part];
+    switch (edge) {
+    case UMIN: return offset + k;
+    case UMAX: return offset + M * (N + 1) + k;
+    case VMIN: return offset + k * (N + 1);
+    case VMAX: return offset + k * (N + 1) + N;
+    }
+    return offset;
+}
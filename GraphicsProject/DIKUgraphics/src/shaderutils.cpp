@@ -31,10 +31,37 @@ std::string Read(std::string const& FileName)
  * \return An identifier for the gpu program.
  */
 GLuint CreateGpuProgram(std::string const& filename, GLenum programtype)
+{
+    return CreateGpuProgram(filename, programtype, "");
+}
+
+/*
+ * Creates and compiles a gpu program, where some preprocessor definitions are inserted after the #version line.
+ * \param filename - The name of the file containing the gpu program.
+ * \param programtype - The type of the gpu program.
+ * \param definitions - The lines which are inserted, e.g. "#define NVIEWS 5\n".
+ * \return An identifier for the gpu program.
+ */
+GLuint CreateGpuProgram(std::string const& filename, GLenum programtype, std::string const& definitions)
 {
     GLuint gpuprogID;
 
     std::string gpuprogram = Read(filename);
+
+    // The #version directive must be the first line of a gpu program, and it may be the only line
+    std::size_t position = 0;
+    if (gpuprogram.compare(0, 8, "#version") == 0) {
+        position = gpuprogram.find('\n');
+        if (position == std::string::npos) {
+            gpuprogram += '\n';
+            position = gpuprogram.size();
+        }
+        else {
+            ++position;
+        }
+    }
+    gpuprogram.insert(position, definitions);
+
     gpuprogID = glCreateShader(programtype);
     if (gpuprogID == 0) {
         std::ostringstream errormessage;
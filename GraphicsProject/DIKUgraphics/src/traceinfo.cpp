@@ -18,12 +18,14 @@ TraceInfo::TraceInfo(const std::string& ClassName,
            filename(FileName),   linenumber(LineNumber), tracelevel(TraceLevel),
            prefix(ClassName + "::" + MemberName)
 {
-    for (uint i = 1; i <= indentlevel; ++i) std::clog << indentspace;
-    std::clog << enter  << this->classname << "::" << this->membername;
+    // The line is written in one piece, so lines traced by different threads of a ParallelFor are not mixed
+    std::string line;
+    for (uint i = 1; i <= indentlevel; ++i) line += indentspace;
+    line += enter + this->classname + "::" + this->membername;
     if (this->tracelevel == 2) {
-        std::clog << " -- " << this->RemovePrefix(this->filename)  << '('  << this->linenumber << ')';
+        line += " -- " + this->RemovePrefix(this->filename) + '(' + std::to_string(this->linenumber) + ')';
     }
-    std::clog << std::endl << std::flush;
+    std::clog << line + '\n' << std::flush;
     ++indentlevel;
     for (uint j = 1; j <= indentlevel; ++j) prefix = indentspace + prefix;
 }
@@ -34,12 +36,13 @@ TraceInfo::TraceInfo(const std::string& ClassName,
 TraceInfo::~TraceInfo()
 {
     --indentlevel;
-    for (uint i = 1; i <= indentlevel; ++i) std::clog << indentspace;
-    std::clog << leave << this->classname << "::" << this->membername;
+    std::string line;
+    for (uint i = 1; i <= indentlevel; ++i) line += indentspace;
+    line += leave + this->classname + "::" + this->membername;
     if (this->tracelevel == 2) {
-        std::clog << " -- " << this->RemovePrefix(this->filename) << '('  << this->linenumber << ')';
+        line += " -- " + this->RemovePrefix(this->filename) + '(' + std::to_string(this->linenumber) + ')';
     }
-    std::clog << std::endl << std::flush;
+    std::clog << line + '\n' << std::flush;
 }
 
 /*
@@ -104,7 +107,7 @@ std::string TraceInfo::RemovePrefix(std::string const& FullFilename) const
 /*
  * Initialization of static variables
  */
-uint              TraceInfo::indentlevel = 0;
+thread_local uint TraceInfo::indentlevel = 0;
 const std::string TraceInfo::enter       = "-->";
 const std::string TraceInfo::leave       = "<--";
 const std::string TraceInfo::indentspace = "   ";
@@ -0,0 +1,51 @@
+#include "vectormath.h"
+
+/**
+ * \file vectormath.cpp
+ */
+
+/*
+ * Computes the sine and the cosine of an array of angles.
+ * The angle is reduced to the interval [-pi/4, pi/4] modulo pi/2, and the sine and cosine of the
+ * reduced angle are approximated by polynomials. The octant of the angle determines which of the
+ * two polynomials gives the sine and which gives the cosine, and their signs.
+ * \param x - the angles in radians.
+ * \param count - the number of angles.
+ * \param sine - the destination of the count sines.
+ * \param cosine - the destination of the count cosines.
+ */
+void SinCos(float const* x, unsigned int count, float* sine, float* cosine)
+{
+    float const FourOverPi = 1.27323954473516f;
+
+    // pi/4 split into three parts for an accurate range reduction
+    float const DP1 = 0.78515625f;
+    float const DP2 = 2.4187564849853515625e-4f;
+    float const DP3 = 3.77489497744594108e-8f;
+
+    for (unsigned int k = 0; k < count; ++k) {
+        float a = std::fabs(x[k]);
+
+        // The even octant closest to the angle
+        int   j = (static_cast<int>(a * FourOverPi) + 1) & ~1;
+        float y = static_cast<float>(j);
+        float r = ((a - y * DP1) - y * DP2) - y * DP3;
+        float z = r * r;
+
+        float ps = ((-1.9515295891e-4f * z + 8.3321608736e-3f) * z - 1.6666654611e-1f) * z * r + r;
+        float pc = ((2.443315711809948e-5f * z - 1.388731625493765e-3f) * z + 4.166664568298827e-2f) * z * z
+                 - 0.5f * z + 1.0f;
+
+        int  octant = j & 7;
+        bool swap   = (octant & 2) != 0;
+
+        float s = swap ? pc : ps;
+        float c = swap ? ps : pc;
+        if ((octant & 4) != 0)       s = -s;
+        if (((octant + 2) & 4) != 0) c = -c;
+        if (x[k] < 0.0f)             s = -s;
+
+        sine[k]   = s;
+        cosine[k] = c;
+    }
+}